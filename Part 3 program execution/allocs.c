@@ -0,0 +1,103 @@
+/*allocs.c*/
+
+//
+// allocation-count benchmark: runs each given nuPython program and
+// reports how many times malloc, calloc and realloc were called
+// while executing it (parsing and building the graph not counted).
+// Linked with -Wl,--wrap so every allocation in the interpreter,
+// including the prebuilt .o files, goes through the counters below.
+//
+// usage: make allocs
+//
+// Irene Ha
+// Northwestern University
+// CS 211
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+
+#include "token.h"
+#include "scanner.h"
+#include "parser.h"
+#include "programgraph.h"
+#include "resolve.h"
+#include "ram.h"
+#include "execute.h"
+
+
+//
+// counters, bumped by the wrappers
+//
+static long num_mallocs  = 0;
+static long num_callocs  = 0;
+static long num_reallocs = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+  num_mallocs++;
+  return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+  num_callocs++;
+  return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+  num_reallocs++;
+  return __real_realloc(ptr, size);
+}
+
+
+int main(int argc, char* argv[])
+{
+  long total = 0;
+
+  // the programs' own output goes to stdout, the report to stderr
+  fprintf(stderr, "allocations during execute (RAM_INLINE_STR_MAX = %d)\n", RAM_INLINE_STR_MAX);
+  fprintf(stderr, "%-12s %10s %10s %10s\n", "program", "malloc", "calloc", "realloc");
+
+  for (int i = 1; i < argc; i++) {
+    FILE* input = fopen(argv[i], "r");
+    if (input == NULL) {
+      fprintf(stderr, "**ERROR: unable to open input file '%s' for input.\n", argv[i]);
+      continue;
+    }
+
+    struct TokenQueue* tokens = parser_parse(input);
+    fclose(input);
+    if (tokens == NULL) {
+      fprintf(stderr, "**parsing failed: '%s'\n", argv[i]);
+      continue;
+    }
+
+    struct STMT* program = programgraph_build(tokens);
+    if (resolve_program(program) < 0) {
+      fprintf(stderr, "**resolving failed: '%s'\n", argv[i]);
+      programgraph_destroy(program);
+      tokenqueue_destroy(tokens);
+      continue;
+    }
+    struct RAM* memory = ram_init();
+
+    num_mallocs = num_callocs = num_reallocs = 0;
+    execute(program, memory);
+    fflush(stdout);
+
+    fprintf(stderr, "%-12s %10ld %10ld %10ld\n", argv[i], num_mallocs, num_callocs, num_reallocs);
+    total += num_mallocs + num_callocs + num_reallocs;
+
+    ram_destroy(memory);
+    programgraph_destroy(program);
+    tokenqueue_destroy(tokens);
+  }
+
+  fprintf(stderr, "%-12s %10ld\n", "total", total);
+  return 0;
+}
@@ -60,6 +60,38 @@ char* stringDup(char* s) {
   return copy;
 }
 
+
+/* slot_address
+returns the memory address of the variable in the given slot (see
+resolve.h), or -1 if the variable is not in memory. The memory
+remembers the address per slot (see ram_get_addr_by_slot), so a
+variable written before the run, or by an earlier run, is found too
+
+parameters: struct RAM*, int, char*   // memory, slot # and interned identifier
+returns: int
+*/
+int slot_address(struct RAM* memory, int slot, char* identifier) {
+  return ram_get_addr_by_slot(memory, slot, identifier);
+}
+
+
+/* slot_write
+writes a value to the variable in the given slot. A variable not in
+memory yet is written by name, so it gets its address in first-write
+order as before; otherwise the write goes by address.
+
+parameters: struct RAM*, int, char*, struct RAM_VALUE   // memory, slot #, interned identifier, value
+returns: bool
+*/
+bool slot_write(struct RAM* memory, int slot, char* identifier, struct RAM_VALUE value) {
+  int address = slot_address(memory, slot, identifier);
+  if (address != -1) {
+    return ram_write_cell_by_addr(memory, value, address);
+  }
+
+  return ram_write_cell_by_name(memory, value, identifier);
+}
+
 //----------------------------------------------------------------------------------------------------------------------------------
 
 /* handle_int_operations
@@ -503,13 +535,10 @@ bool handle_print(struct ELEMENT* parameter, struct RAM* memory, int line) {
   } else if (parameter->element_type == ELEMENT_STR_LITERAL) { // for string literal
     printf("%s\n", parameter->element_value);
   } else if (parameter->element_type == ELEMENT_INT_LITERAL) { // for int literal
-    // Convert string to integer and print
-    char* int_literal_str = parameter->element_value;
-    int int_value = atoi(int_literal_str);
-    printf("%d\n", int_value);
+    printf("%d\n", parameter->constant.types.i); // decoded by resolve_program
   } else if (parameter->element_type == ELEMENT_IDENTIFIER) { // for identifier
     char* var_name = parameter->element_value; // Get variable name
-    struct RAM_VALUE* value = ram_read_cell_by_name(memory, var_name); // Get value by calling this function
+    const struct RAM_VALUE* value = ram_peek_cell_by_addr(memory, slot_address(memory, parameter->slot, parameter->identifier)); // borrow the value, nothing to free
 
     if (value == NULL) {
       printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", var_name, line); // undefined variable
@@ -539,8 +568,7 @@ bool handle_print(struct ELEMENT* parameter, struct RAM* memory, int line) {
       return false; // Unsupported type
     }
   } else if (parameter->element_type == ELEMENT_REAL_LITERAL) {
-    double real_value = atof(parameter->element_value);
-    printf("%lf\n", real_value); // Print the converted value
+    printf("%lf\n", parameter->constant.types.d); // decoded by resolve_program
   } else if (parameter->element_type == ELEMENT_TRUE) { // bool type
     printf("True\n");
   } else if (parameter->element_type == ELEMENT_FALSE) { // bool type
@@ -555,12 +583,12 @@ bool handle_print(struct ELEMENT* parameter, struct RAM* memory, int line) {
 /* handle_int_conversion
 implementation for int function call
 
-parameters: char*, struct RAM*, struct RAM_VALUE* (pointer parameter that is returned), int
+parameters: struct ELEMENT*, struct RAM*, int
 returns: struct RAM_VALUE*
 */
-struct RAM_VALUE* handle_int_conversion(char* var_name, struct RAM* memory, int line) {
+struct RAM_VALUE* handle_int_conversion(struct ELEMENT* parameter, struct RAM* memory, int line) {
   // printf("hello from beginning of handle_int\n"); // debug
-  struct RAM_VALUE* value = ram_read_cell_by_name(memory, var_name);
+  const struct RAM_VALUE* value = ram_peek_cell_by_addr(memory, slot_address(memory, parameter->slot, parameter->identifier)); // borrowed, nothing to free
   // Check if the variable exists and is of type string
   if (value == NULL) {
     printf("variable is not defined\n");
@@ -618,11 +646,11 @@ struct RAM_VALUE* handle_int_conversion(char* var_name, struct RAM* memory, int
 /* handle_float_conversion
 implementation for float function call
 
-parameters: char*, struct RAM*, struct RAM_VALUE* (pointer parameter that is returned), int
+parameters: struct ELEMENT*, struct RAM*, int
 returns: struct RAM_VALUE*
 */
-struct RAM_VALUE* handle_float_conversion(char* var_name, struct RAM* memory, int line) {
-  struct RAM_VALUE* value = ram_read_cell_by_name(memory, var_name);
+struct RAM_VALUE* handle_float_conversion(struct ELEMENT* parameter, struct RAM* memory, int line) {
+  const struct RAM_VALUE* value = ram_peek_cell_by_addr(memory, slot_address(memory, parameter->slot, parameter->identifier)); // borrowed, nothing to free
   // Check if the variable exists and is of type string
   if (value == NULL) {
     printf("variable is not defined\n");
@@ -692,8 +720,8 @@ bool retrieve_value(struct UNARY_EXPR* unary_expr, struct RAM* memory, struct RA
       // printf("entered here\n"); // debug
       char* var_name = unary_expr->element->element_value;
 
-      // use the ram function to get the addr
-      int address = ram_get_addr(memory, var_name);
+      // the variable's address, remembered when it was first written
+      int address = slot_address(memory, unary_expr->element->slot, unary_expr->element->identifier);
 
       if (address == -1) { // if the function returns -1 or the address doesnt exist
         printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", var_name, line);
@@ -707,8 +735,8 @@ bool retrieve_value(struct UNARY_EXPR* unary_expr, struct RAM* memory, struct RA
   } else if (unary_expr->expr_type == UNARY_PTR_DEREF) {
     char* var_name = unary_expr->element->element_value;
 
-    // Get the value of the pointer
-    struct RAM_VALUE* pointer_value = ram_read_cell_by_name(memory, var_name);
+    // Get the value of the pointer (borrowed, nothing to free)
+    const struct RAM_VALUE* pointer_value = ram_peek_cell_by_addr(memory, slot_address(memory, unary_expr->element->slot, unary_expr->element->identifier));
 
     // Case 1: check if the pointer variable exists
     if (pointer_value == NULL) {
@@ -724,13 +752,14 @@ bool retrieve_value(struct UNARY_EXPR* unary_expr, struct RAM* memory, struct RA
 
     int address = pointer_value->types.i; // get the address
 
-    struct RAM_VALUE* dereferenced_value = ram_read_cell_by_addr(memory, address);
+    const struct RAM_VALUE* dereferenced_value = ram_peek_cell_by_addr(memory, address);
     if (dereferenced_value == NULL) { // address is out of bounds
       printf("**SEMANTIC ERROR: '%s' contains invalid address (line %d)\n", var_name, line);
       return false;
     }
 
-    // Copy the dereferenced value into the result
+    // Copy the dereferenced value into the result, a string stays
+    // borrowed from memory until the next write
     *value = *dereferenced_value;
     return true;
   
@@ -738,44 +767,17 @@ bool retrieve_value(struct UNARY_EXPR* unary_expr, struct RAM* memory, struct RA
   } else if (unary_expr->expr_type == UNARY_ELEMENT) {
 
   
-    if (unary_expr->element->element_type == ELEMENT_INT_LITERAL) {
-      // printf("hihi\n"); // debug
-      value->value_type = RAM_TYPE_INT;
-      value->types.i = atoi(unary_expr->element->element_value);// convert from int literal to int
-      return true;
-    } else if (unary_expr->element->element_type == ELEMENT_REAL_LITERAL) {
-      value->value_type = RAM_TYPE_REAL;
-      value->types.d = atof(unary_expr->element->element_value); // convert to double
-      return true;
-    } else if (unary_expr->element->element_type == ELEMENT_STR_LITERAL) {
-      value->value_type = RAM_TYPE_STR;
-      // printf("hi im a string literal\n"); // debug
-
-      value->types.s = (char*)malloc((strlen(unary_expr->element->element_value) + 1) * sizeof(char)); // Allocate memory
-      if (value->types.s == NULL) { // Check for out of mem
-        return false;
-      }
-      strcpy(value->types.s, unary_expr->element->element_value); // Copy the string into value->types.s
-      // printf("%d\n", value->value_type); // debug
-      // printf("%s\n", value->types.s); // debug
-
+    // int, real and str literals, True and False: decoded once by
+    // resolve_program, so this is a load. A str stays borrowed from
+    // the program graph, writing it to memory makes the copy
+    if (unary_expr->element->element_type != ELEMENT_IDENTIFIER && unary_expr->element->constant.value_type != RAM_TYPE_NONE) {
+      *value = unary_expr->element->constant;
       return true;
 
-
-    } else if (unary_expr->element->element_type == ELEMENT_TRUE) { // Boolean true
-      value->value_type = RAM_TYPE_BOOLEAN;
-      value->types.i = 1;
-      return true;
-
-    } else if (unary_expr->element->element_type == ELEMENT_FALSE) { // Boolean false
-      value->value_type = RAM_TYPE_BOOLEAN;
-      value->types.i = 0;
-      return true;
-    
     } else if (unary_expr->element->element_type == ELEMENT_IDENTIFIER) {
       
       char* var_name = unary_expr->element->element_value; // set var_name
-      struct RAM_VALUE* var_value = ram_read_cell_by_name(memory, var_name); // set var_value with ram_read_by_cell_by_name
+      const struct RAM_VALUE* var_value = ram_peek_cell_by_addr(memory, slot_address(memory, unary_expr->element->slot, unary_expr->element->identifier)); // borrow var_value, no copy is made
 
       if (var_value == NULL) { // Semantic error bc of an undefined variable
         printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", var_name, line);
@@ -789,8 +791,7 @@ bool retrieve_value(struct UNARY_EXPR* unary_expr, struct RAM* memory, struct RA
 
 
       // printf("HELLO\n"); // debug
-      *value = *var_value; // copy the RAM_VALUE
-      free(var_value); // free mem allocated by readcellbyname
+      *value = *var_value; // copy the RAM_VALUE, a string stays borrowed from memory until the next write
       return true;
 
     
@@ -804,12 +805,120 @@ bool retrieve_value(struct UNARY_EXPR* unary_expr, struct RAM* memory, struct RA
 return false; // default
 }
 
+//
+// inline cache statistics, see execute_print_cache_stats; only
+// counted when built with -DRAM_STATS, otherwise nothing
+//
+#ifdef RAM_STATS
+#define CACHE_STAT(expr, counter)  ((expr)->counter++)
+#else
+#define CACHE_STAT(expr, counter)  ((void)0)
+#endif
+
+
+//
+// operations an inline cache can hold (see execute_binary_expression),
+// one per operator for int with int and for real with real. x and y
+// are the operands; if guard does not hold (division by zero) the
+// operation goes through execute_binary_operation, which reports it.
+//
+#define CACHED_OPERATION(name, type, field, result_type, result_field, guard, result_expr)                    \
+  static bool name(struct EXPR* expr, struct RAM_VALUE lhs, struct RAM_VALUE rhs, struct RAM_VALUE* result, int line) { \
+    type x = lhs.types.field;                                                                                   \
+    type y = rhs.types.field;                                                                                   \
+    if (!(guard)) {                                                                                             \
+      return execute_binary_operation(expr->operator, lhs, rhs, result, line);                                  \
+    }                                                                                                           \
+    result->value_type = result_type;                                                                           \
+    result->types.result_field = result_expr;                                                                   \
+    return true;                                                                                                \
+  }
+
+CACHED_OPERATION(int_plus, int, i, RAM_TYPE_INT, i, true, x + y)
+CACHED_OPERATION(int_minus, int, i, RAM_TYPE_INT, i, true, x - y)
+CACHED_OPERATION(int_times, int, i, RAM_TYPE_INT, i, true, x * y)
+CACHED_OPERATION(int_div, int, i, RAM_TYPE_INT, i, y != 0, x / y)
+CACHED_OPERATION(int_mod, int, i, RAM_TYPE_INT, i, y != 0, x % y)
+CACHED_OPERATION(int_eq, int, i, RAM_TYPE_BOOLEAN, i, true, x == y)
+CACHED_OPERATION(int_ne, int, i, RAM_TYPE_BOOLEAN, i, true, x != y)
+CACHED_OPERATION(int_lt, int, i, RAM_TYPE_BOOLEAN, i, true, x < y)
+CACHED_OPERATION(int_le, int, i, RAM_TYPE_BOOLEAN, i, true, x <= y)
+CACHED_OPERATION(int_gt, int, i, RAM_TYPE_BOOLEAN, i, true, x > y)
+CACHED_OPERATION(int_ge, int, i, RAM_TYPE_BOOLEAN, i, true, x >= y)
+
+CACHED_OPERATION(real_plus, double, d, RAM_TYPE_REAL, d, true, x + y)
+CACHED_OPERATION(real_minus, double, d, RAM_TYPE_REAL, d, true, x - y)
+CACHED_OPERATION(real_times, double, d, RAM_TYPE_REAL, d, true, x * y)
+CACHED_OPERATION(real_div, double, d, RAM_TYPE_REAL, d, y != 0.0, x / y)
+CACHED_OPERATION(real_mod, double, d, RAM_TYPE_REAL, d, y != 0.0, fmod(x, y))
+CACHED_OPERATION(real_eq, double, d, RAM_TYPE_BOOLEAN, i, true, x == y)
+CACHED_OPERATION(real_ne, double, d, RAM_TYPE_BOOLEAN, i, true, x != y)
+CACHED_OPERATION(real_lt, double, d, RAM_TYPE_BOOLEAN, i, true, x < y)
+CACHED_OPERATION(real_le, double, d, RAM_TYPE_BOOLEAN, i, true, x <= y)
+CACHED_OPERATION(real_gt, double, d, RAM_TYPE_BOOLEAN, i, true, x > y)
+CACHED_OPERATION(real_ge, double, d, RAM_TYPE_BOOLEAN, i, true, x >= y)
+
+typedef bool (*CACHED_OPERATION)(struct EXPR* expr, struct RAM_VALUE lhs, struct RAM_VALUE rhs, struct RAM_VALUE* result, int line);
+
+// by operator, NULL => none, e.g. ** goes through execute_binary_operation
+static const CACHED_OPERATION int_operations[OPERATOR_NO_OP] = {
+  [OPERATOR_PLUS] = int_plus, [OPERATOR_MINUS] = int_minus, [OPERATOR_ASTERISK] = int_times,
+  [OPERATOR_DIV] = int_div, [OPERATOR_MOD] = int_mod,
+  [OPERATOR_EQUAL] = int_eq, [OPERATOR_NOT_EQUAL] = int_ne,
+  [OPERATOR_LT] = int_lt, [OPERATOR_LTE] = int_le, [OPERATOR_GT] = int_gt, [OPERATOR_GTE] = int_ge
+};
+
+static const CACHED_OPERATION real_operations[OPERATOR_NO_OP] = {
+  [OPERATOR_PLUS] = real_plus, [OPERATOR_MINUS] = real_minus, [OPERATOR_ASTERISK] = real_times,
+  [OPERATOR_DIV] = real_div, [OPERATOR_MOD] = real_mod,
+  [OPERATOR_EQUAL] = real_eq, [OPERATOR_NOT_EQUAL] = real_ne,
+  [OPERATOR_LT] = real_lt, [OPERATOR_LTE] = real_le, [OPERATOR_GT] = real_gt, [OPERATOR_GTE] = real_ge
+};
+
+
+/* any_operation
+what an inline cache holds for operand types with no operation of
+their own: the full check of the types, execute_binary_operation
+
+parameters: struct EXPR*, struct RAM_VALUE, struct RAM_VALUE, struct RAM_VALUE* (for result), int (for line)
+returns: bool
+*/
+static bool any_operation(struct EXPR* expr, struct RAM_VALUE lhs, struct RAM_VALUE rhs, struct RAM_VALUE* result, int line) {
+  return execute_binary_operation(expr->operator, lhs, rhs, result, line);
+}
+
+
+/* specialize
+fills the inline cache of expr for the given operand types
+
+parameters: struct EXPR*, int, int   // expression, lhs and rhs value_type
+returns: nothing
+*/
+static void specialize(struct EXPR* expr, int lhs_type, int rhs_type) {
+  CACHED_OPERATION operation = NULL;
+
+  if (expr->operator >= 0 && expr->operator < OPERATOR_NO_OP) {
+    if (lhs_type == RAM_TYPE_INT && rhs_type == RAM_TYPE_INT) {
+      operation = int_operations[expr->operator];
+    } else if (lhs_type == RAM_TYPE_REAL && rhs_type == RAM_TYPE_REAL) {
+      operation = real_operations[expr->operator];
+    }
+  }
+
+  expr->cache_lhs_type = lhs_type;
+  expr->cache_rhs_type = rhs_type;
+  expr->cache_operation = (operation != NULL) ? operation : any_operation;
+}
+
+
 /* execute_binary_expression
 this is a helper for if the rhs is a binary expression
 Evaluates a binary expression by retrieving the values of the left-hand 
 side (lhs) and right-hand side (rhs), and performing the specified operation.
 Supports addition, subtraction, multiplication, division, modulus, and exponentiation.
 Handles semantic errors such as division by zero or unsupported operators.
+The operation is picked through the expression's inline cache, see
+execute_cached_operation.
 
 parameters: struct EXPR*, struct RAM*, struct RAM_VALUE* (for result), int (for line)
 returns: bool
@@ -830,32 +939,67 @@ bool execute_binary_expression(struct EXPR* expr, struct RAM* memory, struct RAM
   }
   // CHECK DONE ------------->
 
+  return execute_cached_operation(expr, lhs_val, rhs_val, result, line);
+}
+
+
+/* execute_cached_operation
+applies the operator of expr to values already retrieved, through the
+expression's inline cache: as long as the operand types are the ones
+seen last, the operation picked for them then is applied without
+checking the types again. Also used by the handlers picked by
+execute_bind and by the bytecode engine (see vm.h).
+
+parameters: struct EXPR*, struct RAM_VALUE, struct RAM_VALUE, struct RAM_VALUE* (for result), int (for line)
+returns: bool
+*/
+bool execute_cached_operation(struct EXPR* expr, struct RAM_VALUE lhs, struct RAM_VALUE rhs, struct RAM_VALUE* result, int line) {
+  if (expr->cache_operation != NULL && lhs.value_type == expr->cache_lhs_type && rhs.value_type == expr->cache_rhs_type) {
+    CACHE_STAT(expr, cache_hits);
+  } else { // first time, or the types changed
+    CACHE_STAT(expr, cache_misses);
+    specialize(expr, lhs.value_type, rhs.value_type);
+  }
+
+  return expr->cache_operation(expr, lhs, rhs, result, line);
+}
+
+
+/* execute_binary_operation
+the second half of execute_binary_expression: applies the operator to
+values already retrieved, picking the handler by their types. Also
+what an inline cache falls back to, see execute_cached_operation.
+
+parameters: int (enum OPERATORS), struct RAM_VALUE, struct RAM_VALUE, struct RAM_VALUE* (for result), int (for line)
+returns: bool
+*/
+bool execute_binary_operation(int operator, struct RAM_VALUE lhs, struct RAM_VALUE rhs, struct RAM_VALUE* result, int line) {
   // each handle helper function is going to return true or false for success or failure
-  if (lhs_val.value_type == RAM_TYPE_INT && rhs_val.value_type == RAM_TYPE_INT) {
-    return handle_int_operations(expr->operator, lhs_val, rhs_val, result, line);
+  if (lhs.value_type == RAM_TYPE_INT && rhs.value_type == RAM_TYPE_INT) {
+    return handle_int_operations(operator, lhs, rhs, result, line);
   
-  } else if (lhs_val.value_type == RAM_TYPE_REAL && rhs_val.value_type == RAM_TYPE_REAL) {
-    return handle_real_operations(expr->operator, lhs_val, rhs_val, result, line);
+  } else if (lhs.value_type == RAM_TYPE_REAL && rhs.value_type == RAM_TYPE_REAL) {
+    return handle_real_operations(operator, lhs, rhs, result, line);
   
-  } else if (lhs_val.value_type == RAM_TYPE_INT && rhs_val.value_type == RAM_TYPE_REAL) {
-    return handle_int_real_operations(expr->operator, lhs_val, rhs_val, result, line);
+  } else if (lhs.value_type == RAM_TYPE_INT && rhs.value_type == RAM_TYPE_REAL) {
+    return handle_int_real_operations(operator, lhs, rhs, result, line);
   
-  } else if (lhs_val.value_type == RAM_TYPE_REAL && rhs_val.value_type == RAM_TYPE_INT) {
-    return handle_real_int_operations(expr->operator, lhs_val, rhs_val, result, line);
+  } else if (lhs.value_type == RAM_TYPE_REAL && rhs.value_type == RAM_TYPE_INT) {
+    return handle_real_int_operations(operator, lhs, rhs, result, line);
   
-  } else if (lhs_val.value_type == RAM_TYPE_STR && rhs_val.value_type == RAM_TYPE_STR) {
-    return handle_str_operations(expr->operator, lhs_val, rhs_val, result, line);
+  } else if (lhs.value_type == RAM_TYPE_STR && rhs.value_type == RAM_TYPE_STR) {
+    return handle_str_operations(operator, lhs, rhs, result, line);
 
 
   // next chunk is for checking with ptr types and call the appropriate function
-  } else if (lhs_val.value_type == RAM_TYPE_PTR && rhs_val.value_type == RAM_TYPE_INT) {
-    return handle_int_operations(expr->operator, lhs_val, rhs_val, result, line);
-  } else if (lhs_val.value_type == RAM_TYPE_PTR && rhs_val.value_type == RAM_TYPE_REAL) {
-    return handle_real_operations(expr->operator, lhs_val, rhs_val, result, line);
-  } else if (lhs_val.value_type == RAM_TYPE_INT && rhs_val.value_type == RAM_TYPE_PTR) {
-    return handle_int_operations(expr->operator, lhs_val, rhs_val, result, line);
-  } else if (lhs_val.value_type == RAM_TYPE_REAL && rhs_val.value_type == RAM_TYPE_PTR) {
-    return handle_real_operations(expr->operator, lhs_val, rhs_val, result, line);
+  } else if (lhs.value_type == RAM_TYPE_PTR && rhs.value_type == RAM_TYPE_INT) {
+    return handle_int_operations(operator, lhs, rhs, result, line);
+  } else if (lhs.value_type == RAM_TYPE_PTR && rhs.value_type == RAM_TYPE_REAL) {
+    return handle_real_operations(operator, lhs, rhs, result, line);
+  } else if (lhs.value_type == RAM_TYPE_INT && rhs.value_type == RAM_TYPE_PTR) {
+    return handle_int_operations(operator, lhs, rhs, result, line);
+  } else if (lhs.value_type == RAM_TYPE_REAL && rhs.value_type == RAM_TYPE_PTR) {
+    return handle_real_operations(operator, lhs, rhs, result, line);
     
   
   } else { // The types are not valid
@@ -941,45 +1085,46 @@ returns: struct RAM_VALUE*
 */
 struct RAM_VALUE* execute_assignment_to_function_call(struct FUNCTION_CALL* function_call, struct RAM* memory, int line) {
 
-  // input function
-  if (strcmp(function_call->function_name, "input") == 0) { // handle input
-    char* message = function_call->parameter->element_value; // Get the message to display to the user
+  // the builtin was looked up by resolve_program, which also reported
+  // any call that lands in the default case before the program ran
+  switch (function_call->builtin) {
 
-    printf("%s", message); // print message and receive input
+    // input function
+    case BUILTIN_INPUT: { // handle input
+      char* message = function_call->parameter->element_value; // Get the message to display to the user
 
-    // read user input and allocate memory dynamically
-    char input_line[256];
-    //char* input_line = (char*) malloc (256 * sizeof(char));
-    fgets(input_line, sizeof(input_line), stdin);
-    input_line[strcspn(input_line, "\r\n")] = '\0';
-    if (input_line == NULL) {
-      printf("input_line is NULL uh oh\n");
-    }
+      printf("%s", message); // print message and receive input
+
+      // read user input and allocate memory dynamically
+      char input_line[256];
+      //char* input_line = (char*) malloc (256 * sizeof(char));
+      fgets(input_line, sizeof(input_line), stdin);
+      input_line[strcspn(input_line, "\r\n")] = '\0';
+      if (input_line == NULL) {
+        printf("input_line is NULL uh oh\n");
+      }
     
 
-    struct RAM_VALUE* new_value = (struct RAM_VALUE*)malloc(sizeof(struct RAM_VALUE));
+      struct RAM_VALUE* new_value = (struct RAM_VALUE*)malloc(sizeof(struct RAM_VALUE));
 
-    new_value->value_type = RAM_TYPE_STR;
-    new_value->types.s = stringDup(input_line); // make this a dupstring of input_line
+      new_value->value_type = RAM_TYPE_STR;
+      new_value->types.s = stringDup(input_line); // make this a dupstring of input_line
 
 
-    return new_value;
-  
-  // int function
-  } else if (strcmp(function_call->function_name, "int") == 0) {
+      return new_value;
+    }
 
-    struct RAM_VALUE* new_value = handle_int_conversion(function_call->parameter->element_value, memory, line);
-    return new_value;
-  }
+    // int function
+    case BUILTIN_INT:
+      return handle_int_conversion(function_call->parameter, memory, line);
 
-  // float function
-  else if (strcmp(function_call->function_name, "float") == 0) {
-    struct RAM_VALUE* new_value = handle_float_conversion(function_call->parameter->element_value, memory, line);
-    // printf("hello\n"); // debug
-    return new_value;
-  }
+    // float function
+    case BUILTIN_FLOAT:
+      return handle_float_conversion(function_call->parameter, memory, line);
 
-  return NULL; // in this case none of the valid function call names were called like input, int, float
+    default:
+      return NULL; // in this case none of the valid function call names were called like input, int, float
+  }
 }
 
 
@@ -1000,17 +1145,14 @@ bool execute_function_call(struct STMT* stmt, struct RAM* memory) {
     // printf("\n"); // debug
     struct ELEMENT* parameter = stmt->types.function_call->parameter;
 
-    //print function
-    if (strcmp(function_name, "print") == 0) {
-      // printf("running handle_print"); // debug
-      return handle_print(parameter, memory, stmt->line);
-    } 
+    // the builtin was looked up once by resolve_program
+    switch (stmt->types.function_call->builtin) {
+      case BUILTIN_PRINT: //print function
+        return handle_print(parameter, memory, stmt->line);
 
-    else { // Unsupported function
-      printf("**SEMANTIC ERROR: unsupported function '%s' (line %d)\n", function_name, stmt->line);
-      // exit(0);// debug
-
-      return false;
+      default: // Unsupported function, resolve_program reported it already
+        printf("**SEMANTIC ERROR: unsupported function '%s' (line %d)\n", function_name, stmt->line);
+        return false;
     }
 }
 
@@ -1057,7 +1199,7 @@ bool execute_assignment(struct STMT* stmt, struct RAM* memory) {
       
       // Check if it's a dereference operation
       if (isDeref) {
-        struct RAM_VALUE* pointer_value = ram_read_cell_by_name(memory, var_name);
+        const struct RAM_VALUE* pointer_value = ram_peek_cell_by_addr(memory, slot_address(memory, stmt->types.assignment->var_slot, stmt->types.assignment->var_identifier)); // borrowed
 
         // Case 1: Check if the pointer variable exists
         if (pointer_value == NULL) {
@@ -1109,7 +1251,7 @@ bool execute_assignment(struct STMT* stmt, struct RAM* memory) {
 
     // otherwise... write evaluated value to memory
     // printf("%s", return_val.types.s); // debug
-    if (!ram_write_cell_by_name(memory, return_val, var_name)) {
+    if (!slot_write(memory, stmt->types.assignment->var_slot, stmt->types.assignment->var_identifier, return_val)) {
       // printf("HIT HERE\n"); // debug
       // exit(0); // debug
       printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", var_name, stmt->line);
@@ -1162,6 +1304,8 @@ bool execute_while_stmt(struct STMT* stmt, struct RAM* memory, int og_line) {
       struct STMT* body = stmt->types.while_loop->loop_body;
 
       while (true) {
+        ram_compact(memory, false);  // safe point, nothing peeked is held
+
         struct RAM_VALUE condition_result;
 
         // Evaluate the loop condition
@@ -1232,6 +1376,8 @@ bool execute_while_loop(struct STMT* stmt, struct RAM* memory, int og_line) {
   struct STMT* body = stmt->types.while_loop->loop_body;
 
   while(true) { // outer loop
+    ram_compact(memory, false);  // safe point, nothing peeked is held
+
     struct RAM_VALUE condition_result;
     // Evaluate the loop condition
     if (!evaluate_expression(condition, memory, &condition_result, stmt->line)) {
@@ -1313,6 +1459,405 @@ bool execute_statement(struct STMT* stmt, struct RAM* memory) {
 
 
 
+//----------------------------------------------------------------------------------------------------------------------------------
+//
+// threaded execution: execute_bind picks a handler once for every
+// expression and assignment the program can run, and
+// execute_threaded calls through them instead of re-checking the
+// stmt_type, expr_type and element_type of every node every time
+//
+
+typedef bool (*EXPR_HANDLER)(struct EXPR* expr, struct RAM* memory, struct RAM_VALUE* result, int line);
+
+// what execute_bind knows about an operand
+enum OPERAND_KINDS
+{
+  OPERAND_VARIABLE = 0,  // an identifier
+  OPERAND_CONSTANT,      // a decoded literal, True or False
+  OPERAND_OTHER          // & or *, unary + or -, an invalid element
+};
+
+
+/* load_variable
+retrieve_value for an identifier, with the same error and exit if
+the variable is not defined
+
+parameters: struct ELEMENT*, struct RAM*, struct RAM_VALUE* (for value), int (for line)
+returns: nothing
+*/
+static inline void load_variable(struct ELEMENT* element, struct RAM* memory, struct RAM_VALUE* value, int line) {
+  const struct RAM_VALUE* var_value = ram_peek_cell_by_addr(memory, slot_address(memory, element->slot, element->identifier));
+
+  if (var_value == NULL) {
+    printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", element->element_value, line);
+    printf("**done\n");
+    ram_print(memory);
+    exit(0);
+  }
+
+  *value = *var_value; // a string stays borrowed from memory until the next write
+}
+
+
+/* load_constant
+retrieve_value for a literal, True or False
+
+parameters: struct ELEMENT*, struct RAM*, struct RAM_VALUE* (for value), int (for line)
+returns: nothing
+*/
+static inline void load_constant(struct ELEMENT* element, struct RAM* memory, struct RAM_VALUE* value, int line) {
+  *value = element->constant;
+}
+
+
+/* eval_variable
+handler of an expression that is just a variable
+
+parameters: struct EXPR*, struct RAM*, struct RAM_VALUE* (for result), int (for line)
+returns: bool
+*/
+static bool eval_variable(struct EXPR* expr, struct RAM* memory, struct RAM_VALUE* result, int line) {
+  load_variable(expr->lhs->element, memory, result, line);
+  return true;
+}
+
+
+/* eval_constant
+handler of an expression that is just a literal, True or False
+
+parameters: struct EXPR*, struct RAM*, struct RAM_VALUE* (for result), int (for line)
+returns: bool
+*/
+static bool eval_constant(struct EXPR* expr, struct RAM* memory, struct RAM_VALUE* result, int line) {
+  *result = expr->lhs->element->constant;
+  return true;
+}
+
+
+//
+// handlers of binary expressions whose operands are variables or
+// constants, one per operand kinds, e.g. eval_var_const for x + 1.
+// The operator is applied through the expression's inline cache, as
+// in execute_binary_expression, see execute_cached_operation.
+//
+#define BINARY_HANDLER(name, load_lhs, load_rhs)                                                \
+  static bool name(struct EXPR* expr, struct RAM* memory, struct RAM_VALUE* result, int line) { \
+    struct RAM_VALUE lhs;                                                                       \
+    struct RAM_VALUE rhs;                                                                       \
+    load_lhs(expr->lhs->element, memory, &lhs, line);                                           \
+    load_rhs(expr->rhs->element, memory, &rhs, line);                                           \
+    return execute_cached_operation(expr, lhs, rhs, result, line);                              \
+  }
+
+BINARY_HANDLER(eval_var_var, load_variable, load_variable)
+BINARY_HANDLER(eval_var_const, load_variable, load_constant)
+BINARY_HANDLER(eval_const_var, load_constant, load_variable)
+
+
+/* assign_expr
+handler of an assignment var = expression, with no * on the left and
+no & in the expression; the rest go to execute_assignment
+
+parameters: struct STMT*, struct RAM*
+returns: bool
+*/
+static bool assign_expr(struct STMT* stmt, struct RAM* memory) {
+  struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+  struct EXPR* expr = assignment->rhs->types.expr;
+  struct RAM_VALUE value;
+
+  if (!expr->handler(expr, memory, &value, stmt->line)) {
+    return false;
+  }
+
+  if (!slot_write(memory, assignment->var_slot, assignment->var_identifier, value)) {
+    printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", assignment->var_name, stmt->line);
+    return false;
+  }
+
+  return true;
+}
+
+
+/* operand_kind
+what kind of operand a side of an expression is
+
+parameters: struct UNARY_EXPR*
+returns: int   // enum OPERAND_KINDS
+*/
+static int operand_kind(struct UNARY_EXPR* unary_expr) {
+  if (unary_expr == NULL || unary_expr->expr_type != UNARY_ELEMENT) {
+    return OPERAND_OTHER;
+  }
+
+  if (unary_expr->element->element_type == ELEMENT_IDENTIFIER) {
+    return OPERAND_VARIABLE;
+  }
+  if (unary_expr->element->constant.value_type != RAM_TYPE_NONE) {
+    return OPERAND_CONSTANT;
+  }
+  return OPERAND_OTHER;  // retrieve_value reports it
+}
+
+
+/* bind_expr
+picks the handler of an expression: a specialized one if there is
+one for its shape, else evaluate_expression
+
+parameters: struct EXPR*
+returns: nothing
+*/
+static void bind_expr(struct EXPR* expr) {
+  if (expr == NULL) {
+    return;
+  }
+
+  expr->handler = evaluate_expression;
+
+  int lhs = operand_kind(expr->lhs);
+
+  if (!expr->isBinaryExpr) {
+    if (lhs == OPERAND_VARIABLE) {
+      expr->handler = eval_variable;
+    } else if (lhs == OPERAND_CONSTANT) {
+      expr->handler = eval_constant;
+    }
+    return;
+  }
+
+  int rhs = operand_kind(expr->rhs);
+  if (lhs == OPERAND_VARIABLE && rhs == OPERAND_VARIABLE) {
+    expr->handler = eval_var_var;
+  } else if (lhs == OPERAND_VARIABLE && rhs == OPERAND_CONSTANT) {
+    expr->handler = eval_var_const;
+  } else if (lhs == OPERAND_CONSTANT && rhs == OPERAND_VARIABLE) {
+    expr->handler = eval_const_var;
+  }
+}
+
+
+/* walk_stmts
+calls visit on stmt and the statements after it that execute can run,
+the bodies of loops included: up to the end of the enclosing loop's
+body (the loop itself, which the body links back to) or an
+if-then-else, which execute does not run
+
+parameters: struct STMT*, struct STMT*, void (*)(struct STMT*, void*), void*
+            // first statement, enclosing loop or NULL, visit and its argument
+returns: nothing
+*/
+static void walk_stmts(struct STMT* stmt, struct STMT* loop, void (*visit)(struct STMT* stmt, void* arg), void* arg) {
+  while (stmt != NULL) {
+    if (loop != NULL && stmt->stmt_type == STMT_WHILE_LOOP && stmt->line == loop->line) {
+      return;
+    }
+
+    switch (stmt->stmt_type) {
+      case STMT_ASSIGNMENT:
+        visit(stmt, arg);
+        stmt = stmt->types.assignment->next_stmt;
+        break;
+
+      case STMT_FUNCTION_CALL:
+        visit(stmt, arg);
+        stmt = stmt->types.function_call->next_stmt;
+        break;
+
+      case STMT_PASS:
+        visit(stmt, arg);
+        stmt = stmt->types.pass->next_stmt;
+        break;
+
+      case STMT_WHILE_LOOP:
+        visit(stmt, arg);
+        walk_stmts(stmt->types.while_loop->loop_body, stmt, visit, arg);
+        stmt = stmt->types.while_loop->next_stmt;
+        break;
+
+      default:
+        return;
+    }
+  }
+}
+
+
+/* bind_stmt
+picks the handlers of one statement, see walk_stmts
+
+parameters: struct STMT*, void*   // statement, unused
+returns: nothing
+*/
+static void bind_stmt(struct STMT* stmt, void* arg) {
+  if (stmt->stmt_type == STMT_WHILE_LOOP) {
+    bind_expr(stmt->types.while_loop->condition);
+    return;
+  }
+  if (stmt->stmt_type != STMT_ASSIGNMENT) {
+    return;
+  }
+
+  struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+  struct VALUE* rhs = assignment->rhs;
+
+  assignment->handler = execute_assignment;
+  if (rhs->value_type == VALUE_EXPR) {
+    bind_expr(rhs->types.expr);
+
+    if (!assignment->isPtrDeref && rhs->types.expr->lhs != NULL && rhs->types.expr->lhs->expr_type != UNARY_ADDRESS_OF) {
+      assignment->handler = assign_expr;
+    }
+  }
+}
+
+
+#ifdef RAM_STATS
+//
+// hits and misses of the inline caches of one line, see
+// execute_print_cache_stats
+//
+struct CACHE_STATS_ROW
+{
+  int line;
+  unsigned long hits;
+  unsigned long misses;
+};
+
+struct CACHE_STATS
+{
+  struct CACHE_STATS_ROW* rows;
+  int count;
+  int capacity;
+};
+
+
+/* collect_cache_stats
+adds a row for the expression of one statement, if its inline cache
+was used, see walk_stmts
+
+parameters: struct STMT*, void*   // statement, struct CACHE_STATS*
+returns: nothing
+*/
+static void collect_cache_stats(struct STMT* stmt, void* arg) {
+  struct CACHE_STATS* stats = (struct CACHE_STATS*)arg;
+  struct EXPR* expr = NULL;
+
+  if (stmt->stmt_type == STMT_ASSIGNMENT && stmt->types.assignment->rhs->value_type == VALUE_EXPR) {
+    expr = stmt->types.assignment->rhs->types.expr;
+  } else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+    expr = stmt->types.while_loop->condition;
+  }
+
+  if (expr == NULL || expr->cache_hits + expr->cache_misses == 0) {
+    return;
+  }
+
+  if (stats->count == stats->capacity) {
+    stats->capacity = (stats->capacity == 0) ? 16 : 2 * stats->capacity;
+    stats->rows = (struct CACHE_STATS_ROW*)realloc(stats->rows, stats->capacity * sizeof(struct CACHE_STATS_ROW));
+    if (stats->rows == NULL) {
+      //printf("ERROR: OUT OF MEMORY\n");
+      exit(1);
+    }
+  }
+
+  stats->rows[stats->count].line = stmt->line;
+  stats->rows[stats->count].hits = expr->cache_hits;
+  stats->rows[stats->count].misses = expr->cache_misses;
+  stats->count++;
+}
+
+
+/* cache_stats_by_line
+qsort comparator, orders rows by line #
+
+parameters: const void*, const void*   // two struct CACHE_STATS_ROW*
+returns: int
+*/
+static int cache_stats_by_line(const void* a, const void* b) {
+  const struct CACHE_STATS_ROW* x = (const struct CACHE_STATS_ROW*)a;
+  const struct CACHE_STATS_ROW* y = (const struct CACHE_STATS_ROW*)b;
+
+  return (x->line > y->line) - (x->line < y->line);
+}
+#endif
+
+
+static bool threaded_while_loop(struct STMT* loop, struct RAM* memory);
+
+/* threaded_statement
+execute_statement through the handlers; also finds the next statement,
+so there is one check of the stmt_type per statement
+
+parameters: struct STMT*, struct RAM*, struct STMT** (for the next statement)
+returns: bool
+*/
+static inline bool threaded_statement(struct STMT* stmt, struct RAM* memory, struct STMT** next) {
+  switch (stmt->stmt_type) {
+    case STMT_ASSIGNMENT:
+      *next = stmt->types.assignment->next_stmt;
+      return stmt->types.assignment->handler(stmt, memory);
+
+    case STMT_FUNCTION_CALL:
+      *next = stmt->types.function_call->next_stmt;
+      return execute_function_call(stmt, memory);
+
+    case STMT_PASS:
+      *next = stmt->types.pass->next_stmt;
+      return true;
+
+    case STMT_WHILE_LOOP:
+      *next = stmt->types.while_loop->next_stmt;
+      return threaded_while_loop(stmt, memory);
+
+    default:
+      printf("**SEMANTIC ERROR: unsupported stmt type UH OH (line %d)\n", stmt->line);
+      return false;
+  }
+}
+
+
+/* threaded_while_loop
+execute_while_loop through the handlers: a failed statement in the
+body ends that iteration, a failed condition ends the loop with false.
+A nested loop is run the same way, as execute_while_stmt does
+
+parameters: struct STMT*, struct RAM*
+returns: bool
+*/
+static bool threaded_while_loop(struct STMT* loop, struct RAM* memory) {
+  struct EXPR* condition = loop->types.while_loop->condition;
+  struct STMT* body = loop->types.while_loop->loop_body;
+
+  while (true) {
+    ram_compact(memory, false);  // safe point, nothing peeked is held
+
+    struct RAM_VALUE condition_result;
+    if (!condition->handler(condition, memory, &condition_result, loop->line)) {
+      return false;
+    }
+
+    if (condition_result.types.i == 0) {
+      break;
+    }
+
+    struct STMT* stmt = body;
+    while (stmt != NULL && !(stmt->stmt_type == STMT_WHILE_LOOP && stmt->line == loop->line)) {
+      struct STMT* next;
+
+      if (!threaded_statement(stmt, memory, &next)) {
+        break;
+      }
+      stmt = next;
+    }
+  }
+
+  return true;
+}
+
+
+
+
+
 //
 // Public functions:
 //
@@ -1330,10 +1875,12 @@ void execute(struct STMT* program, struct RAM* memory)
 {
   struct STMT* stmt = program; // start from the first stmt
 
+
   while (stmt != NULL) {
     if (!execute_statement(stmt, memory)) {
-      return;
+      break;
     }
+    ram_compact(memory, false);  // safe point between statements
 
     // move to next stmt based on stmt type
     if (stmt->stmt_type == STMT_ASSIGNMENT) {
@@ -1355,4 +1902,74 @@ void execute(struct STMT* program, struct RAM* memory)
     }
   }
 
-}
\ No newline at end of file
+}
+
+
+//
+// execute_bind
+//
+// Picks the handler of every expression and assignment that execute
+// can run, once, after the program graph is resolved.
+//
+void execute_bind(struct STMT* program)
+{
+  walk_stmts(program, NULL, bind_stmt, NULL);
+}
+
+
+//
+// execute_threaded
+//
+// execute, but each statement and expression runs through the handler
+// execute_bind picked for it. Same output and semantic errors.
+//
+void execute_threaded(struct STMT* program, struct RAM* memory)
+{
+  struct STMT* stmt = program;
+
+  while (stmt != NULL) {
+    struct STMT* next;
+
+    if (!threaded_statement(stmt, memory, &next)) {
+      break;
+    }
+    ram_compact(memory, false);  // safe point between statements
+
+    stmt = next;
+  }
+
+}
+
+
+//
+// execute_print_cache_stats
+//
+// Prints, per line, how often the inline cache of the binary
+// expression on that line held the operation for the operand types
+// (hits) and how often it had to pick it again (misses).
+//
+void execute_print_cache_stats(struct STMT* program)
+{
+  printf("**CACHE STATS**\n");
+
+#ifdef RAM_STATS
+  struct CACHE_STATS stats = { NULL, 0, 0 };
+
+  walk_stmts(program, NULL, collect_cache_stats, &stats);
+  qsort(stats.rows, stats.count, sizeof(struct CACHE_STATS_ROW), cache_stats_by_line);
+
+  printf("%6s %12s %12s %9s\n", "line", "hits", "misses", "hit rate");
+  for (int i = 0; i < stats.count; i++) {
+    struct CACHE_STATS_ROW* row = &stats.rows[i];
+    unsigned long total = row->hits + row->misses;
+
+    printf("%6d %12lu %12lu %8.1f%%\n", row->line, row->hits, row->misses, 100.0 * row->hits / total);
+  }
+
+  free(stats.rows);
+#else
+  printf("not counted, build with -DRAM_STATS\n");
+#endif
+
+  printf("**END STATS**\n");
+}
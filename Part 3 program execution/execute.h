@@ -26,6 +26,26 @@ returns: char*       // returns the copy
 */
 char* stringDup(char* s);
 
+/* slot_address
+returns the memory address of the variable in the given slot (see
+resolve.h), or -1 if the variable is not in memory
+
+parameters: struct RAM*, int, char*   // memory, slot # and interned identifier
+returns: int
+*/
+int slot_address(struct RAM* memory, int slot, char* identifier);
+
+/* slot_write
+writes a value to the variable in the given slot. A variable not in
+memory yet is written by ram_write_cell_by_name so it gets its
+address in first-write order as before; later writes go through
+ram_write_cell_by_addr, the memory remembers the address per slot.
+
+parameters: struct RAM*, int, char*, struct RAM_VALUE   // memory, slot #, interned identifier, value
+returns: bool
+*/
+bool slot_write(struct RAM* memory, int slot, char* identifier, struct RAM_VALUE value);
+
 /* handle_int_operations
 this helper function handles various operations with int and int
 
@@ -80,18 +100,18 @@ bool handle_print(struct ELEMENT* parameter, struct RAM* memory, int line);
 /* handle_int_conversion
 implementation for int function call
 
-parameters: char*, struct RAM*, struct RAM_VALUE* (pointer parameter that is returned), int
+parameters: struct ELEMENT*, struct RAM*, int
 returns: struct RAM_VALUE*
 */
-struct RAM_VALUE* handle_int_conversion(char* var_name, struct RAM* memory, int line);
+struct RAM_VALUE* handle_int_conversion(struct ELEMENT* parameter, struct RAM* memory, int line);
 
 /* handle_float_conversion
 implementation for float function call
 
-parameters: char*, struct RAM*, struct RAM_VALUE* (pointer parameter that is returned), int
+parameters: struct ELEMENT*, struct RAM*, int
 returns: struct RAM_VALUE*
 */
-struct RAM_VALUE* handle_float_conversion(char* var_name, struct RAM* memory, int line);
+struct RAM_VALUE* handle_float_conversion(struct ELEMENT* parameter, struct RAM* memory, int line);
 
 //----------------------------------------------------------------------------------------------------------------------------------------------------->
 
@@ -118,6 +138,28 @@ returns: bool
 */
 bool execute_binary_expression(struct EXPR* expr, struct RAM* memory, struct RAM_VALUE* result, int line);
 
+/* execute_binary_operation
+the second half of execute_binary_expression: applies the operator to
+values already retrieved, picking the handler by their types. Also
+what an inline cache falls back to, see execute_cached_operation.
+
+parameters: int (enum OPERATORS), struct RAM_VALUE, struct RAM_VALUE, struct RAM_VALUE* (for result), int (for line)
+returns: bool
+*/
+bool execute_binary_operation(int operator, struct RAM_VALUE lhs, struct RAM_VALUE rhs, struct RAM_VALUE* result, int line);
+
+/* execute_cached_operation
+the same as execute_binary_operation for the operator of expr, but
+through the expression's inline cache: the operation picked for the
+operand types seen last is applied as long as they do not change.
+Used by execute_binary_expression, the handlers picked by
+execute_bind and the bytecode engine (see vm.h).
+
+parameters: struct EXPR*, struct RAM_VALUE, struct RAM_VALUE, struct RAM_VALUE* (for result), int (for line)
+returns: bool
+*/
+bool execute_cached_operation(struct EXPR* expr, struct RAM_VALUE lhs, struct RAM_VALUE rhs, struct RAM_VALUE* result, int line);
+
 /*evaluate_expression
 used in execute_assignment and execute_while_loop to evaluate an expression
 
@@ -198,8 +240,45 @@ bool execute_statement(struct STMT* stmt, struct RAM* memory);
 //
 // Given a nuPython program graph and a memory, 
 // executes the statements in the program graph.
+// The program graph must have been resolved first
+// via resolve_program (see resolve.h).
 // If a semantic error occurs (e.g. type error),
 // and error message is output, execution stops,
 // and the function returns.
 //
 void execute(struct STMT* program, struct RAM* memory);
+
+//
+// execute_bind
+//
+// Picks, once, the handler of every expression and assignment in
+// the program graph that execute can run (e.g. the handler of x + 1
+// adds an int variable and an int constant without checking what
+// kind of node either side is). Call it after resolve_program.
+//
+void execute_bind(struct STMT* program);
+
+//
+// execute_threaded
+//
+// Same as execute, with the same output and semantic errors, but
+// every statement and expression runs through the handler picked by
+// execute_bind, which must have been called first. execute still
+// walks the graph the old way, so the two can be compared.
+//
+void execute_threaded(struct STMT* program, struct RAM* memory);
+
+//
+// execute_print_cache_stats
+//
+// Prints, per line, the hits and misses of the inline cache of the
+// binary expression on that line (see execute_binary_expression) and
+// the hit rate. A miss is the first evaluation, or one whose operand
+// types differ from the evaluation before it. The counts are only
+// kept when built with -DRAM_STATS (make stats); without it this
+// prints a note saying so. Built that way, every engine goes
+// through the cache (see execute_cached_operation; otherwise the
+// bytecode engine does int with int inline), so the report is the
+// same whichever ran.
+//
+void execute_print_cache_stats(struct STMT* program);
@@ -0,0 +1,585 @@
+/*intern.c*/
+
+//
+// implementation of the global identifier intern pool. Two kinds of
+// open addressing tables index the same strings: by contents (used
+// to intern), and by pointer (so handing an already interned string
+// back in is just a pointer compare).
+//
+// Each kind is split into stripes, picked by the top bits of the
+// hash, and each stripe has its own lock, so threads interning or
+// looking up different names rarely wait on each other. A string's
+// contents stripe is locked before its pointer stripe, never the
+// other way around. Until intern_threads_enable is called, there is
+// only one thread and the locks are not taken.
+//
+// Irene Ha
+// Northwestern University
+// CS 211
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+#include <stdint.h>  // uintptr_t
+#include <string.h>
+
+#include "intern.h"
+
+
+#define INTERN_STRIPE_BITS 4
+#define INTERN_STRIPES (1 << INTERN_STRIPE_BITS)
+
+//
+// one stripe of a table: at most half full, capacity a power of 2,
+// empty slots are NULL. hashes, refs, kept and keeps are only kept
+// by contents.
+//
+struct INTERN_STRIPE
+{
+  int           lock;      // 1 while a thread is using the stripe
+  char**        strings;
+  unsigned int* hashes;    // contents hash of each string
+  int*          refs;      // # of references to each string
+  bool*         kept;      // true if intern_keep was called on it
+  int           capacity;
+  int           count;
+  char**        keeps;     // the strings kept, so a sweep needn't look at every slot
+  int           num_keeps;
+  int           keeps_capacity;
+};
+
+static struct INTERN_STRIPE by_contents[INTERN_STRIPES];
+static struct INTERN_STRIPE by_pointer[INTERN_STRIPES];
+
+static int  holders;   // # of intern_hold calls not yet undone, updated atomically
+static bool threaded;  // set by intern_threads_enable, locks are taken from then on
+
+
+/* intern_hash
+hashes the characters of a string (FNV-1a)
+
+parameters: char*
+returns: unsigned int
+*/
+static unsigned int intern_hash(char* s) {
+  unsigned int h = 2166136261u;
+
+  while (*s != '\0') {
+    h ^= (unsigned char)(*s);
+    h *= 16777619u;
+    s++;
+  }
+
+  return h;
+}
+
+
+/* intern_pointer_hash
+hashes a pointer value (Fibonacci hashing)
+
+parameters: char*
+returns: unsigned int
+*/
+static unsigned int intern_pointer_hash(char* s) {
+  uintptr_t p = (uintptr_t)s;
+  return (unsigned int)((p >> 3) * 2654435761u);
+}
+
+
+/* intern_stripe_of
+returns the stripe of a table a hash falls in, by its top bits (the
+bottom bits pick the slot within the stripe)
+
+parameters: struct INTERN_STRIPE*, unsigned int   // table and hash
+returns: struct INTERN_STRIPE*
+*/
+static struct INTERN_STRIPE* intern_stripe_of(struct INTERN_STRIPE* table, unsigned int h) {
+  return &table[h >> (32 - INTERN_STRIPE_BITS)];
+}
+
+
+/* intern_lock, intern_unlock
+take and give back a stripe's lock. A stripe is only held for a
+probe or two, so waiting threads spin rather than sleep.
+
+parameters: struct INTERN_STRIPE*
+returns: nothing
+*/
+static void intern_lock(struct INTERN_STRIPE* stripe) {
+  if (!__builtin_expect(__atomic_load_n(&threaded, __ATOMIC_RELAXED), 0)) {
+    return;
+  }
+
+  while (__atomic_exchange_n(&stripe->lock, 1, __ATOMIC_ACQUIRE) != 0) {
+    while (__atomic_load_n(&stripe->lock, __ATOMIC_RELAXED) != 0) {
+      ;  // spin on a plain load, not on the exchange
+    }
+  }
+}
+
+static void intern_unlock(struct INTERN_STRIPE* stripe) {
+  if (__builtin_expect(__atomic_load_n(&threaded, __ATOMIC_RELAXED), 0)) {
+    __atomic_store_n(&stripe->lock, 0, __ATOMIC_RELEASE);
+  }
+}
+
+
+/* intern_probe_contents
+finds the slot of a contents stripe holding a string equal to s, or
+the empty slot where it would go
+
+parameters: struct INTERN_STRIPE*, char*, unsigned int   // stripe, string and its contents hash
+returns: int                                              // slot #
+*/
+static int intern_probe_contents(struct INTERN_STRIPE* stripe, char* s, unsigned int h) {
+  int mask = stripe->capacity - 1;
+  int slot = (int)(h & (unsigned int)mask);
+
+  while (stripe->strings[slot] != NULL) {
+    if (stripe->hashes[slot] == h && strcmp(stripe->strings[slot], s) == 0) {
+      return slot;
+    }
+    slot = (slot + 1) & mask;
+  }
+
+  return slot;
+}
+
+
+/* intern_probe_pointer
+finds the slot of a pointer stripe holding exactly this pointer, or
+the empty slot where it would go
+
+parameters: struct INTERN_STRIPE*, char*
+returns: int   // slot #
+*/
+static int intern_probe_pointer(struct INTERN_STRIPE* stripe, char* s) {
+  int mask = stripe->capacity - 1;
+  int slot = (int)(intern_pointer_hash(s) & (unsigned int)mask);
+
+  while (stripe->strings[slot] != NULL) {
+    if (stripe->strings[slot] == s) {
+      return slot;
+    }
+    slot = (slot + 1) & mask;
+  }
+
+  return slot;
+}
+
+
+/* intern_home
+returns the slot the string in the given slot of a stripe hashes to
+
+parameters: struct INTERN_STRIPE*, bool, int   // stripe, whether it is by contents, slot #
+returns: int
+*/
+static int intern_home(struct INTERN_STRIPE* stripe, bool contents, int slot) {
+  unsigned int h = contents ? stripe->hashes[slot] : intern_pointer_hash(stripe->strings[slot]);
+  return (int)(h & (unsigned int)(stripe->capacity - 1));
+}
+
+
+/* intern_grow
+doubles a stripe (or creates it) and re-inserts every string, if one
+more string would make it more than half full
+
+parameters: struct INTERN_STRIPE*, bool   // stripe, whether it is by contents
+returns: nothing, exits if out of memory
+*/
+static void intern_grow(struct INTERN_STRIPE* stripe, bool contents) {
+  if (2 * (stripe->count + 1) <= stripe->capacity) {
+    return;
+  }
+
+  struct INTERN_STRIPE old = *stripe;
+
+  stripe->capacity = (old.capacity == 0) ? 16 : old.capacity * 2;
+  stripe->strings  = (char**)calloc(stripe->capacity, sizeof(char*));
+  stripe->hashes   = contents ? (unsigned int*)calloc(stripe->capacity, sizeof(unsigned int)) : NULL;
+  stripe->refs     = contents ? (int*)calloc(stripe->capacity, sizeof(int)) : NULL;
+  stripe->kept     = contents ? (bool*)calloc(stripe->capacity, sizeof(bool)) : NULL;
+
+  if (stripe->strings == NULL || (contents && (stripe->hashes == NULL || stripe->refs == NULL || stripe->kept == NULL))) {
+    //printf("ERROR: OUT OF MEMORY\n");
+    exit(1);
+  }
+
+  for (int i = 0; i < old.capacity; i++) {
+    if (old.strings[i] == NULL) {
+      continue;
+    }
+
+    if (contents) {
+      int slot = intern_probe_contents(stripe, old.strings[i], old.hashes[i]);
+      stripe->strings[slot] = old.strings[i];
+      stripe->hashes[slot] = old.hashes[i];
+      stripe->refs[slot] = old.refs[i];
+      stripe->kept[slot] = old.kept[i];
+    } else {
+      stripe->strings[intern_probe_pointer(stripe, old.strings[i])] = old.strings[i];
+    }
+  }
+
+  free(old.strings);
+  free(old.hashes);
+  free(old.refs);
+  free(old.kept);
+}
+
+
+/* intern_remove
+removes the string in the given slot of a stripe with backward-shift
+deletion, so linear probing never needs tombstones
+
+parameters: struct INTERN_STRIPE*, bool, int   // stripe, whether it is by contents, slot #
+returns: nothing
+*/
+static void intern_remove(struct INTERN_STRIPE* stripe, bool contents, int hole) {
+  int mask = stripe->capacity - 1;
+
+  stripe->strings[hole] = NULL;
+  stripe->count--;
+
+  int next = (hole + 1) & mask;
+  while (stripe->strings[next] != NULL) {
+    int home = intern_home(stripe, contents, next);
+
+    // can the entry at next move back into the hole? only if its home
+    // slot is not cyclically inside (hole, next]
+    bool stays = (hole <= next) ? (hole < home && home <= next)
+                                : (hole < home || home <= next);
+    if (!stays) {
+      stripe->strings[hole] = stripe->strings[next];
+      if (contents) {
+        stripe->hashes[hole] = stripe->hashes[next];
+        stripe->refs[hole] = stripe->refs[next];
+        stripe->kept[hole] = stripe->kept[next];
+      }
+      stripe->strings[next] = NULL;
+      hole = next;
+    }
+    next = (next + 1) & mask;
+  }
+}
+
+
+/* intern_mark_kept
+marks the string in the given slot of a locked contents stripe kept,
+and lists it for the next sweep if it wasn't already
+
+parameters: struct INTERN_STRIPE*, int   // contents stripe and slot #
+returns: nothing, exits if out of memory
+*/
+static void intern_mark_kept(struct INTERN_STRIPE* contents, int slot) {
+  if (contents->kept[slot]) {
+    return;
+  }
+
+  if (contents->num_keeps == contents->keeps_capacity) {
+    int capacity = (contents->keeps_capacity == 0) ? 16 : contents->keeps_capacity * 2;
+    char** keeps = (char**)realloc(contents->keeps, capacity * sizeof(char*));
+    if (keeps == NULL) {
+      //printf("ERROR: OUT OF MEMORY\n");
+      exit(1);
+    }
+    contents->keeps = keeps;
+    contents->keeps_capacity = capacity;
+  }
+
+  contents->keeps[contents->num_keeps] = contents->strings[slot];
+  contents->num_keeps++;
+  contents->kept[slot] = true;
+}
+
+
+/* intern_add
+intern and intern_keep: returns the canonical copy of s, adding a
+copy to the pool the first time s is seen, and adds a reference to
+it or marks it kept
+
+parameters: char*, bool   // s (not NULL), true to keep rather than add a reference
+returns: char*
+*/
+static char* intern_add(char* s, bool keep) {
+  unsigned int h = intern_hash(s);
+  struct INTERN_STRIPE* contents = intern_stripe_of(by_contents, h);
+  intern_lock(contents);
+
+  // Step 1: already in the pool? one more reference then
+  if (contents->capacity != 0) {
+    int slot = intern_probe_contents(contents, s, h);
+    if (contents->strings[slot] != NULL) {
+      if (keep) {
+        intern_mark_kept(contents, slot);
+      } else {
+        contents->refs[slot]++;
+      }
+      char* canonical = contents->strings[slot];
+      intern_unlock(contents);
+      return canonical;
+    }
+  }
+
+  // Step 2: copy the string and index it by contents
+  size_t len = strlen(s) + 1;  // +1 for the null terminator
+  char* copy = (char*)malloc(len * sizeof(char));
+  if (copy == NULL) {
+    //printf("ERROR: OUT OF MEMORY\n");
+    exit(1);
+  }
+  memcpy(copy, s, len);
+
+  intern_grow(contents, true);
+  int slot = intern_probe_contents(contents, copy, h);
+  contents->strings[slot] = copy;
+  contents->hashes[slot] = h;
+  contents->refs[slot] = keep ? 0 : 1;
+  contents->kept[slot] = false;
+  contents->count++;
+  if (keep) {
+    intern_mark_kept(contents, slot);
+  }
+
+  // Step 3: and by pointer, before anyone else can see it
+  struct INTERN_STRIPE* pointers = intern_stripe_of(by_pointer, intern_pointer_hash(copy));
+  intern_lock(pointers);
+  intern_grow(pointers, false);
+  pointers->strings[intern_probe_pointer(pointers, copy)] = copy;
+  pointers->count++;
+  intern_unlock(pointers);
+
+  intern_unlock(contents);
+  return copy;
+}
+
+
+/* intern_drop
+removes the string in the given slot of a locked contents stripe from
+both tables, and frees it
+
+parameters: struct INTERN_STRIPE*, int   // contents stripe and slot #
+returns: nothing
+*/
+static void intern_drop(struct INTERN_STRIPE* contents, int slot) {
+  char* s = contents->strings[slot];
+  intern_remove(contents, true, slot);
+
+  struct INTERN_STRIPE* pointers = intern_stripe_of(by_pointer, intern_pointer_hash(s));
+  intern_lock(pointers);
+  intern_remove(pointers, false, intern_probe_pointer(pointers, s));
+  intern_unlock(pointers);
+
+  free(s);
+}
+
+
+/* intern_sweep
+once the last holder is gone, drops every kept string nothing else
+references, and unmarks the rest. Only the kept strings are looked
+at, so the cost is that of keeping them. Stops if a new holder turns
+up, what it has not reached yet waits for the next sweep.
+
+parameters: none
+returns: nothing
+*/
+static void intern_sweep(void) {
+  for (int i = 0; i < INTERN_STRIPES; i++) {
+    struct INTERN_STRIPE* contents = &by_contents[i];
+    intern_lock(contents);
+
+    if (__atomic_load_n(&holders, __ATOMIC_ACQUIRE) != 0) {
+      intern_unlock(contents);
+      return;
+    }
+
+    // a kept string only leaves the pool here, so each one listed is
+    // still in it
+    for (int k = 0; k < contents->num_keeps; k++) {
+      char* s = contents->keeps[k];
+      int slot = intern_probe_contents(contents, s, intern_hash(s));
+
+      if (contents->refs[slot] > 0) {
+        contents->kept[slot] = false;
+      } else {
+        intern_drop(contents, slot);
+      }
+    }
+    contents->num_keeps = 0;
+
+    intern_unlock(contents);
+  }
+}
+
+
+//
+// Public functions:
+//
+
+//
+// intern
+//
+// Returns the canonical copy of the given string, adding a copy
+// to the pool the first time the string is seen, and adds a
+// reference to it. Returns NULL if s is NULL.
+//
+char* intern(char* s)
+{
+  if (s == NULL) {
+    return NULL;
+  }
+
+  return intern_add(s, false);
+}
+
+
+//
+// intern_keep
+//
+// Like intern, but rather than adding a reference, keeps the
+// canonical copy for as long as there are holders.
+//
+char* intern_keep(char* s)
+{
+  if (s == NULL) {
+    return NULL;
+  }
+
+  return intern_add(s, true);
+}
+
+
+//
+// intern_release
+//
+// Drops a reference to a canonical copy returned by intern,
+// removing it from the pool (and freeing it) when the last
+// reference is gone, unless it is kept. Does nothing if s is NULL.
+//
+void intern_release(char* s)
+{
+  if (s == NULL) {
+    return;
+  }
+
+  unsigned int h = intern_hash(s);
+  struct INTERN_STRIPE* contents = intern_stripe_of(by_contents, h);
+  intern_lock(contents);
+
+  if (contents->capacity == 0) {  // empty stripe, s can't be canonical
+    intern_unlock(contents);
+    return;
+  }
+
+  int slot = intern_probe_contents(contents, s, h);
+  if (contents->strings[slot] != s) {  // not a canonical copy
+    intern_unlock(contents);
+    return;
+  }
+
+  contents->refs[slot]--;
+  if (contents->refs[slot] == 0 && !contents->kept[slot]) {
+    intern_drop(contents, slot);
+  }
+
+  intern_unlock(contents);
+}
+
+
+//
+// intern_hold
+//
+// Adds a holder: strings passed to intern_keep stay in the pool
+// until every holder has called intern_unhold.
+//
+void intern_hold(void)
+{
+  __atomic_add_fetch(&holders, 1, __ATOMIC_ACQ_REL);
+}
+
+
+//
+// intern_unhold
+//
+// Removes a holder added by intern_hold. The last one to go drops
+// every kept string nothing references any more, in one sweep of
+// the pool.
+//
+void intern_unhold(void)
+{
+  if (__atomic_sub_fetch(&holders, 1, __ATOMIC_ACQ_REL) == 0) {
+    intern_sweep();
+  }
+}
+
+
+//
+// intern_threads_enable
+//
+// From now on the pool may be used by several threads at once, so
+// its stripes are locked. Must be called before a second thread
+// uses the pool, there is no going back.
+//
+void intern_threads_enable(void)
+{
+  __atomic_store_n(&threaded, true, __ATOMIC_RELEASE);
+}
+
+
+//
+// intern_find
+//
+// Like intern, but never adds to the pool or adds a reference:
+// returns the canonical copy of the given string, or NULL if the
+// string is not in the pool.
+//
+char* intern_find(char* s)
+{
+  if (s == NULL) {
+    return NULL;
+  }
+
+  // fast path: s is itself a canonical copy
+  if (intern_is_canonical(s)) {
+    return s;
+  }
+
+  // slow path: look the characters up
+  unsigned int h = intern_hash(s);
+  struct INTERN_STRIPE* contents = intern_stripe_of(by_contents, h);
+  char* canonical = NULL;
+
+  intern_lock(contents);
+  if (contents->capacity != 0) {
+    canonical = contents->strings[intern_probe_contents(contents, s, h)];
+  }
+  intern_unlock(contents);
+
+  return canonical;
+}
+
+
+//
+// intern_is_canonical
+//
+// Returns true if the given pointer is a canonical copy handed out
+// by intern, false otherwise. Only looks at the pointer.
+//
+bool intern_is_canonical(char* s)
+{
+  if (s == NULL) {
+    return false;
+  }
+
+  struct INTERN_STRIPE* pointers = intern_stripe_of(by_pointer, intern_pointer_hash(s));
+  bool canonical = false;
+
+  intern_lock(pointers);
+  if (pointers->capacity != 0) {
+    canonical = (pointers->strings[intern_probe_pointer(pointers, s)] == s);
+  }
+  intern_unlock(pointers);
+
+  return canonical;
+}
@@ -16,30 +16,73 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>  // true, false
-#include <string.h>   // strcspn
+#include <string.h>   // strcspn, strcmp
 
 #include "token.h"    // token defs
 #include "scanner.h" 
 #include "parser.h"
 
 #include "programgraph.h"
+#include "resolve.h"
 #include "ram.h"
+#include "ram_image.h"
+#include "ram_dump.h"
 #include "execute.h"
+#include "vm.h"
+
+
+//
+// how main runs the program, see engine= below
+//
+enum ENGINES
+{
+  ENGINE_TREE = 0,
+  ENGINE_VM,
+  ENGINE_THREADED
+};
 
 
 //
 // main
 //
-// usage: program.exe [filename.py]
+// usage: program.exe [filename.py [image.ram] [name=value ...]]
 // 
 // If a filename is given, the file is opened and serves as
 // input to the program. If a filename is not given, then 
-// input is taken from the keyboard until $ is input.
+// input is taken from the keyboard until $ is input. If an
+// image filename is also given, the final contents of memory
+// are saved there (see ram_image.h). Arguments of the form
+// name=value are options for the final dump of memory, e.g.
+// format=json match=x* (see ram_dump_option), except for
+// engine=tree|vm|threaded, which picks how the program is run:
+// by walking the program graph (see execute, the default),
+// compiled to bytecode (see vm.h), or by walking the graph through
+// handlers picked once per node (see execute_threaded).
 //
 int main(int argc, char* argv[])
 {
   FILE* input = NULL;
   bool  keyboardInput = false;
+  char* image = NULL;
+  int   engine = ENGINE_TREE;
+  struct RAM_DUMP_OPTIONS dump;
+
+  ram_dump_options_init(&dump);
+
+  for (int i = 2; i < argc; i++) {
+    if (strchr(argv[i], '=') == NULL) {
+      image = argv[i];
+    } else if (strcmp(argv[i], "engine=vm") == 0) {
+      engine = ENGINE_VM;
+    } else if (strcmp(argv[i], "engine=tree") == 0) {
+      engine = ENGINE_TREE;
+    } else if (strcmp(argv[i], "engine=threaded") == 0) {
+      engine = ENGINE_THREADED;
+    } else if (!ram_dump_option(&dump, argv[i])) {
+      printf("**ERROR: invalid dump option '%s'.\n", argv[i]);
+      return 0;
+    }
+  }
 
   //
   // where is the input coming from?
@@ -91,12 +134,39 @@ int main(int argc, char* argv[])
 
     printf("**building program graph...\n"); // add printf stmt
     struct STMT* program = programgraph_build(tokens); // call to programbuild()
+    int num_variables = resolve_program(program); // intern identifiers etc. before executing
     // programgraph_print(program); // call to programprint()
-    printf("**executing...\n"); // add print
-    struct RAM* memory = ram_init();
-    execute(program, memory);
-    printf("**done\n");
-    ram_print(memory); // output final contents of memory
+
+    if (num_variables < 0) {
+      //
+      // unsupported function call, error msgs already output:
+      //
+      printf("**resolving failed...\n");
+    }
+    else
+    {
+      printf("**executing...\n"); // add print
+      struct RAM* memory = ram_init_with_capacity(num_variables); // room for every variable, never grows
+      if (engine == ENGINE_VM) {
+        struct VM_PROGRAM* vm = vm_compile(program, num_variables); // lower the graph once
+        vm_execute(vm, memory);
+        vm_destroy(vm);
+      } else if (engine == ENGINE_THREADED) {
+        execute_bind(program); // pick the handlers once
+        execute_threaded(program, memory);
+      } else {
+        execute(program, memory);
+      }
+      printf("**done\n");
+      ram_dump(memory, &dump, stdout); // output final contents of memory
+      if (image != NULL && !ram_image_save(memory, image)) {
+        printf("**ERROR: unable to save memory image '%s'.\n", image);
+      }
+#ifdef RAM_STATS
+      ram_print_stats(memory); // which variables the memory traffic went to (make stats)
+      execute_print_cache_stats(program); // how well the inline caches of expressions did
+#endif
+    }
 
     tokenqueue_destroy(tokens);
   }
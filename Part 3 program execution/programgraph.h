@@ -12,6 +12,7 @@
 
 #include <stdbool.h>     // true, false
 #include "tokenqueue.h"
+#include "ram.h"              // struct RAM_VALUE
 
 
 //
@@ -62,6 +63,31 @@ struct STMT_ASSIGNMENT
   struct VALUE* rhs;  // rhs = "right-hand side"
 
   struct STMT* next_stmt;
+
+  //
+  // filled in by resolve_program (see resolve.h) once the graph
+  // is built, programgraph_build does not set these:
+  //
+  char* var_identifier;  // interned copy of var_name
+  int   var_slot;        // slot # of var_name, one per distinct variable
+
+  //
+  // picked by execute_bind (see execute.h), resolve_program sets it
+  // to NULL: runs this assignment when executing threaded
+  //
+  bool (*handler)(struct STMT* stmt, struct RAM* memory);
+};
+
+//
+// builtin functions, resolve_program maps each function name to one
+//
+enum BUILTINS
+{
+  BUILTIN_UNKNOWN = 0,
+  BUILTIN_PRINT,
+  BUILTIN_INPUT,
+  BUILTIN_INT,
+  BUILTIN_FLOAT
 };
 
 struct STMT_FUNCTION_CALL
@@ -74,6 +100,12 @@ struct STMT_FUNCTION_CALL
   struct ELEMENT* parameter;  // optional => could be NULL
 
   struct STMT* next_stmt;
+
+  //
+  // filled in by resolve_program (see resolve.h) once the graph
+  // is built, programgraph_build does not set this:
+  //
+  int builtin;  // enum BUILTINS
 };
 
 struct STMT_IF_THEN_ELSE
@@ -141,6 +173,8 @@ struct FUNCTION_CALL
 {
   char* function_name;
   struct ELEMENT* parameter;  // optional => could be NULL
+
+  int builtin;  // enum BUILTINS, filled in by resolve_program
 };
 
 struct EXPR
@@ -151,6 +185,24 @@ struct EXPR
 
   int    operator;        // enum OPERATORS
   struct UNARY_EXPR* rhs; // optional => could be NULL
+
+  //
+  // picked by execute_bind (see execute.h), resolve_program sets it
+  // to NULL: evaluates this expression when executing threaded
+  //
+  bool (*handler)(struct EXPR* expr, struct RAM* memory, struct RAM_VALUE* result, int line);
+
+  //
+  // inline cache of execute_binary_expression (see execute.c),
+  // emptied by resolve_program: the operand types seen last and the
+  // operation picked for them, NULL => empty. The hits and misses
+  // are only counted when built with -DRAM_STATS.
+  //
+  int  cache_lhs_type;  // enum RAM_VALUE_TYPES
+  int  cache_rhs_type;
+  bool (*cache_operation)(struct EXPR* expr, struct RAM_VALUE lhs, struct RAM_VALUE rhs, struct RAM_VALUE* result, int line);
+  unsigned long cache_hits;
+  unsigned long cache_misses;
 };
 
 enum UNARY_EXPR_TYPES
@@ -201,6 +253,15 @@ struct ELEMENT
   // underlying element (identifier or literal):
   //
   char* element_value;  // e.g. "x" or "123" or "3.14" or "this is a string"
+
+  //
+  // filled in by resolve_program (see resolve.h) once the graph
+  // is built, programgraph_build does not set these:
+  //
+  char* identifier;  // interned copy of element_value if ELEMENT_IDENTIFIER, else NULL
+  int   slot;        // slot # of the variable if ELEMENT_IDENTIFIER, else -1
+  struct RAM_VALUE constant;  // decoded value of a literal, True or False,
+                              // else RAM_TYPE_NONE; a str points at element_value
 };
 
 
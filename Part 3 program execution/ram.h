@@ -10,7 +10,9 @@
 
 #pragma once
 
+#include <stdio.h>    // FILE
 #include <stdbool.h>  // true, false
+#include <stdint.h>   // uint64_t
 
 
 //
@@ -44,17 +46,294 @@ struct RAM_VALUE
   } types;
 };
 
+//
+// Strings of up to RAM_INLINE_STR_MAX chars are stored inside the
+// cell itself (value.types.s then points at inline_str), longer ones
+// are kept on the heap. Either way they are read and written through
+// the same functions below. Compile with -DRAM_INLINE_STR_MAX=0 to
+// store (almost) every string on the heap.
+//
+// Heap strings are immutable and reference counted: assigning one
+// variable to another, or reading a copy of a value, shares the
+// string instead of duplicating it. Never modify a string obtained
+// from memory in place.
+//
+#ifndef RAM_INLINE_STR_MAX
+#define RAM_INLINE_STR_MAX 15
+#endif
+
 struct RAM_CELL
 {
-  char* identifier;  // variable name for this memory cell
+  char* identifier;  // variable name for this memory cell (interned, see intern.h)
   struct RAM_VALUE value;
+  char inline_str[RAM_INLINE_STR_MAX + 1];  // holds value.types.s if it is short enough
+};
+
+//
+// How memory is laid out, chosen when memory is created:
+//
+//   RAM_LAYOUT_CELLS: an array of RAM_CELLs (the default)
+//   RAM_LAYOUT_SOA:   structure of arrays --- type tags, 8-byte
+//                     payloads and identifiers each in their own
+//                     array, so scans over one of them touch far
+//                     less memory. cells is NULL in this layout.
+//   RAM_LAYOUT_BOXED: like RAM_LAYOUT_SOA, but without the tags:
+//                     each value is one NaN-boxed 8-byte word in
+//                     payloads (see ram_box), half a RAM_VALUE.
+//                     cells and tags are NULL in this layout.
+//
+enum RAM_LAYOUTS
+{
+  RAM_LAYOUT_CELLS = 0,
+  RAM_LAYOUT_SOA,
+  RAM_LAYOUT_BOXED
+};
+
+union RAM_PAYLOAD
+{
+  int    i; // INT, PTR, BOOLEAN
+  double d; // REAL
+  char*  s; // STR, always on the heap in the SoA layout
+  uint64_t box;  // the whole value, in the boxed layout
+};
+
+//
+// NaN-boxing, see ram_box. A real is stored as its own bits (every
+// NaN as RAM_BOX_NAN); anything else sets the top 13 bits --- a
+// negative quiet NaN, which RAM_BOX_NAN means no real is stored as
+// --- with value_type + 1 in the next 3 bits and the value in the
+// low 48: an int as its 32 bits, a string as its pointer.
+//
+#define RAM_BOX_NAN     0x7FF8000000000000ULL
+#define RAM_BOX_TAGGED  0xFFF8000000000000ULL
+#define RAM_BOX_PAYLOAD 0x0000FFFFFFFFFFFFULL
+
+//
+// the value_type of a boxed word, without unboxing it
+//
+#define RAM_BOX_TYPE(box) \
+  ((((box) & RAM_BOX_TAGGED) != RAM_BOX_TAGGED) ? RAM_TYPE_REAL : (int)(((box) >> 48) & 7) - 1)
+
+//
+// A write hook is called after a value has been written to memory,
+// with the address written and the value now stored there (borrowed,
+// same contract as ram_peek_cell_by_addr). context is whatever was
+// passed to ram_add_write_hook.
+//
+struct RAM;
+
+typedef void (*RAM_WRITE_HOOK)(struct RAM* memory, int address, const struct RAM_VALUE* value, void* context);
+
+struct RAM_HOOK
+{
+  int id;            // handed out by ram_add_write_hook
+  int address;       // address watched, or -1 for every write
+  RAM_WRITE_HOOK fn;
+  void* context;
+};
+
+//
+// Access counts for one cell, see ram_print_stats
+//
+struct RAM_CELL_STATS
+{
+  unsigned long reads;      // ram_read_cell_* and ram_peek_cell_* calls
+  unsigned long writes;     // ram_write_cell_* calls
+  unsigned long lookups;    // times the name was found by ram_get_addr
+  unsigned long str_bytes;  // string bytes copied in or out of the cell
+};
+
+//
+// One entry of the write log behind ram_changed_since: the cell at
+// address was written (at least once) during epoch
+//
+struct RAM_TOUCH
+{
+  int address;
+  int epoch;
+};
+
+//
+// One entry of the undo journal behind ram_rollback: the value a
+// write overwrote, or that the write created the cell
+//
+struct RAM_UNDO
+{
+  int  address;
+  bool created;          // true => undo removes the cell again
+  struct RAM_VALUE old;  // value before the write, a string holds a shared reference
+};
+
+//
+// The string arena, see ram_compact. Strings stored in memory are
+// carved out of RAM_ARENA_CHUNK_SIZE-byte chunks in blocks of 32, 64,
+// ..., 4096 bytes; a block freed by an overwrite goes on the free
+// list of its size class, for the next string of that size. Longer
+// strings are malloc'ed on their own.
+//
+#define RAM_ARENA_CLASSES 8
+#define RAM_ARENA_CHUNK_SIZE (64 * 1024)
+
+//
+// ram_compact compacts on its own once at least this many bytes
+// are on the free lists and they outnumber the bytes in use
+//
+#define RAM_ARENA_COMPACT_MIN (64 * 1024)
+
+struct RAM_ARENA_CHUNK;  // see ram.c
+
+//
+// An array or string the writer dropped while concurrent readers
+// may still be looking at it, see ram_readers_enable
+//
+struct RAM_RETIRED
+{
+  void* ptr;
+  bool  is_str;  // true => a shared string to release, else an array to free
+};
+
+//
+// A copy-on-write snapshot of a memory, see ram_snapshot. The cells
+// are split into page-sized chunks of RAM_SNAPSHOT_CHUNK cells. A
+// chunk stays shared with the live memory until the memory is about
+// to write to it; then the memory first copies the chunk into every
+// snapshot still sharing it. Strings in a copied chunk are shared,
+// not duplicated (only inline strings are copied with their cell).
+//
+#define RAM_SNAPSHOT_CHUNK ((int)(4096 / sizeof(struct RAM_CELL)))
+
+struct RAM_SNAPSHOT
+{
+  struct RAM* memory;         // live memory, NULL once it is destroyed
+  int num_values;             // # of values when the snapshot was taken
+  int num_chunks;
+  struct RAM_CELL** chunks;   // chunks[c] is NULL while chunk c is shared
+  struct RAM_VALUE peeked;
 };
 
 struct RAM
 {
-  struct RAM_CELL* cells;  // array of memory cells
+  struct RAM_CELL* cells;  // array of memory cells (RAM_LAYOUT_CELLS only)
   int num_values;  // # of values currently stored in memory
   int capacity;    // total # of cells available in memory
+
+  //
+  // hash index over the identifiers: each slot holds the address
+  // of a cell plus index_base, or less than index_base if the slot
+  // is empty. Uses open addressing with linear probing, and is kept
+  // at twice the capacity so it is never more than half full.
+  // Addresses stored here are the same addresses handed out by
+  // ram_get_addr, they never move. ram_reset empties the index by
+  // raising index_base past every address stored so far.
+  //
+  int* index;
+  int  index_capacity;  // # of slots in index, always a power of 2
+  int  index_base;
+
+  //
+  // addresses remembered by ram_get_addr_by_slot: slot_addrs[s] is
+  // the address last found for the caller's slot s, or -1. An entry
+  // is only used after checking the cell still holds the slot's
+  // identifier, so a reset or a rollback needs no clean-up here.
+  //
+  int* slot_addrs;
+  int  num_slot_addrs;
+
+  //
+  // registered write hooks. num_hooks is 0 when there are none, so
+  // a write only pays for that one check (kept next to the fields
+  // every write reads anyway, in the same cache line).
+  //
+  int num_hooks;
+  struct RAM_HOOK* hooks;
+  int hooks_capacity;
+  int next_hook_id;
+
+  //
+  // RAM_LAYOUT_SOA: the value at address a is tags[a] / payloads[a],
+  // its identifier is identifiers[a]. Each array has capacity
+  // entries. RAM_LAYOUT_BOXED has no tags, payloads[a].box is the
+  // value. peeked holds the value handed out by ram_peek_cell_*.
+  //
+  int layout;  // enum RAM_LAYOUTS
+  unsigned char*     tags;         // value_type of each cell
+  union RAM_PAYLOAD* payloads;     // value of each cell
+  char**             identifiers;  // interned identifier of each cell
+  struct RAM_VALUE   peeked;
+
+  //
+  // per-address access counts, capacity entries. Only kept when
+  // ram.c is built with -DRAM_STATS, NULL otherwise.
+  //
+  struct RAM_CELL_STATS* stats;
+
+  //
+  // dirty tracking, see ram_next_epoch and ram_changed_since. A
+  // cell's bit in dirty is set by every write and cleared when the
+  // next epoch starts. touches logs each cell once per epoch it is
+  // written in, in epoch order, so a diff only walks changed cells.
+  //
+  unsigned long*    dirty;          // 1 bit per address
+  int*              touched_epoch;  // per address, last epoch written, -1 if never
+  struct RAM_TOUCH* touches;
+  int num_touches;
+  int touches_capacity;
+  int epoch;  // current epoch #, starts at 0
+
+  //
+  // undo journal, see ram_begin. Writes are only journaled while a
+  // transaction is open (num_marks > 0); marks[i] is where the i-th
+  // open transaction starts in the journal. The journal is emptied
+  // but kept when the outermost transaction ends, so steady-state
+  // transactions don't allocate.
+  //
+  struct RAM_UNDO* journal;
+  int  journal_length;
+  int  journal_capacity;
+  int* marks;
+  int  num_marks;
+  int  marks_capacity;
+
+  //
+  // snapshots still sharing chunks with this memory, see
+  // ram_snapshot. Writes only look further when there are any.
+  //
+  struct RAM_SNAPSHOT** snapshots;
+  int num_snapshots;
+  int snapshots_capacity;
+
+  //
+  // concurrent readers, see ram_readers_enable. seqs[addr] is odd
+  // while the cell is being written, shape is odd while cells are
+  // being created, removed or moved. What the writer drops while
+  // readers may still hold it waits in retired until no reader is
+  // inside a read.
+  //
+  bool readers_enabled;
+  unsigned int* seqs;
+  unsigned int shape;
+  int readers;  // # of reads in progress, updated atomically
+  struct RAM_RETIRED* retired;
+  int num_retired;
+  int retired_capacity;
+
+  //
+  // string arena, see RAM_ARENA_CLASSES. arena_chunks is sorted by
+  // address, so a string can be recognized as this memory's own;
+  // arena_top is the chunk new blocks are bumped off, arena_free[c]
+  // the free list of size class c. num_foreign_strs counts the cells
+  // holding a string that is not in the arena (too long, from another
+  // memory, or published by a read); when there are none, ram_destroy
+  // frees the arena's chunks without looking at a single cell.
+  //
+  struct RAM_ARENA_CHUNK** arena_chunks;
+  int    num_arena_chunks;
+  int    arena_chunks_capacity;
+  struct RAM_ARENA_CHUNK* arena_top;
+  void*  arena_free[RAM_ARENA_CLASSES];
+  size_t arena_live_bytes;
+  size_t arena_free_bytes;
+  int    num_foreign_strs;
 };
 
 
@@ -84,6 +363,45 @@ char* dupString(char* s);
 //
 struct RAM* ram_init(void);
 
+//
+// ram_init_layout
+//
+// Like ram_init, but stores the values using the given layout
+// (enum RAM_LAYOUTS). Returns NULL if the layout is unknown.
+// Every layout behaves the same through the functions below,
+// except that in RAM_LAYOUT_SOA and RAM_LAYOUT_BOXED a peeked
+// value is only valid until the next peek or write.
+//
+struct RAM* ram_init_layout(int layout);
+
+//
+// ram_box
+//
+// Returns the given value packed into one 64-bit word, the way
+// RAM_LAYOUT_BOXED stores it. A string is not copied, the word
+// holds the pointer. Every value round-trips through ram_unbox
+// unchanged, except that a NaN comes back as the one NaN
+// RAM_BOX_NAN encodes.
+//
+uint64_t ram_box(struct RAM_VALUE value);
+
+//
+// ram_unbox
+//
+// Returns the value packed into the given word by ram_box.
+//
+struct RAM_VALUE ram_unbox(uint64_t box);
+
+//
+// ram_init_with_capacity
+//
+// Like ram_init, but with room for the given # of values
+// (never less than the 4 of ram_init) before memory has to
+// grow. Use it when the # of variables is known up front
+// (see resolve_program), so writing them never reallocates.
+//
+struct RAM* ram_init_with_capacity(int capacity);
+
 //
 // ram_destroy
 //
@@ -93,6 +411,23 @@ struct RAM* ram_init(void);
 //
 void ram_destroy(struct RAM* memory);
 
+//
+// ram_reset
+//
+// Empties the memory so it can be used again as if it had just
+// been created, but keeps what it has allocated: the cells, the
+// hash index, the journal and the first chunk of the string arena.
+// The index and the dirty bits are invalidated by moving on to a
+// new base and a new epoch rather than by clearing them, so the
+// cost does not depend on the capacity; only strings from outside
+// the arena are released one by one. The cells' names stay in the
+// intern pool (see intern_keep) until the last memory is destroyed.
+// Open transactions are
+// dropped, write hooks are removed, concurrent readers must have
+// stopped, and snapshots are detached as by ram_destroy.
+//
+void ram_reset(struct RAM* memory);
+
 //
 // ram_get_addr
 // 
@@ -108,6 +443,18 @@ void ram_destroy(struct RAM* memory);
 //
 int ram_get_addr(struct RAM* memory, char* identifier);
 
+//
+// ram_get_addr_by_slot
+//
+// ram_get_addr for a caller that numbers its identifiers (e.g. the
+// slots of resolve.h): the address found for the given slot # is
+// remembered by the memory, so asking again costs a check that the
+// cell still holds the identifier instead of a lookup. The
+// identifier must be interned (see intern.h). Returns -1 if it has
+// not been written to memory, or if slot < 0.
+//
+int ram_get_addr_by_slot(struct RAM* memory, int slot, char* identifier);
+
 //
 // ram_read_cell_by_addr
 //
@@ -117,7 +464,9 @@ int ram_get_addr(struct RAM* memory, char* identifier);
 //
 // NOTE: this function allocates memory for the value that
 // is returned. The caller takes ownership of the copy and 
-// must eventually free this memory via ram_free_value().
+// must eventually free this memory via ram_free_value(). A
+// string in the copy is shared with memory and must not be
+// modified; writing the copy back to memory does not copy it again.
 //
 // NOTE: a variable has to be written to memory before its
 // address becomes valid. Once a variable is written to memory,
@@ -138,11 +487,42 @@ struct RAM_VALUE* ram_read_cell_by_addr(struct RAM* memory, int address);
 //
 struct RAM_VALUE* ram_read_cell_by_name(struct RAM* memory, char* name);
 
+//
+// ram_peek_cell_by_addr
+//
+// Given a memory address (an integer in the range 0..N-1),
+// returns a pointer to the value stored in that memory cell
+// WITHOUT making a copy. Returns NULL if the address is not valid.
+//
+// NOTE: the value is borrowed, the caller must not modify or
+// free it. The pointer (and any string it holds) is valid until
+// the next write to memory, so copy what you need before writing.
+// In RAM_LAYOUT_SOA the next peek also invalidates the pointer
+// (the string it holds stays valid until the next write).
+//
+const struct RAM_VALUE* ram_peek_cell_by_addr(struct RAM* memory, int address);
+
+//
+// ram_peek_cell_by_name
+//
+// If the given name (e.g. "x") has been written to memory,
+// returns a pointer to the value stored in memory WITHOUT
+// making a copy. Returns NULL if no such name exists in memory.
+//
+// NOTE: the value is borrowed, the caller must not modify or
+// free it. The pointer (and any string it holds) is valid until
+// the next write to memory, so copy what you need before writing.
+// In RAM_LAYOUT_SOA the next peek also invalidates the pointer
+// (the string it holds stays valid until the next write).
+//
+const struct RAM_VALUE* ram_peek_cell_by_name(struct RAM* memory, char* name);
+
 //
 // ram_free_value
 //
 // Frees the memory value returned by ram_read_cell_by_name and
-// ram_read_cell_by_addr.
+// ram_read_cell_by_addr. A string in the value is released, and
+// freed once no cell or other copy shares it anymore.
 //
 void ram_free_value(struct RAM_VALUE* value);
 
@@ -155,8 +535,9 @@ void ram_free_value(struct RAM_VALUE* value);
 // the value was successfully written, false if not (which 
 // implies the memory address is invalid).
 // 
-// NOTE: if the value being written is a string, it will
-// be duplicated and stored.
+// NOTE: if the value being written is a string, it will be
+// duplicated and stored, unless it already is a string from
+// memory (then it is shared).
 // 
 // NOTE: a variable has to be written to memory before its
 // address becomes valid. Once a variable is written to memory,
@@ -172,8 +553,9 @@ bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int addr
 // existing value is overwritten by this new value. Returns
 // true since this operation always succeeds.
 // 
-// NOTE: if the value being written is a string, it will
-// be duplicated and stored.
+// NOTE: if the value being written is a string, it will be
+// duplicated and stored, unless it already is a string from
+// memory (then it is shared).
 // 
 // NOTE: a variable has to be written to memory before its
 // address becomes valid. Once a variable is written to memory,
@@ -181,6 +563,231 @@ bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int addr
 //
 bool ram_write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* name);
 
+//
+// ram_add_write_hook
+//
+// Registers fn to be called after every write to the given
+// address, or after every write at all if address is -1. Writes
+// through both ram_write_cell_by_addr and ram_write_cell_by_name
+// (including the write that creates a variable) call the hooks,
+// in the order they were added. Returns an id for
+// ram_remove_write_hook, or -1 if out of memory.
+//
+// NOTE: a hook must not add or remove hooks. It may read memory,
+// but writing to memory from a hook calls the hooks again.
+//
+int ram_add_write_hook(struct RAM* memory, int address, RAM_WRITE_HOOK fn, void* context);
+
+//
+// ram_remove_write_hook
+//
+// Removes the hook with the given id. Returns true if it was
+// removed, false if there is no such hook.
+//
+bool ram_remove_write_hook(struct RAM* memory, int id);
+
+//
+// ram_begin
+//
+// Starts a transaction: from now on every write records the value
+// it overwrites (or that it created the variable), so that
+// ram_rollback can undo it. Transactions nest, e.g. one per
+// statement inside one for the whole run. Returns false if out of
+// memory.
+//
+bool ram_begin(struct RAM* memory);
+
+//
+// ram_commit
+//
+// Ends the innermost transaction, keeping its writes. Inside an
+// outer transaction they can still be undone by rolling that one
+// back. Returns false if no transaction is open.
+//
+bool ram_commit(struct RAM* memory);
+
+//
+// ram_rollback
+//
+// Ends the innermost transaction, undoing its writes newest first:
+// overwritten values (strings included) are restored, and variables
+// it created are removed again, so their addresses are handed out
+// again by later writes. Takes time proportional to the # of writes
+// undone. Write hooks are called for restored cells. Returns false
+// if no transaction is open.
+//
+bool ram_rollback(struct RAM* memory);
+
+//
+// ram_compact
+//
+// A safe point for compacting the string arena: if force is true,
+// or the arena is fragmented enough (see RAM_ARENA_COMPACT_MIN),
+// moves every string in use into fresh chunks, back to back, and
+// frees the old ones (a chunk holding a string shared with a read
+// copy or snapshot stays until that string is released). Does
+// nothing while a transaction is open or concurrent readers are
+// enabled. Returns true if it compacted.
+//
+// NOTE: compacting invalidates strings peeked from memory, so the
+// executor calls this between statements, never during one.
+//
+bool ram_compact(struct RAM* memory, bool force);
+
+//
+// ram_snapshot
+//
+// Returns an immutable snapshot of the given memory as it is now,
+// or NULL if out of memory. Taking a snapshot copies nothing: the
+// snapshot shares the cells (in page-sized chunks) and the strings
+// with the memory, and a chunk is only copied when the memory is
+// about to write to it. The snapshot must be released with
+// ram_snapshot_release; it stays usable after the memory itself
+// is destroyed.
+//
+struct RAM_SNAPSHOT* ram_snapshot(struct RAM* memory);
+
+//
+// ram_snapshot_release
+//
+// Frees the snapshot. After the call returns, you cannot use it.
+//
+void ram_snapshot_release(struct RAM_SNAPSHOT* snapshot);
+
+//
+// ram_snapshot_peek_by_addr
+//
+// Returns a pointer to the value at the given address at the time
+// the snapshot was taken, WITHOUT making a copy, or NULL if the
+// address was not valid then. The value is borrowed: it is valid
+// until the next write to the live memory or the next peek.
+//
+const struct RAM_VALUE* ram_snapshot_peek_by_addr(struct RAM_SNAPSHOT* snapshot, int address);
+
+//
+// ram_snapshot_peek_by_name
+//
+// Like ram_snapshot_peek_by_addr, for the variable with the given
+// name. Returns NULL if there was no such variable.
+//
+const struct RAM_VALUE* ram_snapshot_peek_by_name(struct RAM_SNAPSHOT* snapshot, char* name);
+
+//
+// ram_snapshot_print
+//
+// Prints the snapshot to the console, in the format of ram_print.
+//
+void ram_snapshot_print(struct RAM_SNAPSHOT* snapshot);
+
+//
+// ram_readers_enable
+//
+// Lets other threads read memory with ram_read_concurrent while
+// this thread keeps executing (and writing). Call it from the
+// writing thread before starting any reader. Writes get slightly
+// more expensive: each one is bracketed by a per-cell sequence #,
+// and arrays and strings the writer drops are only freed once no
+// reader is inside a read. Returns false if out of memory.
+//
+// NOTE: only ever one thread may write (or call any other ram_
+// function on this memory) at a time.
+//
+bool ram_readers_enable(struct RAM* memory);
+
+//
+// ram_threads_enable
+//
+// Call before memories, or strings read from them, are used by
+// more than one thread; ram_pool_create and ram_readers_enable
+// call it. Until then the intern pool and the registry of shared
+// strings take no locks. There is no going back.
+//
+void ram_threads_enable(void);
+
+//
+// ram_readers_disable
+//
+// Undoes ram_readers_enable, freeing everything readers held up.
+// Call it from the writing thread once every reader has stopped.
+//
+void ram_readers_disable(struct RAM* memory);
+
+//
+// ram_read_concurrent
+//
+// Safe to call from any thread while the writing thread keeps
+// going, once ram_readers_enable has been called: copies the value
+// at the given address into *value, as it was at one moment (never
+// a mix of two writes). A string is copied into the given buffer,
+// truncated to size-1 chars, and value->types.s points to the
+// buffer. Never blocks the writer; retries while a write to the
+// same cell is in progress. Returns true if successful, false if
+// the address is invalid.
+//
+bool ram_read_concurrent(struct RAM* memory, int address, struct RAM_VALUE* value, char* buffer, int size);
+
+//
+// ram_get_addr_concurrent
+//
+// Like ram_get_addr, but safe to call from any thread while the
+// writing thread keeps going, once ram_readers_enable has been
+// called. Takes time proportional to the # of values (the index
+// cannot be used without interning the name, which only the
+// writing thread may do), so look an address up once and then
+// read by address. Returns -1 if there is no such variable.
+//
+int ram_get_addr_concurrent(struct RAM* memory, char* name);
+
+//
+// ram_epoch
+//
+// Returns the current epoch #. Memory starts in epoch 0.
+//
+int ram_epoch(struct RAM* memory);
+
+//
+// ram_next_epoch
+//
+// Ends the current epoch and starts the next one, whose # is
+// returned. Clears the dirty bit of every cell written in the
+// epoch that ended, in time proportional to those cells only
+// (amortized: the write log is compacted once it reaches twice the
+// capacity).
+//
+int ram_next_epoch(struct RAM* memory);
+
+//
+// ram_is_dirty
+//
+// Returns true if the cell at the given address has been written
+// during the current epoch, false if not (or if the address is
+// not valid).
+//
+bool ram_is_dirty(struct RAM* memory, int address);
+
+//
+// ram_changed_since
+//
+// Stores into addresses the address of every cell written during
+// the given epoch or any later one, each address once, and returns
+// how many there are (at most num_values, so an array of that size
+// always suffices). Takes time proportional to the cells written
+// since then, not to the size of memory. Pass an epoch returned by
+// ram_epoch or ram_next_epoch.
+//
+int ram_changed_since(struct RAM* memory, int epoch, int* addresses);
+
+//
+// ram_writes_observed
+//
+// Returns true if something besides the writer sees each write as it
+// happens: a write hook, concurrent readers, an open transaction, a
+// snapshot, or per-cell statistics (-DRAM_STATS). An engine that
+// keeps variables in registers (see vm.h) must then write every
+// store through, and read every load from memory.
+//
+bool ram_writes_observed(struct RAM* memory);
+
 //
 // ram_print
 //
@@ -188,3 +795,26 @@ bool ram_write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* na
 //
 void ram_print(struct RAM* memory);
 
+//
+// ram_dump
+//
+// Writes the contents of memory to the given file, filtered, paged
+// and formatted as the options say (see ram_dump.h); ram_print is
+// ram_dump with the default options. Returns the # of values
+// dumped, or -1 if writing failed.
+//
+struct RAM_DUMP_OPTIONS;  // see ram_dump.h
+
+int ram_dump(struct RAM* memory, struct RAM_DUMP_OPTIONS* options, FILE* out);
+
+//
+// ram_print_stats
+//
+// Prints how often each variable was read, written and looked up
+// by name, and how many string bytes were copied for it, hottest
+// (most reads + writes + lookups) first. The counts are only kept
+// when ram.c is built with -DRAM_STATS; without it the counting
+// compiles to nothing and this prints a note saying so.
+//
+void ram_print_stats(struct RAM* memory);
+
@@ -0,0 +1,165 @@
+/*ram_dump.h*/
+
+//
+// Dumping the contents of memory: filtered by identifier (a glob
+// or a prefix) and by address range, paged, and written as text for
+// people, JSON lines or binary for programs. All output goes through
+// one large buffer, written out with a single fwrite when it fills.
+//
+// The engine only sees rows (address, identifier, value), so it
+// works on any memory: ram_dump walks a struct RAM, ram_print and
+// the debugger's sm command are built on it.
+//
+// JSON lines, one object per value:
+//
+//   {"address":0,"identifier":"x","type":"int","value":123}
+//
+//   a real that is not finite is the string "nan", "inf" or "-inf";
+//   a str that is NULL, and none, are null
+//
+// Binary (native byte order, like ram_image.h):
+//
+//   struct RAM_DUMP_HEADER
+//   per value: struct RAM_DUMP_ROW, then the identifier's chars,
+//              then for a str value an int32_t length (-1 if NULL)
+//              and its chars, none of them null-terminated
+//
+// Irene Ha
+// Northwestern University
+// CS 211
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>  // true, false
+#include <stdint.h>   // int32_t, int64_t
+
+#include "ram.h"
+
+
+//
+// How values are written:
+//
+//   RAM_DUMP_HUMAN:  the ram_print format
+//   RAM_DUMP_JSON:   one JSON object per line
+//   RAM_DUMP_BINARY: see above
+//
+enum RAM_DUMP_FORMATS
+{
+  RAM_DUMP_HUMAN = 0,
+  RAM_DUMP_JSON,
+  RAM_DUMP_BINARY
+};
+
+#define RAM_DUMP_BUFFER_SIZE (1024 * 1024)
+
+#define RAM_DUMP_MAGIC   0x444D4152u  // "RAMD" on little-endian machines
+#define RAM_DUMP_VERSION 1
+
+struct RAM_DUMP_HEADER
+{
+  uint32_t magic;       // RAM_DUMP_MAGIC
+  uint32_t version;     // RAM_DUMP_VERSION
+  int32_t  num_values;  // in the memory, not # of rows dumped
+  int32_t  unused;
+};
+
+struct RAM_DUMP_ROW
+{
+  int32_t address;
+  int32_t value_type;         // enum RAM_VALUE_TYPES
+  int32_t identifier_length;  // -1 if NULL
+  int32_t unused;
+  union
+  {
+    int64_t i;                // INT, PTR, BOOLEAN
+    double  d;                // REAL
+  } payload;                  // STR and NONE: 0
+};
+
+//
+// Which values are dumped, and how. Start from ram_dump_options_init.
+//
+struct RAM_DUMP_OPTIONS
+{
+  int   format;   // enum RAM_DUMP_FORMATS
+  char* pattern;  // glob on identifiers (*, ?, [a-z], [!0-9]), NULL => any
+  char* prefix;   // identifiers must start with this, NULL => any
+  int   first;    // lowest address dumped
+  int   last;     // highest address dumped, -1 => no limit
+  int   offset;   // # of matching values skipped before the first dumped
+  int   limit;    // most values dumped, -1 => no limit
+};
+
+//
+// A dump in progress, see ram_dump_begin
+//
+struct RAM_DUMP
+{
+  struct RAM_DUMP_OPTIONS options;
+  FILE*  out;
+  char*  buffer;   // RAM_DUMP_BUFFER_SIZE bytes, NULL => unbuffered
+  size_t length;   // # of bytes in buffer
+  bool   failed;   // a write failed
+  int    matched;  // # of values that passed the filters so far
+  int    dumped;   // # of values written so far
+};
+
+
+//
+// ram_dump_options_init
+//
+// Sets the options to dump every value in the human format.
+//
+void ram_dump_options_init(struct RAM_DUMP_OPTIONS* options);
+
+//
+// ram_dump_option
+//
+// Sets one option from text of the form name=value, as typed on a
+// command line:
+//
+//   format=human|json|binary   match=GLOB   prefix=PREFIX
+//   range=FIRST..LAST          offset=N     limit=N
+//
+// LAST may be left out (range=10..). Returns false if the text is
+// not a valid option, leaving the options unchanged. The options
+// point into the text, which must outlive them.
+//
+bool ram_dump_option(struct RAM_DUMP_OPTIONS* options, char* text);
+
+//
+// ram_dump_begin
+//
+// Starts a dump to the given file with the given options, which are
+// copied. Every dump begun must be ended with ram_dump_end.
+//
+void ram_dump_begin(struct RAM_DUMP* dump, struct RAM_DUMP_OPTIONS* options, FILE* out);
+
+//
+// ram_dump_header
+//
+// Writes the header of the dump, if its format has one: the human
+// format writes "**<title> PRINT**", then the capacity (unless it is
+// negative) and the # of values.
+//
+void ram_dump_header(struct RAM_DUMP* dump, const char* title, int capacity, int num_values);
+
+//
+// ram_dump_row
+//
+// Dumps the value at the given address if it passes the filters.
+// Rows must come in order of address. Returns false once no later
+// row can be dumped (past the range, or the limit reached), so the
+// caller can stop early.
+//
+bool ram_dump_row(struct RAM_DUMP* dump, int address, char* identifier, const struct RAM_VALUE* value);
+
+//
+// ram_dump_end
+//
+// Writes the footer of the dump, if its format has one, and flushes
+// it. Returns the # of values dumped, or -1 if writing failed.
+//
+int ram_dump_end(struct RAM_DUMP* dump);
@@ -0,0 +1,408 @@
+/*resolve.c*/
+
+//
+// implementation of the pre-execution pass over the program graph.
+// The graph is not a tree: a while loop's body links back to the
+// loop statement, and the paths of an if-then-else join again, so
+// the walk remembers which statements it has already visited.
+//
+// Irene Ha
+// Northwestern University
+// CS 211
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <stdint.h>   // uintptr_t
+#include <string.h>
+
+#include "programgraph.h"
+#include "intern.h"
+#include "resolve.h"
+
+
+//
+// set of visited statements, open addressing over STMT pointers
+//
+struct VISITED
+{
+  struct STMT** slots;  // NULL => empty slot
+  int capacity;         // power of 2, kept at most half full
+  int count;
+};
+
+
+/* visited_probe
+finds the slot holding stmt, or the empty slot where it would go
+
+parameters: struct VISITED*, struct STMT*
+returns: int   // slot #
+*/
+static int visited_probe(struct VISITED* visited, struct STMT* stmt) {
+  int mask = visited->capacity - 1;
+  uintptr_t p = (uintptr_t)stmt;
+  int slot = (int)((unsigned int)((p >> 3) * 2654435761u) & (unsigned int)mask);
+
+  while (visited->slots[slot] != NULL && visited->slots[slot] != stmt) {
+    slot = (slot + 1) & mask;
+  }
+
+  return slot;
+}
+
+
+/* visited_add
+adds stmt to the set
+
+parameters: struct VISITED*, struct STMT*
+returns: bool   // true if stmt was added, false if it was already in the set
+*/
+static bool visited_add(struct VISITED* visited, struct STMT* stmt) {
+  if (visited->slots[visited_probe(visited, stmt)] == stmt) {
+    return false;
+  }
+
+  if (2 * (visited->count + 1) > visited->capacity) { // grow and re-insert
+    struct STMT** old = visited->slots;
+    int old_capacity = visited->capacity;
+
+    visited->capacity *= 2;
+    visited->slots = (struct STMT**)calloc(visited->capacity, sizeof(struct STMT*));
+    if (visited->slots == NULL) {
+      //printf("ERROR: OUT OF MEMORY\n");
+      exit(1);
+    }
+
+    for (int i = 0; i < old_capacity; i++) {
+      if (old[i] != NULL) {
+        visited->slots[visited_probe(visited, old[i])] = old[i];
+      }
+    }
+    free(old);
+  }
+
+  visited->slots[visited_probe(visited, stmt)] = stmt;
+  visited->count++;
+  return true;
+}
+
+
+//
+// map from interned identifier to slot #, open addressing over the
+// identifier pointers. Slots are numbered 0, 1, 2, ... in the order
+// the walk first meets each variable.
+//
+struct SLOTS
+{
+  char** names;    // interned identifiers, NULL => empty
+  int*   numbers;  // numbers[i] is the slot # of names[i]
+  int capacity;    // power of 2, kept at most half full
+  int count;       // # of slots handed out so far
+};
+
+
+/* slots_probe
+finds the entry holding identifier, or the empty entry where it would go
+
+parameters: struct SLOTS*, char*   // slots and interned identifier
+returns: int   // entry #
+*/
+static int slots_probe(struct SLOTS* slots, char* identifier) {
+  int mask = slots->capacity - 1;
+  uintptr_t p = (uintptr_t)identifier;
+  int i = (int)((unsigned int)((p >> 3) * 2654435761u) & (unsigned int)mask);
+
+  while (slots->names[i] != NULL && slots->names[i] != identifier) {
+    i = (i + 1) & mask;
+  }
+
+  return i;
+}
+
+
+/* slot_of
+returns the slot # of the given variable, handing out the next
+slot the first time the variable is seen
+
+parameters: struct SLOTS*, char*   // slots and interned identifier
+returns: int
+*/
+static int slot_of(struct SLOTS* slots, char* identifier) {
+  int i = slots_probe(slots, identifier);
+  if (slots->names[i] == identifier) {
+    return slots->numbers[i];
+  }
+
+  if (2 * (slots->count + 1) > slots->capacity) { // grow and re-insert
+    char** old_names = slots->names;
+    int* old_numbers = slots->numbers;
+    int old_capacity = slots->capacity;
+
+    slots->capacity *= 2;
+    slots->names = (char**)calloc(slots->capacity, sizeof(char*));
+    slots->numbers = (int*)malloc(slots->capacity * sizeof(int));
+    if (slots->names == NULL || slots->numbers == NULL) {
+      //printf("ERROR: OUT OF MEMORY\n");
+      exit(1);
+    }
+
+    for (int k = 0; k < old_capacity; k++) {
+      if (old_names[k] != NULL) {
+        int j = slots_probe(slots, old_names[k]);
+        slots->names[j] = old_names[k];
+        slots->numbers[j] = old_numbers[k];
+      }
+    }
+    free(old_names);
+    free(old_numbers);
+
+    i = slots_probe(slots, identifier);
+  }
+
+  slots->names[i] = identifier;
+  slots->numbers[i] = slots->count;
+  slots->count++;
+  return slots->numbers[i];
+}
+
+
+/* widen
+re-allocates a node built by programgraph_build to its full size so
+the resolved fields at the end of the struct can be filled in
+
+parameters: void*, size_t   // node and its full size
+returns: void*              // the node, possibly moved
+*/
+static void* widen(void* node, size_t size) {
+  void* wide = realloc(node, size);
+  if (wide == NULL) {
+    //printf("ERROR: OUT OF MEMORY\n");
+    exit(1);
+  }
+  return wide;
+}
+
+
+/* resolve_constant
+decodes a literal element once, so executing it is a load: ints and
+reals are parsed the way the executor always has (atoi, atof), a
+string is borrowed from the element itself, no copy is made
+
+parameters: struct ELEMENT*
+returns: struct RAM_VALUE   // RAM_TYPE_NONE if the element is not a constant
+*/
+static struct RAM_VALUE resolve_constant(struct ELEMENT* element) {
+  struct RAM_VALUE constant;
+  constant.value_type = RAM_TYPE_NONE;
+  constant.types.i = 0;
+
+  if (element->element_type == ELEMENT_INT_LITERAL) {
+    constant.value_type = RAM_TYPE_INT;
+    constant.types.i = atoi(element->element_value);
+  } else if (element->element_type == ELEMENT_REAL_LITERAL) {
+    constant.value_type = RAM_TYPE_REAL;
+    constant.types.d = atof(element->element_value);
+  } else if (element->element_type == ELEMENT_STR_LITERAL) {
+    constant.value_type = RAM_TYPE_STR;
+    constant.types.s = element->element_value;
+  } else if (element->element_type == ELEMENT_TRUE || element->element_type == ELEMENT_FALSE) {
+    constant.value_type = RAM_TYPE_BOOLEAN;
+    constant.types.i = (element->element_type == ELEMENT_TRUE);
+  }
+
+  return constant;
+}
+
+
+/* resolve_element
+widens an element and fills in its resolved fields
+
+parameters: struct ELEMENT*, struct SLOTS*
+returns: struct ELEMENT*   // the element, possibly moved
+*/
+static struct ELEMENT* resolve_element(struct ELEMENT* element, struct SLOTS* slots) {
+  if (element == NULL) {
+    return NULL;
+  }
+
+  element = (struct ELEMENT*)widen(element, sizeof(struct ELEMENT));
+
+  if (element->element_type == ELEMENT_IDENTIFIER) {
+    element->identifier = intern(element->element_value);
+    element->slot = slot_of(slots, element->identifier);
+  } else {
+    element->identifier = NULL;
+    element->slot = -1;
+  }
+  element->constant = resolve_constant(element);
+
+  return element;
+}
+
+
+/* resolve_builtin
+maps the name of a called function to the builtin it calls. A call
+the executor could not run --- an unknown name, or a builtin where it
+is not supported (print as a value, input, int or float as a
+statement) --- is reported here, before the program runs
+
+parameters: char*, bool, int, int*   // function name, called for its value?,
+                                     // line, # of errors reported so far
+returns: int                         // enum BUILTINS, BUILTIN_UNKNOWN if reported
+*/
+static int resolve_builtin(char* name, bool assigned, int line, int* errors) {
+  int builtin = BUILTIN_UNKNOWN;
+
+  if (strcmp(name, "print") == 0) {
+    builtin = BUILTIN_PRINT;
+  } else if (strcmp(name, "input") == 0) {
+    builtin = BUILTIN_INPUT;
+  } else if (strcmp(name, "int") == 0) {
+    builtin = BUILTIN_INT;
+  } else if (strcmp(name, "float") == 0) {
+    builtin = BUILTIN_FLOAT;
+  }
+
+  if (builtin == BUILTIN_UNKNOWN || (builtin == BUILTIN_PRINT) == assigned) {
+    printf("**SEMANTIC ERROR: unsupported function '%s' (line %d)\n", name, line);
+    (*errors)++;
+    return BUILTIN_UNKNOWN;
+  }
+
+  return builtin;
+}
+
+
+/* resolve_expr
+widens an expression and resolves both of its sides
+
+parameters: struct EXPR*, struct SLOTS*
+returns: struct EXPR*   // the expression, possibly moved
+*/
+static struct EXPR* resolve_expr(struct EXPR* expr, struct SLOTS* slots) {
+  if (expr == NULL) {
+    return NULL;
+  }
+
+  expr = (struct EXPR*)widen(expr, sizeof(struct EXPR));
+  expr->handler = NULL;  // picked by execute_bind
+  expr->cache_lhs_type = RAM_TYPE_NONE;
+  expr->cache_rhs_type = RAM_TYPE_NONE;
+  expr->cache_operation = NULL;
+  expr->cache_hits = 0;
+  expr->cache_misses = 0;
+
+  if (expr->lhs != NULL) {
+    expr->lhs->element = resolve_element(expr->lhs->element, slots);
+  }
+
+  if (expr->isBinaryExpr && expr->rhs != NULL) {
+    expr->rhs->element = resolve_element(expr->rhs->element, slots);
+  }
+
+  return expr;
+}
+
+
+/* resolve_stmts
+resolves stmt and every statement reachable from it that has not
+been visited yet
+
+parameters: struct STMT*, struct VISITED*, struct SLOTS*, int*
+            // first statement, visited set, slots, # of errors reported
+returns: nothing
+*/
+static void resolve_stmts(struct STMT* stmt, struct VISITED* visited, struct SLOTS* slots, int* errors) {
+  while (stmt != NULL && visited_add(visited, stmt)) {
+
+    if (stmt->stmt_type == STMT_ASSIGNMENT) {
+      stmt->types.assignment = (struct STMT_ASSIGNMENT*)widen(stmt->types.assignment, sizeof(struct STMT_ASSIGNMENT));
+
+      struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+      assignment->var_identifier = intern(assignment->var_name);
+      assignment->var_slot = slot_of(slots, assignment->var_identifier);
+      assignment->handler = NULL;  // picked by execute_bind
+
+      if (assignment->rhs->value_type == VALUE_FUNCTION_CALL) {
+        assignment->rhs->types.function_call = (struct FUNCTION_CALL*)widen(assignment->rhs->types.function_call, sizeof(struct FUNCTION_CALL));
+
+        struct FUNCTION_CALL* call = assignment->rhs->types.function_call;
+        call->parameter = resolve_element(call->parameter, slots);
+        call->builtin = resolve_builtin(call->function_name, true, stmt->line, errors);
+      } else {
+        assignment->rhs->types.expr = resolve_expr(assignment->rhs->types.expr, slots);
+      }
+
+      stmt = assignment->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+      stmt->types.function_call = (struct STMT_FUNCTION_CALL*)widen(stmt->types.function_call, sizeof(struct STMT_FUNCTION_CALL));
+
+      struct STMT_FUNCTION_CALL* call = stmt->types.function_call;
+      call->parameter = resolve_element(call->parameter, slots);
+      call->builtin = resolve_builtin(call->function_name, false, stmt->line, errors);
+
+      stmt = call->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      struct STMT_WHILE_LOOP* loop = stmt->types.while_loop;
+      loop->condition = resolve_expr(loop->condition, slots);
+      resolve_stmts(loop->loop_body, visited, slots, errors); // body links back to stmt, which is visited
+
+      stmt = loop->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_IF_THEN_ELSE) {
+      // the executor does not run if-then-else, only walk its paths
+      resolve_stmts(stmt->types.if_then_else->true_path, visited, slots, errors);
+
+      stmt = stmt->types.if_then_else->false_path;
+    }
+    else { // STMT_PASS
+      stmt = stmt->types.pass->next_stmt;
+    }
+  }
+}
+
+
+//
+// Public functions:
+//
+
+//
+// resolve_program
+//
+// Walks every statement of the program graph once and fills in
+// the resolved fields. Returns the # of slots handed out, or -1
+// if a call was reported as unsupported.
+//
+int resolve_program(struct STMT* program)
+{
+  struct VISITED visited;
+  visited.capacity = 64;
+  visited.count = 0;
+  visited.slots = (struct STMT**)calloc(visited.capacity, sizeof(struct STMT*));
+  if (visited.slots == NULL) {
+    //printf("ERROR: OUT OF MEMORY\n");
+    exit(1);
+  }
+
+  struct SLOTS slots;
+  slots.capacity = 64;
+  slots.count = 0;
+  slots.names = (char**)calloc(slots.capacity, sizeof(char*));
+  slots.numbers = (int*)malloc(slots.capacity * sizeof(int));
+  if (slots.names == NULL || slots.numbers == NULL) {
+    //printf("ERROR: OUT OF MEMORY\n");
+    exit(1);
+  }
+
+  int errors = 0;
+  resolve_stmts(program, &visited, &slots, &errors);
+
+  free(visited.slots);
+  free(slots.names);
+  free(slots.numbers);
+
+  return (errors > 0) ? -1 : slots.count;
+}
@@ -0,0 +1,53 @@
+/*resolve.h*/
+
+//
+// Pre-execution pass over a nuPython program graph. Run once,
+// right after programgraph_build and before execute, it fills in
+// the fields of the graph that programgraph_build leaves unset
+// (e.g. the interned identifiers in ELEMENT and STMT_ASSIGNMENT).
+//
+// Irene Ha
+// Northwestern University
+// CS 211
+//
+
+#pragma once
+
+#include "programgraph.h"
+
+
+//
+// resolve_program
+//
+// Walks every statement of the program graph once and fills in
+// the resolved fields:
+//   - every identifier is interned (see intern.h), so executing
+//     the program never has to copy or compare names by characters
+//   - every variable gets a fixed slot # (0, 1, 2, ...), stored in
+//     each ELEMENT and STMT_ASSIGNMENT that names it, so executing
+//     the program never has to look a variable up by name. Slots
+//     are not memory addresses: addresses are still handed out by
+//     RAM in the order variables are first written at runtime.
+//   - every literal (and True, False) is decoded into the typed
+//     value stored in its ELEMENT, so executing the program never
+//     parses a number or copies a string literal.
+//   - every function call is mapped to the builtin it calls (enum
+//     BUILTINS), so executing a call never compares names. A call
+//     the executor cannot run (an unknown function, print used as
+//     a value, or input, int or float used as a statement) is
+//     reported with a semantic error, all of them before the
+//     program runs.
+//
+// Returns the # of slots handed out, or -1 if an unsupported call
+// was reported; the program must not be executed then.
+//
+// NOTE: programgraph_build allocates nodes without room for the
+// resolved fields, so nodes that carry them are re-allocated to
+// their full size and the parent's pointer is updated. Any pointer
+// into the graph taken before this call (other than to a STMT)
+// is no longer valid afterwards. The graph is still destroyed the
+// normal way via programgraph_destroy.
+//
+// NOTE: execute requires the program to have been resolved.
+//
+int resolve_program(struct STMT* program);
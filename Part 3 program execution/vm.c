@@ -0,0 +1,1024 @@
+/*vm.c*/
+
+//
+// The bytecode engine for nuPython, see vm.h. vm_compile walks the
+// program graph once, the same way execute does, and emits for each
+// statement the loads, operations and stores execute would perform;
+// vm_execute is one loop over the instructions.
+//
+// Irene Ha
+// Northwestern University
+// CS 211
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+
+#include "programgraph.h"
+#include "ram.h"
+#include "execute.h"
+#include "vm.h"
+
+
+//
+// fail target of a statement at the top level, patched to the
+// VM_HALT at the end once the program is compiled
+//
+#define VM_TO_HALT -1
+
+
+/* vm_emit
+appends an instruction to the bytecode
+
+parameters: struct VM_PROGRAM*, int (enum VM_OPS), int, int, int, int, int, void*   // op, a, b, c, fail, line, node
+returns: int   // index of the instruction
+*/
+static int vm_emit(struct VM_PROGRAM* vm, int op, int a, int b, int c, int fail, int line, void* node)
+{
+  if (vm->length == vm->capacity) {
+    int n = (vm->capacity == 0) ? 64 : 2 * vm->capacity;
+
+    struct VM_INSTR* grown = (struct VM_INSTR*)realloc(vm->code, n * sizeof(struct VM_INSTR));
+    if (grown == NULL) {
+      //printf("ERROR: OUT OF MEMORY\n");
+      exit(1);
+    }
+    vm->code = grown;
+    vm->capacity = n;
+  }
+
+  struct VM_INSTR* instr = &vm->code[vm->length];
+  instr->op = op;
+  instr->a = a;
+  instr->b = b;
+  instr->c = c;
+  instr->fail = fail;
+  instr->line = line;
+  instr->node = node;
+
+  return vm->length++;
+}
+
+
+/* vm_constant
+adds a decoded literal to the constants of the bytecode
+
+parameters: struct VM_PROGRAM*, struct RAM_VALUE
+returns: int   // register of the constant
+*/
+static int vm_constant(struct VM_PROGRAM* vm, struct RAM_VALUE value)
+{
+  if (vm->num_constants == vm->constants_capacity) {
+    int n = (vm->constants_capacity == 0) ? 16 : 2 * vm->constants_capacity;
+
+    struct RAM_VALUE* grown = (struct RAM_VALUE*)realloc(vm->constants, n * sizeof(struct RAM_VALUE));
+    if (grown == NULL) {
+      //printf("ERROR: OUT OF MEMORY\n");
+      exit(1);
+    }
+    vm->constants = grown;
+    vm->constants_capacity = n;
+  }
+
+  vm->constants[vm->num_constants] = value;
+  return VM_NUM_TEMPORARIES + vm->num_slots + vm->num_constants++;
+}
+
+
+/* vm_variable
+the register of the variable in the given slot, remembering its
+identifier to find the variable in memory and for error messages
+
+parameters: struct VM_PROGRAM*, int, char*   // slot # and interned identifier
+returns: int
+*/
+static int vm_variable(struct VM_PROGRAM* vm, int slot, char* identifier)
+{
+  vm->names[slot] = identifier;
+  return VM_NUM_TEMPORARIES + slot;
+}
+
+
+/* vm_next_stmt
+the statement that follows the given one, as execute steps through
+them; an if-then-else never completes, so nothing follows it
+
+parameters: struct STMT*
+returns: struct STMT*
+*/
+static struct STMT* vm_next_stmt(struct STMT* stmt)
+{
+  switch (stmt->stmt_type) {
+    case STMT_ASSIGNMENT:
+      return stmt->types.assignment->next_stmt;
+    case STMT_FUNCTION_CALL:
+      return stmt->types.function_call->next_stmt;
+    case STMT_PASS:
+      return stmt->types.pass->next_stmt;
+    case STMT_WHILE_LOOP:
+      return stmt->types.while_loop->next_stmt;
+    default:
+      return NULL;
+  }
+}
+
+
+/* vm_arithmetic_op
+the instruction for a binary operator; the operators without one of
+their own go through VM_BINARY
+
+parameters: int (enum OPERATORS)
+returns: int (enum VM_OPS)
+*/
+static int vm_arithmetic_op(int operator)
+{
+  switch (operator) {
+    case OPERATOR_PLUS:      return VM_ADD;
+    case OPERATOR_MINUS:     return VM_SUB;
+    case OPERATOR_ASTERISK:  return VM_MUL;
+    case OPERATOR_DIV:       return VM_DIV;
+    case OPERATOR_MOD:       return VM_MOD;
+    case OPERATOR_EQUAL:     return VM_EQ;
+    case OPERATOR_NOT_EQUAL: return VM_NE;
+    case OPERATOR_LT:        return VM_LT;
+    case OPERATOR_LTE:       return VM_LE;
+    case OPERATOR_GT:        return VM_GT;
+    case OPERATOR_GTE:       return VM_GE;
+    default:                 return VM_BINARY;
+  }
+}
+
+
+/* vm_compare_jump_op
+the fused compare-and-jump for a relational operator, or VM_HALT if
+the operator is not one
+
+parameters: int (enum OPERATORS)
+returns: int (enum VM_OPS)
+*/
+static int vm_compare_jump_op(int operator)
+{
+  switch (operator) {
+    case OPERATOR_EQUAL:     return VM_JUMP_UNLESS_EQ;
+    case OPERATOR_NOT_EQUAL: return VM_JUMP_UNLESS_NE;
+    case OPERATOR_LT:        return VM_JUMP_UNLESS_LT;
+    case OPERATOR_LTE:       return VM_JUMP_UNLESS_LE;
+    case OPERATOR_GT:        return VM_JUMP_UNLESS_GT;
+    case OPERATOR_GTE:       return VM_JUMP_UNLESS_GE;
+    default:                 return VM_HALT;
+  }
+}
+
+
+/* vm_is_register
+true if the unary expression is a variable or a literal, which
+already have a register: nothing is emitted to read them
+
+parameters: struct UNARY_EXPR*
+returns: bool
+*/
+static bool vm_is_register(struct UNARY_EXPR* unary_expr)
+{
+  struct ELEMENT* element = unary_expr->element;
+
+  return unary_expr->expr_type == UNARY_ELEMENT &&
+    (element->element_type == ELEMENT_IDENTIFIER || element->constant.value_type != RAM_TYPE_NONE);
+}
+
+
+/* vm_compile_operand
+emits what retrieve_value does for a unary expression, if anything
+
+parameters: struct VM_PROGRAM*, struct UNARY_EXPR*, int, int, int   // temporary to use, fail target, line
+returns: int   // register holding the value
+*/
+static int vm_compile_operand(struct VM_PROGRAM* vm, struct UNARY_EXPR* unary_expr, int temp, int fail, int line)
+{
+  struct ELEMENT* element = unary_expr->element;
+
+  switch (unary_expr->expr_type) {
+    case UNARY_ADDRESS_OF:
+      vm_variable(vm, element->slot, element->identifier);
+      vm_emit(vm, VM_ADDRESS_OF, temp, element->slot, 0, fail, line, element->element_value);
+      return temp;
+
+    case UNARY_PTR_DEREF:
+      vm_variable(vm, element->slot, element->identifier);
+      vm_emit(vm, VM_DEREF, temp, element->slot, 0, fail, line, element->element_value);
+      return temp;
+
+    case UNARY_ELEMENT:
+      // literals were decoded by resolve_program
+      if (element->element_type != ELEMENT_IDENTIFIER && element->constant.value_type != RAM_TYPE_NONE) {
+        return vm_constant(vm, element->constant);
+      } else if (element->element_type == ELEMENT_IDENTIFIER) {
+        return vm_variable(vm, element->slot, element->identifier);
+      }
+      vm_emit(vm, VM_FAIL, VM_FAILURE_ELEMENT, 0, 0, fail, line, NULL);
+      return temp;
+
+    default: // unary + and -, retrieve_value fails without a message
+      vm_emit(vm, VM_FAIL, VM_FAILURE_SILENT, 0, 0, fail, line, NULL);
+      return temp;
+  }
+}
+
+
+/* vm_compile_operands
+emits the operands of a binary expression, lhs first. A variable is
+read when an instruction uses it, so if the rhs needs an instruction
+of its own, the lhs is read before it: an undefined variable on the
+left is reported first, as in execute_binary_expression.
+
+parameters: struct VM_PROGRAM*, struct EXPR*, int*, int*, int, int   // lhs and rhs registers (returned), fail target, line
+returns: nothing
+*/
+static void vm_compile_operands(struct VM_PROGRAM* vm, struct EXPR* expr, int* lhs, int* rhs, int fail, int line)
+{
+  *lhs = vm_compile_operand(vm, expr->lhs, R_LHS, fail, line);
+
+  if (*lhs >= VM_NUM_TEMPORARIES && *lhs < VM_NUM_TEMPORARIES + vm->num_slots && !vm_is_register(expr->rhs)) {
+    vm_emit(vm, VM_LOAD_VAR, R_LHS, *lhs, 0, fail, line, NULL);
+    *lhs = R_LHS;
+  }
+
+  *rhs = vm_compile_operand(vm, expr->rhs, R_RHS, fail, line);
+}
+
+
+/* vm_compile_expr
+emits the evaluation of an expression, see evaluate_expression
+
+parameters: struct VM_PROGRAM*, struct EXPR*, int, int, int   // temporary for the result, fail target, line
+returns: int   // register holding the value
+*/
+static int vm_compile_expr(struct VM_PROGRAM* vm, struct EXPR* expr, int result, int fail, int line)
+{
+  if (!expr->isBinaryExpr) {
+    return vm_compile_operand(vm, expr->lhs, result, fail, line);
+  }
+
+  if (expr->lhs == NULL || expr->rhs == NULL) {
+    vm_emit(vm, VM_FAIL, VM_FAILURE_SILENT, 0, 0, fail, line, NULL);
+    return result;
+  }
+
+  int lhs, rhs;
+  vm_compile_operands(vm, expr, &lhs, &rhs, fail, line);
+  vm_emit(vm, vm_arithmetic_op(expr->operator), result, lhs, rhs, fail, line, expr);
+  return result;
+}
+
+
+/* vm_compile_condition
+emits the test of a loop condition, a fused compare-and-jump when it
+compares two operands
+
+parameters: struct VM_PROGRAM*, struct EXPR*, int, int   // fail target, line
+returns: int   // index of the jump taken when the condition is false, its target is patched later
+*/
+static int vm_compile_condition(struct VM_PROGRAM* vm, struct EXPR* condition, int fail, int line)
+{
+  if (condition->isBinaryExpr && condition->lhs != NULL && condition->rhs != NULL &&
+      vm_compare_jump_op(condition->operator) != VM_HALT) {
+    int lhs, rhs;
+    vm_compile_operands(vm, condition, &lhs, &rhs, fail, line);
+    return vm_emit(vm, vm_compare_jump_op(condition->operator), lhs, rhs, 0, fail, line, condition);
+  }
+
+  int value = vm_compile_expr(vm, condition, R_RESULT, fail, line);
+  return vm_emit(vm, VM_JUMP_IF_FALSE, value, 0, 0, fail, line, NULL);
+}
+
+
+static bool vm_compile_stmt(struct VM_PROGRAM* vm, struct STMT* stmt, int fail);
+
+
+/* vm_compile_while
+emits a while loop: the head is a safe point, then the condition;
+each statement of the body fails back to the head, as in
+execute_while_loop. When the condition is a single compare of two
+registers, the end of the body repeats it (safe point included), so
+an iteration takes one jump instead of two.
+
+parameters: struct VM_PROGRAM*, struct STMT*, int   // fail target of the condition
+returns: nothing
+*/
+static void vm_compile_while(struct VM_PROGRAM* vm, struct STMT* stmt, int fail)
+{
+  int head = vm_emit(vm, VM_COMPACT, 0, 0, 0, fail, stmt->line, NULL);
+  int exit_jump = vm_compile_condition(vm, stmt->types.while_loop->condition, fail, stmt->line);
+
+  // the body ends where it links back to the loop, see execute_while_stmt
+  struct STMT* body = stmt->types.while_loop->loop_body;
+  while (body != NULL && !(body->stmt_type == STMT_WHILE_LOOP && body->line == stmt->line)) {
+    if (!vm_compile_stmt(vm, body, head)) {
+      break;
+    }
+    body = vm_next_stmt(body);
+  }
+
+  struct VM_INSTR* test = &vm->code[exit_jump];
+  if (exit_jump == head + 1 && test->op >= VM_JUMP_UNLESS_LT && test->op <= VM_JUMP_UNLESS_NE) {
+    int op = VM_LOOP_LT + (test->op - VM_JUMP_UNLESS_LT);
+    vm_emit(vm, op, test->a, test->b, exit_jump + 1, fail, stmt->line, test->node);
+  } else {
+    vm_emit(vm, VM_LOOP, 0, 0, head + 1, fail, stmt->line, NULL);
+  }
+  vm->code[exit_jump].c = vm->length;
+}
+
+
+/* vm_compile_stmt
+emits one statement, see execute_statement
+
+parameters: struct VM_PROGRAM*, struct STMT*, int   // fail target
+returns: bool   // false if the statement never completes, so nothing after it is reached
+*/
+static bool vm_compile_stmt(struct VM_PROGRAM* vm, struct STMT* stmt, int fail)
+{
+  int line = stmt->line;
+
+  switch (stmt->stmt_type) {
+    case STMT_ASSIGNMENT: {
+      struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+      struct VALUE* rhs = assignment->rhs;
+      int slot = assignment->var_slot;
+
+      vm_variable(vm, slot, assignment->var_identifier);
+
+      if (rhs->value_type == VALUE_FUNCTION_CALL) {
+        // as in execute_assignment, the result goes to the variable
+        // itself even for *p = ...
+        vm_emit(vm, VM_CALL, R_RESULT, 0, 0, fail, line, rhs->types.function_call);
+        vm_emit(vm, VM_STORE, slot, R_RESULT, 0, fail, line, NULL);
+
+      } else if (assignment->isPtrDeref) {
+        // the pointer is checked before the rhs is evaluated
+        vm_emit(vm, VM_POINTER, R_POINTER, slot, 0, fail, line, NULL);
+        int value = vm_compile_expr(vm, rhs->types.expr, R_RESULT, fail, line);
+        vm_emit(vm, VM_STORE_AT, R_POINTER, value, slot, fail, line, NULL);
+
+      } else if (rhs->types.expr->isBinaryExpr && rhs->types.expr->lhs != NULL &&
+                 rhs->types.expr->lhs->expr_type != UNARY_ADDRESS_OF) {
+        // the operation stores its result to the variable itself
+        vm_compile_expr(vm, rhs->types.expr, VM_NUM_TEMPORARIES + slot, fail, line);
+
+      } else {
+        struct EXPR* expr = rhs->types.expr;
+        int value = vm_compile_expr(vm, expr, R_RESULT, fail, line);
+
+        // x = &y <op> z stores &y, see execute_assignment
+        if (expr->isBinaryExpr && expr->lhs->expr_type == UNARY_ADDRESS_OF) {
+          value = R_LHS;
+        }
+        vm_emit(vm, VM_STORE, slot, value, 0, fail, line, NULL);
+      }
+      return true;
+    }
+
+    case STMT_FUNCTION_CALL:
+      // resolve_program only lets print through as a statement
+      vm_emit(vm, VM_PRINT, 0, 0, 0, fail, line, stmt->types.function_call->parameter);
+      return true;
+
+    case STMT_PASS:
+      return true;
+
+    case STMT_WHILE_LOOP:
+      vm_compile_while(vm, stmt, fail);
+      return true;
+
+    default:
+      vm_emit(vm, VM_FAIL, VM_FAILURE_STMT, 0, 0, fail, line, NULL);
+      return false;
+  }
+}
+
+
+//
+// State of one run of vm_execute. Variables are cached write-back:
+// a store to a variable that already has an address, of a value its
+// register can cache, only sets the register and marks the slot
+// dirty; vm_flush writes the dirty ones to memory before anything
+// that reads memory (print, input/int/float, pointers, the memory
+// printed on an error) and at the end. The first write of a variable
+// is never deferred, so variables get their addresses in the same
+// order as under execute.
+//
+// None of this while memory's writes are observed (see
+// ram_writes_observed): hooks, readers, transactions, snapshots and
+// stats must see every write when it happens, and stats every read,
+// so then no register caches a variable and memory is always current.
+// Observers are checked when the run starts and again at every safe
+// point, see vm_observe.
+//
+struct VM_RUN
+{
+  struct VM_PROGRAM* vm;
+  struct RAM* memory;
+  bool  cache;           // false while memory's writes are observed
+  struct RAM_VALUE* r;   // the registers
+  int*  addrs;           // address of each slot, -1 until vm_address finds it
+  bool* dirty;           // per slot, register newer than memory
+  int*  dirty_slots;     // the slots marked dirty, in no order
+  int   num_dirty;
+};
+
+
+/* vm_cacheable
+true if the register of a variable can keep the value written: a
+str may be moved by memory, and a NaN may not read back bit for bit
+
+parameters: struct RAM_VALUE
+returns: bool
+*/
+static inline bool vm_cacheable(struct RAM_VALUE value)
+{
+  switch (value.value_type) {
+    case RAM_TYPE_INT:
+    case RAM_TYPE_BOOLEAN:
+    case RAM_TYPE_PTR:
+      return true;
+    case RAM_TYPE_REAL:
+      return value.types.d == value.types.d;
+    default:
+      return false;
+  }
+}
+
+
+/* vm_address
+the address of the variable in a slot, looked up the first time it
+is needed (so memory counts the lookup when execute would), -1 while
+the variable is not in memory
+
+parameters: struct VM_RUN*, int   // slot #
+returns: int
+*/
+static inline int vm_address(struct VM_RUN* run, int slot)
+{
+  if (run->addrs[slot] == -1) {
+    run->addrs[slot] = slot_address(run->memory, slot, run->vm->names[slot]);
+  }
+  return run->addrs[slot];
+}
+
+
+/* vm_flush
+writes the dirty variables back to memory; cannot fail, each one
+already has an address and a cacheable value
+
+parameters: struct VM_RUN*
+returns: nothing
+*/
+static void vm_flush(struct VM_RUN* run)
+{
+  for (int i = 0; i < run->num_dirty; i++) {
+    int slot = run->dirty_slots[i];
+
+    if (run->dirty[slot]) {  // else written through since it was marked
+      ram_write_cell_by_addr(run->memory, run->r[VM_NUM_TEMPORARIES + slot], run->addrs[slot]);
+      run->dirty[slot] = false;
+    }
+  }
+  run->num_dirty = 0;
+}
+
+
+/* vm_observe
+at a safe point, checks again whether memory's writes are observed
+(see ram_writes_observed): once they are, the dirty variables are
+written back and no register caches a variable until they no longer
+are
+
+parameters: struct VM_RUN*
+returns: nothing
+*/
+static inline void vm_observe(struct VM_RUN* run)
+{
+  bool cache = !ram_writes_observed(run->memory);
+
+  if (__builtin_expect(cache == run->cache, 1)) {
+    return;
+  }
+
+  if (!cache) {
+    vm_flush(run);
+    for (int slot = 0; slot < run->vm->num_slots; slot++) {
+      run->r[VM_NUM_TEMPORARIES + slot].value_type = RAM_TYPE_NONE;
+    }
+  }
+  run->cache = cache;
+}
+
+
+/* vm_undefined
+an undefined variable was read: like retrieve_value, reports it and
+ends the run, printing memory as it is
+
+parameters: struct VM_RUN*, int, int   // slot # and line
+returns: nothing, does not return
+*/
+static _Noreturn void vm_undefined(struct VM_RUN* run, int slot, int line)
+{
+  printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", run->vm->names[slot], line);
+  printf("**done\n");
+  vm_flush(run);
+  ram_print(run->memory);
+  exit(0);
+}
+
+
+/* vm_load
+the value in a register; if it is a variable that is not cached,
+the value is peeked from memory into temp (and cached, if it can be)
+
+parameters: struct VM_RUN*, int, struct RAM_VALUE*, int   // register #, temp, line
+returns: const struct RAM_VALUE*   // a str is borrowed from memory until the next write
+*/
+static inline const struct RAM_VALUE* vm_load(struct VM_RUN* run, int reg, struct RAM_VALUE* temp, int line)
+{
+  struct RAM_VALUE* r = run->r;
+
+  if (r[reg].value_type != RAM_TYPE_NONE || reg < VM_NUM_TEMPORARIES) {
+    return &r[reg];  // constants are never RAM_TYPE_NONE
+  }
+
+  // not cached, so not dirty either: memory is up to date
+  int slot = reg - VM_NUM_TEMPORARIES;
+  const struct RAM_VALUE* value = ram_peek_cell_by_addr(run->memory, vm_address(run, slot));
+
+  if (value == NULL) {
+    vm_undefined(run, slot, line);
+  }
+
+  *temp = *value;
+  if (run->cache && vm_cacheable(*value)) {
+    r[reg] = *value;
+  }
+  return temp;
+}
+
+
+/* vm_store
+stores a value to the variable in the given slot: only in its
+register if the write can be deferred (see struct VM_RUN), else
+written to memory now and cached in the register if it can be
+
+parameters: struct VM_RUN*, int, struct RAM_VALUE, int   // slot #, value, line
+returns: bool   // false if the write failed, error msg already output
+*/
+static inline bool vm_store(struct VM_RUN* run, int slot, struct RAM_VALUE value, int line)
+{
+  struct RAM_VALUE* reg = &run->r[VM_NUM_TEMPORARIES + slot];
+  bool cacheable = run->cache && vm_cacheable(value);
+  int address = vm_address(run, slot);
+
+  if (cacheable && address != -1) {
+    *reg = value;
+    if (!run->dirty[slot]) {
+      run->dirty[slot] = true;
+      run->dirty_slots[run->num_dirty++] = slot;
+    }
+    return true;
+  }
+
+  bool written;
+
+  if (address != -1) {
+    written = ram_write_cell_by_addr(run->memory, value, address);
+  } else {
+    // the first write goes by name, so the variable gets its address
+    // as in execute and print() can find it; vm_address looks the
+    // address up when it is next needed
+    written = ram_write_cell_by_name(run->memory, value, run->vm->names[slot]);
+  }
+
+  if (!written) {
+    printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", run->vm->names[slot], line);
+    return false;
+  }
+
+  run->dirty[slot] = false;  // memory has the latest value now
+  if (cacheable) {
+    *reg = value;
+  } else {
+    reg->value_type = RAM_TYPE_NONE;
+  }
+  return true;
+}
+
+
+/* vm_result
+puts the result of an operation in register a: a temporary, or a
+variable, which is then stored
+
+parameters: struct VM_RUN*, struct VM_INSTR*, struct RAM_VALUE
+returns: int   // the next instruction
+*/
+static inline int vm_result(struct VM_RUN* run, struct VM_INSTR* instr, struct RAM_VALUE result)
+{
+  int pc = (int)(instr - run->vm->code);
+
+  if (instr->a < VM_NUM_TEMPORARIES) {
+    run->r[instr->a] = result;
+    return pc + 1;
+  }
+  return vm_store(run, instr->a - VM_NUM_TEMPORARIES, result, instr->line) ? pc + 1 : instr->fail;
+}
+
+
+//
+// Public functions:
+//
+
+//
+// vm_compile
+//
+// Lowers the program graph into bytecode: every top-level statement
+// is followed by a safe point and fails to the VM_HALT at the end.
+//
+struct VM_PROGRAM* vm_compile(struct STMT* program, int num_slots)
+{
+  struct VM_PROGRAM* vm = (struct VM_PROGRAM*)malloc(sizeof(struct VM_PROGRAM));
+  char** names = (char**)calloc(num_slots + 1, sizeof(char*));  // + 1, calloc(0) may return NULL
+  if (vm == NULL || names == NULL) {
+    //printf("ERROR: OUT OF MEMORY\n");
+    exit(1);
+  }
+
+  vm->code = NULL;
+  vm->length = 0;
+  vm->capacity = 0;
+  vm->constants = NULL;
+  vm->num_constants = 0;
+  vm->constants_capacity = 0;
+  vm->names = names;
+  vm->num_slots = num_slots;
+
+  for (struct STMT* stmt = program; stmt != NULL; stmt = vm_next_stmt(stmt)) {
+    if (!vm_compile_stmt(vm, stmt, VM_TO_HALT)) {
+      break;
+    }
+    vm_emit(vm, VM_COMPACT, 0, 0, 0, VM_TO_HALT, stmt->line, NULL);
+  }
+
+  int halt = vm_emit(vm, VM_HALT, 0, 0, 0, VM_TO_HALT, 0, NULL);
+
+  for (int i = 0; i < vm->length; i++) {
+    if (vm->code[i].fail == VM_TO_HALT) {
+      vm->code[i].fail = halt;
+    }
+  }
+
+  return vm;
+}
+
+
+//
+// int with int, by far the common case, is done right in the loop;
+// any other types go through the inline cache of the EXPR in node,
+// see execute_cached_operation. x and y are the ints, guard must
+// hold for the int case (division by zero is left to the cache).
+// Built with -DRAM_STATS, everything goes through the cache, so its
+// hits and misses are counted as under the other engines.
+//
+#ifdef RAM_STATS
+#define VM_INLINE_INTS false
+#else
+#define VM_INLINE_INTS true
+#endif
+
+#define VM_ARITHMETIC(result_type, guard, int_expr) {                                        \
+    const struct RAM_VALUE* lhs = &r[instr->b];                                             \
+    const struct RAM_VALUE* rhs = &r[instr->c];                                             \
+    if (lhs->value_type != RAM_TYPE_INT || rhs->value_type != RAM_TYPE_INT) {               \
+      lhs = vm_load(&run, instr->b, &lhs_temp, instr->line);                                \
+      rhs = vm_load(&run, instr->c, &rhs_temp, instr->line);                                \
+    }                                                                                       \
+    int x = lhs->types.i;                                                                   \
+    int y = rhs->types.i;                                                                   \
+    struct RAM_VALUE result;                                                                \
+    if (VM_INLINE_INTS && lhs->value_type == RAM_TYPE_INT && rhs->value_type == RAM_TYPE_INT && (guard)) { \
+      result.value_type = result_type;                                                      \
+      result.types.i = int_expr;                                                            \
+      pc = vm_result(&run, instr, result);                                                  \
+    } else if (execute_cached_operation((struct EXPR*)instr->node, *lhs, *rhs, &result, instr->line)) { \
+      pc = vm_result(&run, instr, result);                                                  \
+    } else {                                                                                \
+      pc = instr->fail;                                                                     \
+    }                                                                                       \
+    break;                                                                                  \
+  }
+
+//
+// the same for a fused compare-and-jump: jumps to c if
+// register a <op> register b is jump_if (true or false)
+//
+#define VM_COMPARE_JUMP(int_expr, jump_if) {                                                 \
+    const struct RAM_VALUE* lhs = &r[instr->a];                                             \
+    const struct RAM_VALUE* rhs = &r[instr->b];                                             \
+    if (lhs->value_type != RAM_TYPE_INT || rhs->value_type != RAM_TYPE_INT) {               \
+      lhs = vm_load(&run, instr->a, &lhs_temp, instr->line);                                \
+      rhs = vm_load(&run, instr->b, &rhs_temp, instr->line);                                \
+    }                                                                                       \
+    int x = lhs->types.i;                                                                   \
+    int y = rhs->types.i;                                                                   \
+    if (VM_INLINE_INTS && lhs->value_type == RAM_TYPE_INT && rhs->value_type == RAM_TYPE_INT) { \
+      pc = ((int_expr) == jump_if) ? instr->c : pc + 1;                                     \
+    } else if (execute_cached_operation((struct EXPR*)instr->node, *lhs, *rhs, &r[R_RESULT], instr->line)) { \
+      pc = ((r[R_RESULT].types.i != 0) == jump_if) ? instr->c : pc + 1;                     \
+    } else {                                                                                \
+      pc = instr->fail;                                                                     \
+    }                                                                                       \
+    break;                                                                                  \
+  }
+
+
+//
+// vm_execute
+//
+// Runs the bytecode; each case does what the matching part of
+// execute.c does, with the same messages. The registers, the
+// address of each slot and the dirty variables belong to this run,
+// see struct VM_RUN.
+//
+void vm_execute(struct VM_PROGRAM* vm, struct RAM* memory)
+{
+  int num_registers = VM_NUM_TEMPORARIES + vm->num_slots + vm->num_constants;
+  struct RAM_VALUE* r = (struct RAM_VALUE*)malloc(num_registers * sizeof(struct RAM_VALUE));
+  int* addrs = (int*)malloc((vm->num_slots + 1) * sizeof(int));
+  bool* dirty = (bool*)malloc((vm->num_slots + 1) * sizeof(bool));
+  int* dirty_slots = (int*)malloc((vm->num_slots + 1) * sizeof(int));
+  if (r == NULL || addrs == NULL || dirty == NULL || dirty_slots == NULL) {
+    //printf("ERROR: OUT OF MEMORY\n");
+    exit(1);
+  }
+
+  for (int i = 0; i < VM_NUM_TEMPORARIES + vm->num_slots; i++) {
+    r[i].value_type = RAM_TYPE_NONE;
+    r[i].types.s = NULL;
+  }
+  for (int k = 0; k < vm->num_constants; k++) {
+    r[VM_NUM_TEMPORARIES + vm->num_slots + k] = vm->constants[k];
+  }
+  for (int slot = 0; slot < vm->num_slots; slot++) {
+    addrs[slot] = -1;  // looked up when first needed, see vm_address
+    dirty[slot] = false;
+  }
+
+  struct VM_RUN run = { vm, memory, !ram_writes_observed(memory), r, addrs, dirty, dirty_slots, 0 };
+
+  struct RAM_VALUE lhs_temp;
+  struct RAM_VALUE rhs_temp;
+  int pc = 0;
+
+  while (true) {
+    struct VM_INSTR* instr = &vm->code[pc];
+
+    switch (instr->op) {
+      case VM_HALT:
+        vm_flush(&run);
+        free(r);
+        free(addrs);
+        free(dirty);
+        free(dirty_slots);
+        return;
+
+      case VM_COMPACT:
+        ram_compact(memory, false);  // safe point, nothing peeked is held
+        vm_observe(&run);
+        pc++;
+        break;
+
+      case VM_LOOP:
+        ram_compact(memory, false);  // safe point, as at the head of the loop
+        vm_observe(&run);
+        pc = instr->c;
+        break;
+
+      case VM_JUMP_IF_FALSE:
+        pc = (vm_load(&run, instr->a, &lhs_temp, instr->line)->types.i == 0) ? instr->c : pc + 1;
+        break;
+
+      case VM_FAIL:
+        if (instr->a == VM_FAILURE_ELEMENT) {
+          printf("**SEMANTIC ERROR: invalid element types!!!!!!!!\n");
+        } else if (instr->a == VM_FAILURE_STMT) {
+          printf("**SEMANTIC ERROR: unsupported stmt type UH OH (line %d)\n", instr->line);
+        }
+        pc = instr->fail;
+        break;
+
+      case VM_LOAD_VAR:
+        r[instr->a] = *vm_load(&run, instr->b, &lhs_temp, instr->line);
+        pc++;
+        break;
+
+      case VM_ADDRESS_OF:
+        if (vm_address(&run, instr->b) == -1) {
+          printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", (char*)instr->node, instr->line);
+          pc = instr->fail;
+          break;
+        }
+
+        r[instr->a].value_type = RAM_TYPE_PTR;
+        r[instr->a].types.i = addrs[instr->b];
+        pc++;
+        break;
+
+      case VM_DEREF: {
+        vm_flush(&run);  // the pointer may point at any variable
+
+        const struct RAM_VALUE* pointer_value = ram_peek_cell_by_addr(memory, vm_address(&run, instr->b));
+
+        if (pointer_value == NULL) {
+          printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", (char*)instr->node, instr->line);
+          pc = instr->fail;
+          break;
+        }
+        if (pointer_value->value_type != RAM_TYPE_PTR) {
+          printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", instr->line);
+          pc = instr->fail;
+          break;
+        }
+
+        const struct RAM_VALUE* value = ram_peek_cell_by_addr(memory, pointer_value->types.i);
+        if (value == NULL) {
+          printf("**SEMANTIC ERROR: '%s' contains invalid address (line %d)\n", (char*)instr->node, instr->line);
+          pc = instr->fail;
+          break;
+        }
+
+        r[instr->a] = *value;  // a str stays borrowed from memory until the next write
+        pc++;
+        break;
+      }
+
+      case VM_ADD: VM_ARITHMETIC(RAM_TYPE_INT, true, x + y)
+      case VM_SUB: VM_ARITHMETIC(RAM_TYPE_INT, true, x - y)
+      case VM_MUL: VM_ARITHMETIC(RAM_TYPE_INT, true, x * y)
+      case VM_DIV: VM_ARITHMETIC(RAM_TYPE_INT, y != 0, x / y)
+      case VM_MOD: VM_ARITHMETIC(RAM_TYPE_INT, y != 0, x % y)
+      case VM_EQ:  VM_ARITHMETIC(RAM_TYPE_BOOLEAN, true, x == y)
+      case VM_NE:  VM_ARITHMETIC(RAM_TYPE_BOOLEAN, true, x != y)
+      case VM_LT:  VM_ARITHMETIC(RAM_TYPE_BOOLEAN, true, x < y)
+      case VM_LE:  VM_ARITHMETIC(RAM_TYPE_BOOLEAN, true, x <= y)
+      case VM_GT:  VM_ARITHMETIC(RAM_TYPE_BOOLEAN, true, x > y)
+      case VM_GE:  VM_ARITHMETIC(RAM_TYPE_BOOLEAN, true, x >= y)
+
+      case VM_BINARY: {
+        const struct RAM_VALUE* lhs = vm_load(&run, instr->b, &lhs_temp, instr->line);
+        const struct RAM_VALUE* rhs = vm_load(&run, instr->c, &rhs_temp, instr->line);
+
+        struct RAM_VALUE result;
+
+        pc = execute_cached_operation((struct EXPR*)instr->node, *lhs, *rhs, &result, instr->line) ? vm_result(&run, instr, result) : instr->fail;
+        break;
+      }
+
+      case VM_JUMP_UNLESS_LT: VM_COMPARE_JUMP(x < y, false)
+      case VM_JUMP_UNLESS_LE: VM_COMPARE_JUMP(x <= y, false)
+      case VM_JUMP_UNLESS_GT: VM_COMPARE_JUMP(x > y, false)
+      case VM_JUMP_UNLESS_GE: VM_COMPARE_JUMP(x >= y, false)
+      case VM_JUMP_UNLESS_EQ: VM_COMPARE_JUMP(x == y, false)
+      case VM_JUMP_UNLESS_NE: VM_COMPARE_JUMP(x != y, false)
+
+      case VM_LOOP_LT: ram_compact(memory, false); vm_observe(&run); VM_COMPARE_JUMP(x < y, true)
+      case VM_LOOP_LE: ram_compact(memory, false); vm_observe(&run); VM_COMPARE_JUMP(x <= y, true)
+      case VM_LOOP_GT: ram_compact(memory, false); vm_observe(&run); VM_COMPARE_JUMP(x > y, true)
+      case VM_LOOP_GE: ram_compact(memory, false); vm_observe(&run); VM_COMPARE_JUMP(x >= y, true)
+      case VM_LOOP_EQ: ram_compact(memory, false); vm_observe(&run); VM_COMPARE_JUMP(x == y, true)
+      case VM_LOOP_NE: ram_compact(memory, false); vm_observe(&run); VM_COMPARE_JUMP(x != y, true)
+
+      case VM_STORE: {
+        struct RAM_VALUE value = *vm_load(&run, instr->b, &rhs_temp, instr->line);
+
+        pc = vm_store(&run, instr->a, value, instr->line) ? pc + 1 : instr->fail;
+        break;
+      }
+
+      case VM_POINTER: {
+        vm_flush(&run);  // memory is written through the pointer next
+
+        const struct RAM_VALUE* pointer_value = ram_peek_cell_by_addr(memory, vm_address(&run, instr->b));
+
+        if (pointer_value == NULL) {
+          printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", vm->names[instr->b], instr->line);
+          pc = instr->fail;
+          break;
+        }
+        if (pointer_value->value_type != RAM_TYPE_PTR) {
+          printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", instr->line);
+          pc = instr->fail;
+          break;
+        }
+
+        r[instr->a] = *pointer_value;
+        pc++;
+        break;
+      }
+
+      case VM_STORE_AT: {
+        vm_flush(&run);  // else a dirty variable would overwrite the write later
+
+        int address = r[instr->a].types.i;
+        const struct RAM_VALUE* value = vm_load(&run, instr->b, &rhs_temp, instr->line);
+
+        if (!ram_write_cell_by_addr(memory, *value, address)) {
+          printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", vm->names[instr->c], instr->line);
+          pc = instr->fail;
+          break;
+        }
+
+        // the variable written through the pointer is no longer cached
+        for (int slot = 0; slot < vm->num_slots; slot++) {
+          if (addrs[slot] == address) {
+            r[VM_NUM_TEMPORARIES + slot].value_type = RAM_TYPE_NONE;
+          }
+        }
+        pc++;
+        break;
+      }
+
+      case VM_PRINT:
+        vm_flush(&run);
+        pc = handle_print((struct ELEMENT*)instr->node, memory, instr->line) ? pc + 1 : instr->fail;
+        break;
+
+      case VM_CALL: {
+        vm_flush(&run);  // int() and float() read their argument from memory
+
+        struct RAM_VALUE* value = execute_assignment_to_function_call((struct FUNCTION_CALL*)instr->node, memory, instr->line);
+
+        if (value == NULL) { // error msg already output, if any
+          pc = instr->fail;
+          break;
+        }
+
+        r[instr->a] = *value; // the str of input() is copied by the store
+        free(value);
+        pc++;
+        break;
+      }
+
+      default:
+        printf("**INTERNAL ERROR: unknown instruction %d\n", instr->op);
+        pc = vm->length - 1;  // the VM_HALT
+        break;
+    }
+  }
+}
+
+
+//
+// vm_destroy
+//
+void vm_destroy(struct VM_PROGRAM* vm)
+{
+  if (vm == NULL) {
+    return;
+  }
+
+  free(vm->code);
+  free(vm->constants);
+  free(vm->names);
+  free(vm);
+}
+
+
+//
+// vm_print
+//
+// Prints the bytecode, e.g.
+//
+//    12: ADD               2,    5,    9   (line 5, fails to 3)
+//
+// Registers 0 .. 3 are the temporaries, then come the variables and
+// the constants.
+//
+void vm_print(struct VM_PROGRAM* vm)
+{
+  static const char* names[] = {
+    "HALT", "COMPACT", "LOOP", "JUMP_IF_FALSE", "FAIL",
+    "LOAD_VAR", "ADDRESS_OF", "DEREF",
+    "ADD", "SUB", "MUL", "DIV", "MOD", "EQ", "NE", "LT", "LE", "GT", "GE",
+    "BINARY", "JUMP_UNLESS_LT", "JUMP_UNLESS_LE", "JUMP_UNLESS_GT",
+    "JUMP_UNLESS_GE", "JUMP_UNLESS_EQ", "JUMP_UNLESS_NE",
+    "LOOP_LT", "LOOP_LE", "LOOP_GT", "LOOP_GE", "LOOP_EQ", "LOOP_NE",
+    "STORE", "POINTER", "STORE_AT", "PRINT", "CALL"
+  };
+  _Static_assert(sizeof(names) / sizeof(names[0]) == VM_CALL + 1, "one name per enum VM_OPS");
+
+  printf("**BYTECODE**\n");
+  printf("%d instructions, %d variables from register %d, %d constants from register %d\n",
+    vm->length, vm->num_slots, VM_NUM_TEMPORARIES, vm->num_constants, VM_NUM_TEMPORARIES + vm->num_slots);
+
+  for (int i = 0; i < vm->length; i++) {
+    struct VM_INSTR* instr = &vm->code[i];
+    printf("%5d: %-15s %4d, %4d, %4d   (line %d, fails to %d)\n",
+      i, names[instr->op], instr->a, instr->b, instr->c, instr->line, instr->fail);
+  }
+}
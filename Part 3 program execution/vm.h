@@ -0,0 +1,179 @@
+/*vm.h*/
+
+//
+// A second engine for running nuPython programs: the program graph
+// is lowered once into compact register bytecode, which a single
+// dispatch loop then runs. Output and semantic errors are the same
+// as execute (see execute.h), only the statements are not re-walked
+// through the graph on every iteration of a loop.
+//
+// The register file has three parts:
+//
+//   temporaries  R_LHS .. R_POINTER, values of the current statement
+//   variables    one register per slot (see resolve.h)
+//   constants    the decoded literals, loaded when the run starts
+//
+// so an operand is just a register #, whatever it names. Variables
+// still live in memory (see ram.h), and memory ends up the same
+// whichever engine ran. The register of a variable caches its value
+// (never a str, which memory may move), so reading it does not peek
+// memory; it holds RAM_TYPE_NONE while nothing is cached. Stores of
+// cached values are written back to memory only before memory is
+// read, see vm.c, so a loop updating ints or reals runs without
+// touching memory at all.
+//
+// Unless memory's writes are observed (see ram_writes_observed):
+// write hooks, concurrent readers, an open transaction, a snapshot
+// or -DRAM_STATS must see every write as it happens, so then no
+// register caches a variable, and every load and store goes to
+// memory just as under execute. Observers are checked when the run
+// starts and again at every safe point (VM_COMPACT, VM_LOOP and
+// VM_LOOP_LT ..), where the cached variables are written back once
+// one turns up.
+//
+// An instruction that can fail (a semantic error) names where to go
+// when it does: the head of the innermost enclosing loop, or the end
+// of the program at the top level. That is how execute behaves: a
+// failed statement in a loop body ends that iteration, anywhere else
+// it ends the program.
+//
+// Irene Ha
+// Northwestern University
+// CS 211
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+#include "programgraph.h"
+#include "ram.h"
+
+
+//
+// Instructions. Operands a, b and c are registers, slots or jump
+// targets, depending on the instruction:
+//
+enum VM_OPS
+{
+  VM_HALT = 0,       // end of the program
+  VM_COMPACT,        // safe point: ram_compact, no temporary is live
+  VM_LOOP,           // safe point, then goto c: the end of a loop body
+  VM_JUMP_IF_FALSE,  // if register a holds 0, goto c
+  VM_FAIL,           // semantic error, a = enum VM_FAILURES
+  VM_LOAD_VAR,       // register a = register b, a variable, read now
+  VM_ADDRESS_OF,     // register a = &variable in slot b
+  VM_DEREF,          // register a = *variable in slot b
+  VM_ADD,            // register a = register b + register c, and so on; if a
+                     // is a variable, the result is stored to it. Two ints
+                     // are done inline, other types go through the inline
+                     // cache of the EXPR in node (see execute_cached_operation)
+  VM_SUB,
+  VM_MUL,
+  VM_DIV,
+  VM_MOD,
+  VM_EQ,
+  VM_NE,
+  VM_LT,
+  VM_LE,
+  VM_GT,
+  VM_GE,
+  VM_BINARY,         // the same for any other operator, always through the cache
+  VM_JUMP_UNLESS_LT, // if !(register a < register b), goto c, and so on
+  VM_JUMP_UNLESS_LE,
+  VM_JUMP_UNLESS_GT,
+  VM_JUMP_UNLESS_GE,
+  VM_JUMP_UNLESS_EQ,
+  VM_JUMP_UNLESS_NE,
+  VM_LOOP_LT,        // safe point, then if register a < register b, goto c, and so on
+  VM_LOOP_LE,
+  VM_LOOP_GT,
+  VM_LOOP_GE,
+  VM_LOOP_EQ,
+  VM_LOOP_NE,
+  VM_STORE,          // variable in slot a = register b
+  VM_POINTER,        // register a = pointer in slot b, for *p = ...
+  VM_STORE_AT,       // memory[register a] = register b, p's slot in c
+  VM_PRINT,          // print(ELEMENT in node)
+  VM_CALL            // register a = input(), int() or float(), FUNCTION_CALL in node
+};
+
+//
+// What a VM_FAIL instruction reports before it fails:
+//
+enum VM_FAILURES
+{
+  VM_FAILURE_SILENT = 0,  // nothing, e.g. unary + and -
+  VM_FAILURE_ELEMENT,     // invalid element types
+  VM_FAILURE_STMT         // unsupported stmt type, e.g. if
+};
+
+//
+// The temporaries, registers 0 .. 3. The variable in slot s is
+// register VM_NUM_TEMPORARIES + s, constant k comes after the last
+// variable.
+//
+enum VM_REGISTERS
+{
+  R_LHS = 0,
+  R_RHS,
+  R_RESULT,
+  R_POINTER,
+  VM_NUM_TEMPORARIES
+};
+
+struct VM_INSTR
+{
+  int   op;     // enum VM_OPS
+  int   a, b, c;
+  int   fail;   // index of the instruction to go to if this one fails
+  int   line;   // line # of the statement, for error messages
+  void* node;   // what else the instruction needs, see enum VM_OPS, else NULL
+};
+
+struct VM_PROGRAM
+{
+  struct VM_INSTR* code;
+  int length;
+  int capacity;
+
+  struct RAM_VALUE* constants;  // decoded literals, a str points into the graph
+  int num_constants;
+  int constants_capacity;
+
+  char** names;                 // interned identifier of each slot
+  int    num_slots;
+};
+
+
+//
+// vm_compile
+//
+// Lowers the given program graph, which must have been resolved
+// (see resolve.h), into bytecode. num_slots is the # returned by
+// resolve_program. The bytecode points into the graph, which must
+// outlive it.
+//
+struct VM_PROGRAM* vm_compile(struct STMT* program, int num_slots);
+
+//
+// vm_execute
+//
+// Runs the bytecode with the given memory, with the same output
+// and semantic errors as execute(program, memory).
+//
+void vm_execute(struct VM_PROGRAM* vm, struct RAM* memory);
+
+//
+// vm_destroy
+//
+// Frees the bytecode; the program graph is not affected.
+//
+void vm_destroy(struct VM_PROGRAM* vm);
+
+//
+// vm_print
+//
+// Prints the bytecode to the console, one instruction per line.
+//
+void vm_print(struct VM_PROGRAM* vm);
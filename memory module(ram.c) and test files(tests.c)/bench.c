@@ -0,0 +1,669 @@
+/*bench.c*/
+
+//
+// timing harness for the memory module. Builds a memory with N
+// identifiers and measures how long ram_get_addr takes per lookup,
+// which should stay flat as N grows now that lookups go through
+// the hash index instead of a linear scan. Also times a scan over
+// every value at 100k and 4M cells in each layout (see RAM_LAYOUTS),
+// and a sweep that reads the storage directly: at 4M the values no
+// longer fit in cache, and the sweep time follows the bytes each
+// layout keeps per value. Last, dumps 1M values to /dev/null
+// with one printf per field (the way ram_print used to) and with
+// ram_dump in each format, and times many tiny runs, each on a fresh
+// memory or on one recycled through a RAM_POOL.
+//
+// The suite (make bench-json) times the hot path one function at a
+// time --- ram_write_cell_by_name creating cells from ram_init (so
+// with growth), and updating them, ram_write_cell_by_addr,
+// ram_get_addr, ram_read_cell_by_name and _by_addr --- over 10 to 1M
+// variables holding ints or strings of 8, 64 and 512 chars, and
+// writes the results as JSON in the layout of Google Benchmark's
+// --benchmark_format=json, so its tools/compare.py can diff the files
+// of two versions.
+//
+// usage: make bench
+//        ./bench.out scan cells|soa|boxed   (one scan run, for perf stat,
+//                                            see make bench-layout)
+//        ./bench.out writes           (ns/write with no write hooks,
+//                                      see make bench-hooks)
+//        ./bench.out json [FILE]      (the suite, to FILE or stdout,
+//                                      see make bench-json)
+//
+// Irene Ha
+// Northwestern University
+// CS 211
+//
+
+// for clock_gettime with -std=c11
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <time.h>
+#include <stdint.h>   // uint64_t
+
+#include "ram.h"
+#include "ram_dump.h"
+#include "ram_pool.h"
+
+
+/* now_ns
+returns the current time of a monotonic clock in nanoseconds
+
+parameters: none
+returns: double
+*/
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+
+/* bench_get_addr
+writes n identifiers to a fresh memory, then times `lookups` calls
+to ram_get_addr spread over all of them
+
+parameters: int, int   // # of identifiers, # of lookups to time
+returns: double        // average ns per lookup
+*/
+static double bench_get_addr(int n, int lookups) {
+  struct RAM* memory = ram_init();
+
+  struct RAM_VALUE value;
+  value.value_type = RAM_TYPE_INT;
+
+  char name[32];
+  for (int i = 0; i < n; i++) {
+    value.types.i = i;
+    snprintf(name, sizeof(name), "var%d", i);
+    ram_write_cell_by_name(memory, value, name);
+  }
+
+  // pre-build the names so we only time the lookups
+  char (*names)[32] = malloc(sizeof(*names) * n);
+  for (int i = 0; i < n; i++) {
+    snprintf(names[i], sizeof(names[i]), "var%d", i);
+  }
+
+  long checksum = 0;
+  double start = now_ns();
+  for (int k = 0; k < lookups; k++) {
+    int i = (int)(((unsigned)k * 2654435761u) % (unsigned)n); // spread over all cells
+    checksum += ram_get_addr(memory, names[i]);
+  }
+  double elapsed = now_ns() - start;
+
+  if (checksum < 0) { // keeps the loop from being optimized away
+    printf("unexpected checksum\n");
+  }
+
+  free(names);
+  ram_destroy(memory);
+
+  return elapsed / lookups;
+}
+
+
+/* bench_scan
+writes n int values to a fresh memory with the given layout, then
+times `passes` scans that peek at every value and sum the ints
+
+parameters: int, int, int   // layout, # of values, # of passes
+returns: double             // average ns per value peeked
+*/
+static double bench_scan(int layout, int n, int passes) {
+  struct RAM* memory = ram_init_layout(layout);
+
+  struct RAM_VALUE value;
+  value.value_type = RAM_TYPE_INT;
+
+  char name[32];
+  for (int i = 0; i < n; i++) {
+    value.types.i = i;
+    snprintf(name, sizeof(name), "var%d", i);
+    ram_write_cell_by_name(memory, value, name);
+  }
+
+  long sum = 0;
+  double start = now_ns();
+  for (int pass = 0; pass < passes; pass++) {
+    for (int addr = 0; addr < n; addr++) {
+      const struct RAM_VALUE* v = ram_peek_cell_by_addr(memory, addr);
+      if (v->value_type == RAM_TYPE_INT) {
+        sum += v->types.i;
+      }
+    }
+  }
+  double elapsed = now_ns() - start;
+
+  if (sum < 0) { // keeps the loop from being optimized away
+    printf("unexpected sum\n");
+  }
+
+  ram_destroy(memory);
+
+  return elapsed / ((double)n * passes);
+}
+
+
+/* bench_sweep
+like bench_scan, but reads each layout's storage directly instead of
+going through ram_peek_cell_by_addr, so the time is the memory traffic
+of the layout itself rather than the cost of the call
+
+parameters: int, int, int   // layout, # of values, # of passes
+returns: double             // average ns per value
+*/
+static double bench_sweep(int layout, int n, int passes) {
+  struct RAM* memory = ram_init_layout(layout);
+
+  struct RAM_VALUE value;
+  value.value_type = RAM_TYPE_INT;
+
+  char name[32];
+  for (int i = 0; i < n; i++) {
+    value.types.i = i;
+    snprintf(name, sizeof(name), "var%d", i);
+    ram_write_cell_by_name(memory, value, name);
+  }
+
+  long sum = 0;
+  double start = now_ns();
+  for (int pass = 0; pass < passes; pass++) {
+    if (layout == RAM_LAYOUT_CELLS) {
+      for (int addr = 0; addr < n; addr++) {
+        if (memory->cells[addr].value.value_type == RAM_TYPE_INT) {
+          sum += memory->cells[addr].value.types.i;
+        }
+      }
+    } else if (layout == RAM_LAYOUT_SOA) {
+      for (int addr = 0; addr < n; addr++) {
+        if (memory->tags[addr] == RAM_TYPE_INT) {
+          sum += memory->payloads[addr].i;
+        }
+      }
+    } else {
+      for (int addr = 0; addr < n; addr++) {
+        uint64_t box = memory->payloads[addr].box;
+        if (RAM_BOX_TYPE(box) == RAM_TYPE_INT) {
+          sum += (int)(uint32_t)box;
+        }
+      }
+    }
+  }
+  double elapsed = now_ns() - start;
+
+  if (sum < 0) { // keeps the loop from being optimized away
+    printf("unexpected sum\n");
+  }
+
+  ram_destroy(memory);
+
+  return elapsed / ((double)n * passes);
+}
+
+
+/* bench_writes
+writes n int values to a fresh memory with no write hooks, then times
+`passes` rounds of overwriting every value, half by address and half
+by name. Returns the best round, the least disturbed by the machine.
+
+parameters: int, int   // # of values, # of passes
+returns: double        // ns per write
+*/
+static double bench_writes(int n, int passes) {
+  struct RAM* memory = ram_init_with_capacity(n);
+
+  struct RAM_VALUE value;
+  value.value_type = RAM_TYPE_INT;
+
+  char (*names)[32] = malloc(sizeof(*names) * n);
+  for (int i = 0; i < n; i++) {
+    snprintf(names[i], sizeof(names[i]), "var%d", i);
+    value.types.i = i;
+    ram_write_cell_by_name(memory, value, names[i]);
+  }
+
+  double best = -1;
+  for (int pass = 0; pass < passes; pass++) {
+    double start = now_ns();
+    for (int i = 0; i < n; i++) {
+      value.types.i = pass + i;
+      if (i % 2 == 0) {
+        ram_write_cell_by_addr(memory, value, i);
+      } else {
+        ram_write_cell_by_name(memory, value, names[i]);
+      }
+    }
+    double elapsed = now_ns() - start;
+
+    if (best < 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+
+  free(names);
+  ram_destroy(memory);
+
+  return best / n;
+}
+
+
+/* bench_dump
+fills a memory with n values (ints, reals and strings), and dumps it
+to /dev/null in the given format; format -1 is the old ram_print,
+one printf per field
+
+parameters: int, int   // format (enum RAM_DUMP_FORMATS or -1), # of values
+returns: double        // ms per dump
+*/
+static double bench_dump(int format, int n) {
+  struct RAM* memory = ram_init_with_capacity(n);
+  FILE* out = fopen("/dev/null", "w");
+  char name[32];
+
+  for (int i = 0; i < n; i++) {
+    struct RAM_VALUE value;
+
+    if (i % 3 == 0) {
+      value.value_type = RAM_TYPE_INT;
+      value.types.i = i;
+    } else if (i % 3 == 1) {
+      value.value_type = RAM_TYPE_REAL;
+      value.types.d = i / 8.0;
+    } else {
+      value.value_type = RAM_TYPE_STR;
+      value.types.s = "a string value";
+    }
+
+    snprintf(name, sizeof(name), "var%d", i);
+    ram_write_cell_by_name(memory, value, name);
+  }
+
+  double start = now_ns();
+  if (format < 0) {
+    fprintf(out, "**MEMORY PRINT**\n");
+    fprintf(out, "Capacity: %d\n", memory->capacity);
+    fprintf(out, "Num values: %d\n", memory->num_values);
+    fprintf(out, "Contents:\n");
+
+    for (int i = 0; i < n; i++) {
+      const struct RAM_VALUE* value = ram_peek_cell_by_addr(memory, i);
+      fprintf(out, " %d: %s, ", i, memory->cells[i].identifier);
+
+      if (value->value_type == RAM_TYPE_INT) {
+        fprintf(out, "int, %d", value->types.i);
+      } else if (value->value_type == RAM_TYPE_REAL) {
+        fprintf(out, "real, %lf", value->types.d);
+      } else {
+        fprintf(out, "str, '%s'", value->types.s);
+      }
+      fprintf(out, "\n");
+    }
+    fprintf(out, "**END PRINT**\n");
+    fflush(out);
+  } else {
+    struct RAM_DUMP_OPTIONS options;
+    ram_dump_options_init(&options);
+    options.format = format;
+    ram_dump(memory, &options, out);
+  }
+  double elapsed = now_ns() - start;
+
+  fclose(out);
+  ram_destroy(memory);
+
+  return elapsed / 1e6;
+}
+
+
+/* bench_runs
+times `runs` tiny runs, each writing n variables (every fourth a
+string too long to be inline) and then updating each of them a few
+times: on a memory created and destroyed for the run, or on one
+acquired from and released to a pool
+
+parameters: bool, int, int   // pooled?, # of runs, # of variables
+returns: double              // ns per run
+*/
+static double bench_runs(bool pooled, int runs, int n) {
+  struct RAM_POOL* pool = ram_pool_create(1, 4);
+
+  char (*names)[32] = malloc(sizeof(*names) * n);
+  for (int i = 0; i < n; i++) {
+    snprintf(names[i], sizeof(names[i]), "var%d", i);
+  }
+
+  double start = now_ns();
+  for (int run = 0; run < runs; run++) {
+    struct RAM* memory = pooled ? ram_pool_acquire(pool) : ram_init();
+
+    for (int pass = 0; pass < 4; pass++) {
+      for (int i = 0; i < n; i++) {
+        struct RAM_VALUE value;
+        if (i % 4 == 3) {
+          value.value_type = RAM_TYPE_STR;
+          value.types.s = "a string value too long to be stored inline";
+        } else {
+          value.value_type = RAM_TYPE_INT;
+          value.types.i = run + pass + i;
+        }
+        ram_write_cell_by_name(memory, value, names[i]);
+      }
+    }
+
+    if (pooled) {
+      ram_pool_release(pool, memory);
+    } else {
+      ram_destroy(memory);
+    }
+  }
+  double elapsed = now_ns() - start;
+
+  free(names);
+  ram_pool_destroy(pool);
+
+  return elapsed / runs;
+}
+
+
+//
+// the suite: each result is the best of SUITE_ROUNDS rounds of at
+// least SUITE_MIN_OPS calls, over every variable in turn. Strings
+// are skipped where they would take more than SUITE_MAX_BYTES.
+//
+#define SUITE_ROUNDS    3
+#define SUITE_MIN_OPS   500000
+#define SUITE_MAX_BYTES (128L * 1024 * 1024)
+
+enum SUITE_OPS
+{
+  SUITE_GROW = 0,        // write_by_name of new variables, from ram_init
+  SUITE_WRITE_BY_NAME,   // write_by_name of existing variables
+  SUITE_WRITE_BY_ADDR,
+  SUITE_GET_ADDR,
+  SUITE_READ_BY_NAME,
+  SUITE_READ_BY_ADDR,
+  SUITE_NUM_OPS
+};
+
+static char* suite_op_names[] = { "grow", "write_by_name", "write_by_addr", "get_addr", "read_by_name", "read_by_addr" };
+
+struct SUITE_RESULT
+{
+  long   iterations;  // # of calls timed in the best round
+  double real_ns;     // per call
+  double cpu_ns;      // per call
+};
+
+
+/* cpu_ns
+returns the CPU time used by the process so far in nanoseconds
+
+parameters: none
+returns: double
+*/
+static double cpu_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+
+/* suite_pass
+calls the function of the given op once for every variable
+
+parameters: int, struct RAM*, char**, int, struct RAM_VALUE
+            // op, memory, names, # of variables, value written
+returns: long   // a checksum, so the calls can't be optimized away
+*/
+static long suite_pass(int op, struct RAM* memory, char** names, int n, struct RAM_VALUE value) {
+  long checksum = 0;
+
+  for (int i = 0; i < n; i++) {
+    if (op == SUITE_GROW || op == SUITE_WRITE_BY_NAME) {
+      checksum += ram_write_cell_by_name(memory, value, names[i]);
+    } else if (op == SUITE_WRITE_BY_ADDR) {
+      checksum += ram_write_cell_by_addr(memory, value, i);
+    } else if (op == SUITE_GET_ADDR) {
+      checksum += ram_get_addr(memory, names[i]);
+    } else {
+      struct RAM_VALUE* read = (op == SUITE_READ_BY_NAME) ? ram_read_cell_by_name(memory, names[i])
+                                                          : ram_read_cell_by_addr(memory, i);
+      checksum += read->value_type;
+      ram_free_value(read);
+    }
+  }
+
+  return checksum;
+}
+
+
+/* suite_measure
+times one op over n variables holding the given value
+
+parameters: int, char**, int, struct RAM_VALUE   // op, names, # of variables, value
+returns: struct SUITE_RESULT
+*/
+static struct SUITE_RESULT suite_measure(int op, char** names, int n, struct RAM_VALUE value) {
+  int passes = (n >= SUITE_MIN_OPS) ? 1 : (SUITE_MIN_OPS + n - 1) / n;
+  long checksum = 0;
+
+  struct RAM* memory = NULL;
+  if (op != SUITE_GROW) {
+    memory = ram_init();
+    checksum += suite_pass(SUITE_GROW, memory, names, n, value);
+  }
+
+  struct SUITE_RESULT best;
+  best.iterations = (long)passes * n;
+  best.real_ns = -1;
+  best.cpu_ns = -1;
+
+  // growth starts from a fresh memory each pass: they are all created
+  // before the clock starts and destroyed after it stops
+  struct RAM** fresh = NULL;
+  if (op == SUITE_GROW) {
+    fresh = (struct RAM**)malloc(passes * sizeof(struct RAM*));
+  }
+
+  for (int round = 0; round < SUITE_ROUNDS; round++) {
+    for (int pass = 0; pass < passes && op == SUITE_GROW; pass++) {
+      fresh[pass] = ram_init();
+    }
+
+    double real_start = now_ns();
+    double cpu_start = cpu_ns();
+    for (int pass = 0; pass < passes; pass++) {
+      checksum += suite_pass(op, (op == SUITE_GROW) ? fresh[pass] : memory, names, n, value);
+    }
+    double cpu = cpu_ns() - cpu_start;
+    double real = now_ns() - real_start;
+
+    for (int pass = 0; pass < passes && op == SUITE_GROW; pass++) {
+      ram_destroy(fresh[pass]);
+    }
+
+    if (best.real_ns < 0 || real < best.real_ns) {
+      best.real_ns = real;
+      best.cpu_ns = cpu;
+    }
+  }
+  free(fresh);
+
+  if (checksum < 0) { // keeps the calls from being optimized away
+    printf("unexpected checksum\n");
+  }
+
+  ram_destroy(memory);
+
+  best.real_ns /= best.iterations;
+  best.cpu_ns /= best.iterations;
+  return best;
+}
+
+
+/* suite_run
+runs the whole suite, writing JSON to out
+
+parameters: FILE*, char*   // output, name of this executable
+returns: nothing
+*/
+static void suite_run(FILE* out, char* executable) {
+  int sizes[] = { 10, 100, 1000, 10000, 100000, 1000000 };
+  int num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+  int string_bytes[] = { 0, 8, 64, 512 };  // 0 => int values
+  int num_strings = sizeof(string_bytes) / sizeof(string_bytes[0]);
+  int max_n = sizes[num_sizes - 1];
+
+  // names are made up front, so only the calls are timed
+  char** names = (char**)malloc(max_n * sizeof(char*));
+  char (*storage)[16] = malloc(sizeof(*storage) * max_n);
+  for (int i = 0; i < max_n; i++) {
+    snprintf(storage[i], sizeof(storage[i]), "var%d", i);
+    names[i] = storage[i];
+  }
+
+  char date[32];
+  time_t now = time(NULL);
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+  fprintf(out, "{\n");
+  fprintf(out, "  \"context\": {\n");
+  fprintf(out, "    \"date\": \"%s\",\n", date);
+  fprintf(out, "    \"executable\": \"%s\",\n", executable);
+  fprintf(out, "    \"rounds\": %d,\n", SUITE_ROUNDS);
+  fprintf(out, "    \"min_ops\": %d,\n", SUITE_MIN_OPS);
+  fprintf(out, "    \"inline_str_max\": %d\n", RAM_INLINE_STR_MAX);
+  fprintf(out, "  },\n");
+  fprintf(out, "  \"benchmarks\": [");
+
+  bool first = true;
+  for (int op = 0; op < SUITE_NUM_OPS; op++) {
+    for (int k = 0; k < num_strings; k++) {
+      if (op == SUITE_GET_ADDR && string_bytes[k] != 0) {
+        continue;  // lookups never look at the value
+      }
+
+      char* text = (char*)malloc(string_bytes[k] + 1);
+      memset(text, 'x', string_bytes[k]);
+      text[string_bytes[k]] = '\0';
+
+      struct RAM_VALUE value;
+      if (string_bytes[k] == 0) {
+        value.value_type = RAM_TYPE_INT;
+        value.types.i = 123;
+      } else {
+        value.value_type = RAM_TYPE_STR;
+        value.types.s = text;
+      }
+
+      for (int j = 0; j < num_sizes; j++) {
+        if ((long)sizes[j] * string_bytes[k] > SUITE_MAX_BYTES) {
+          continue;
+        }
+
+        struct SUITE_RESULT result = suite_measure(op, names, sizes[j], value);
+
+        char name[64];
+        if (string_bytes[k] == 0) {
+          snprintf(name, sizeof(name), "%s/%d/int", suite_op_names[op], sizes[j]);
+        } else {
+          snprintf(name, sizeof(name), "%s/%d/str%d", suite_op_names[op], sizes[j], string_bytes[k]);
+        }
+
+        fprintf(out, "%s\n    {\"name\": \"%s\", \"run_name\": \"%s\", \"run_type\": \"iteration\", ", first ? "" : ",", name, name);
+        fprintf(out, "\"op\": \"%s\", \"variables\": %d, \"string_bytes\": %d, ", suite_op_names[op], sizes[j], string_bytes[k]);
+        fprintf(out, "\"iterations\": %ld, \"real_time\": %.3f, \"cpu_time\": %.3f, \"time_unit\": \"ns\"}",
+                result.iterations, result.real_ns, result.cpu_ns);
+        fflush(out);
+        first = false;
+      }
+
+      free(text);
+    }
+  }
+
+  fprintf(out, "\n  ]\n}\n");
+
+  free(storage);
+  free(names);
+}
+
+
+int main(int argc, char* argv[])
+{
+  if ((argc == 2 || argc == 3) && strcmp(argv[1], "json") == 0) {
+    FILE* out = (argc == 3) ? fopen(argv[2], "w") : stdout;
+    if (out == NULL) {
+      printf("**ERROR: unable to open '%s'\n", argv[2]);
+      return 1;
+    }
+    suite_run(out, argv[0]);
+    if (out != stdout) {
+      fclose(out);
+    }
+    return 0;
+  }
+
+  if (argc == 2 && strcmp(argv[1], "writes") == 0) {
+    printf("%.3f\n", bench_writes(1000, 2000));
+    return 0;
+  }
+
+  if (argc == 3 && strcmp(argv[1], "scan") == 0) {
+    int layout = RAM_LAYOUT_CELLS;
+    if (strcmp(argv[2], "soa") == 0) {
+      layout = RAM_LAYOUT_SOA;
+    } else if (strcmp(argv[2], "boxed") == 0) {
+      layout = RAM_LAYOUT_BOXED;
+    }
+    double ns = bench_scan(layout, 100000, 200);
+    printf("scan %s: %.2f ns/value\n", argv[2], ns);
+    return 0;
+  }
+
+  int sizes[] = { 10, 100, 1000, 10000, 100000 };
+  int num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+
+  printf("ram_get_addr lookup time\n");
+  printf("%10s  %12s\n", "identifiers", "ns/lookup");
+
+  for (int i = 0; i < num_sizes; i++) {
+    double ns = bench_get_addr(sizes[i], 1000000);
+    printf("%10d  %12.1f\n", sizes[i], ns);
+  }
+
+  // bytes scanned per value: the whole cell, tag + payload, one word
+  char* layouts[] = { "cells", "soa", "boxed" };
+  int value_bytes[] = { (int)sizeof(struct RAM_CELL), 1 + (int)sizeof(union RAM_PAYLOAD), (int)sizeof(union RAM_PAYLOAD) };
+
+  printf("\nscan of every value, ns/value (peek: through ram_peek_cell_by_addr, sweep: storage read directly)\n");
+  printf("%10s  %12s  %12s  %12s  %12s\n", "layout", "bytes/value", "100k peek", "4M peek", "4M sweep");
+  for (int layout = RAM_LAYOUT_CELLS; layout <= RAM_LAYOUT_BOXED; layout++) {
+    double small = bench_scan(layout, 100000, 200);
+    double large = bench_scan(layout, 4000000, 5);
+    double sweep = bench_sweep(layout, 4000000, 20);
+    printf("%10s  %12d  %12.2f  %12.2f  %12.2f\n", layouts[layout], value_bytes[layout], small, large, sweep);
+  }
+
+  char* formats[] = { "printf", "human", "json", "binary" };
+
+  printf("\ndump of 1M values to /dev/null\n");
+  printf("%10s  %12s\n", "format", "ms");
+  for (int format = -1; format <= RAM_DUMP_BINARY; format++) {
+    printf("%10s  %12.1f\n", formats[format + 1], bench_dump(format, 1000000));
+  }
+
+  printf("\ntiny runs (4 passes over the variables), ns/run\n");
+  printf("%10s  %12s  %12s\n", "variables", "init+destroy", "pooled");
+  for (int n = 8; n <= 128; n *= 4) {
+    printf("%10d  %12.0f  %12.0f\n", n, bench_runs(false, 200000, n), bench_runs(true, 200000, n));
+  }
+
+  return 0;
+}
@@ -0,0 +1,99 @@
+/*intern.h*/
+
+//
+// Global intern pool for identifiers. Interning a string returns
+// the one canonical copy of it, so two interned strings are equal
+// exactly when their pointers are equal. The program graph pass
+// (resolve.h) interns every identifier once before execution, and
+// RAM stores the interned copy as the cell's identifier.
+//
+// Every canonical copy is reference counted: intern adds a
+// reference and intern_release drops one. Memories instead keep
+// their cells' names with intern_keep, and each one is a holder
+// (intern_hold) for as long as it lives: kept names stay until the
+// last holder goes, then leave the pool in one sweep unless someone
+// still references them. So clearing a memory never touches the
+// pool. The pool is safe to use from several threads at once once
+// intern_threads_enable has been called.
+//
+// Irene Ha
+// Northwestern University
+// CS 211
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+
+//
+// intern
+//
+// Returns the canonical copy of the given string, adding a copy
+// to the pool the first time the string is seen, and adds a
+// reference to it. Returns NULL if s is NULL.
+//
+// NOTE: the pool owns the returned string, the caller must not
+// modify or free it. It lives until every reference is released
+// (and, if kept, until the last holder is gone).
+//
+char* intern(char* s);
+
+//
+// intern_release
+//
+// Drops a reference to a canonical copy returned by intern,
+// removing it from the pool (and freeing it) when the last
+// reference is gone, unless it is kept. Does nothing if s is NULL
+// or not in the pool.
+//
+void intern_release(char* s);
+
+//
+// intern_keep
+//
+// Like intern, but rather than adding a reference, keeps the
+// canonical copy for as long as there are holders (see
+// intern_hold). Returns NULL if s is NULL.
+//
+char* intern_keep(char* s);
+
+//
+// intern_hold, intern_unhold
+//
+// Add and remove a holder. Strings passed to intern_keep stay in
+// the pool while there is at least one; the last intern_unhold
+// drops every kept string that has no references left.
+//
+void intern_hold(void);
+void intern_unhold(void);
+
+//
+// intern_threads_enable
+//
+// From now on the pool may be used by several threads at once, so
+// it takes locks. Must be called before a second thread uses the
+// pool; until then no locks are taken.
+//
+void intern_threads_enable(void);
+
+//
+// intern_find
+//
+// Like intern, but never adds to the pool or adds a reference:
+// returns the canonical copy of the given string, or NULL if the
+// string is not in the pool. If s is itself a canonical copy, this
+// costs a pointer hash and compare, no characters are looked at.
+//
+// NOTE: the copy returned is only sure to stay in the pool while
+// someone holds a reference to it, or it is kept and held.
+//
+char* intern_find(char* s);
+
+//
+// intern_is_canonical
+//
+// Returns true if the given pointer is a canonical copy handed out
+// by intern, false otherwise. Only looks at the pointer.
+//
+bool intern_is_canonical(char* s);
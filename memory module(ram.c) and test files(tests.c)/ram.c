@@ -15,8 +15,49 @@
 #include <stdbool.h> // true, false
 #include <string.h>
 #include <assert.h>
+#include <stdint.h>  // uintptr_t
+#include <stddef.h>  // offsetof
+#include <limits.h>  // INT_MAX
 
 #include "ram.h"
+#include "ram_dump.h"
+#include "intern.h"
+
+
+//
+// the check every write makes for write hooks. RAM_NO_WRITE_HOOKS
+// compiles it out (hooks can still be added, they are just never
+// called), only so make bench-hooks can measure what the check costs.
+//
+#ifdef RAM_NO_WRITE_HOOKS
+#define RAM_HOOKS_ACTIVE(memory) false
+#else
+#define RAM_HOOKS_ACTIVE(memory) __builtin_expect((memory)->num_hooks != 0, 0)
+#endif
+
+
+//
+// per-cell access statistics (see ram_print_stats), only counted when
+// built with -DRAM_STATS; otherwise these compile to nothing. String
+// bytes are tallied by the code that copies them, then charged to the
+// cell the read or write was for.
+//
+#ifdef RAM_STATS
+static unsigned long ram_stat_bytes = 0;  // string bytes copied, not yet charged to a cell
+#define RAM_STAT(memory, addr, counter)  ((memory)->stats[addr].counter++)
+#define RAM_STAT_COPIED(n)               (ram_stat_bytes += (unsigned long)(n))
+#define RAM_STAT_CHARGE(memory, addr)    ((memory)->stats[addr].str_bytes += ram_stat_bytes, ram_stat_bytes = 0)
+#else
+#define RAM_STAT(memory, addr, counter)  ((void)0)
+#define RAM_STAT_COPIED(n)               ((void)0)
+#define RAM_STAT_CHARGE(memory, addr)    ((void)0)
+#endif
+
+
+//
+// # of dirty bits per word of memory->dirty
+//
+#define RAM_DIRTY_BITS ((int)(8 * sizeof(unsigned long)))
 
 
 // 
@@ -42,403 +83,3095 @@ char* dupString(char* s) {
     exit(1);  // Exit or handle the error appropriately
   }
 
-  strcpy(copy, s);
-  return copy;
+  strcpy(copy, s);
+  return copy;
+}
+
+
+/* ram_hash
+hashes an interned identifier for the index. Interned identifiers
+are unique per name, so the pointer itself is hashed (Fibonacci
+hashing) and no characters are looked at.
+
+parameters: char*    // the interned identifier
+returns: unsigned int  // the hash value
+*/
+static unsigned int ram_hash(char* identifier) {
+  uintptr_t p = (uintptr_t)identifier;
+  return (unsigned int)((p >> 3) * 2654435761u);
+}
+
+
+/* ram_identifier_at
+returns the interned identifier of the cell at the given address,
+wherever the layout keeps it
+
+parameters: struct RAM*, int   // memory and a valid address
+returns: char*
+*/
+static char* ram_identifier_at(struct RAM* memory, int addr) {
+  if (memory->layout != RAM_LAYOUT_CELLS) {
+    return memory->identifiers[addr];
+  }
+  return memory->cells[addr].identifier;
+}
+
+
+/* ram_index_addr
+returns the address the given index slot holds, or -1 if the slot is
+empty. Slots hold address + index_base, anything below index_base was
+left by a memory since reset and counts as empty.
+
+parameters: struct RAM*, int   // memory and slot #
+returns: int
+*/
+static int ram_index_addr(struct RAM* memory, int slot) {
+  int stored = memory->index[slot];
+  return (stored >= memory->index_base) ? stored - memory->index_base : -1;
+}
+
+
+/* ram_index_probe
+walks the index starting at the identifier's home slot until it finds
+the slot holding this identifier or the first empty slot. The
+identifier must be interned, cells are matched by pointer equality.
+
+parameters: struct RAM*, char*   // memory and interned identifier to look for
+returns: int                     // slot #, ram_index_addr is -1 if not found
+*/
+static int ram_index_probe(struct RAM* memory, char* identifier) {
+  int mask = memory->index_capacity - 1;  // capacity is a power of 2
+  int slot = (int)(ram_hash(identifier) & (unsigned int)mask);
+  int addr;
+
+  while ((addr = ram_index_addr(memory, slot)) != -1) {
+    if (ram_identifier_at(memory, addr) == identifier) {
+      return slot; // found it, interned names compare by pointer
+    }
+    slot = (slot + 1) & mask; // linear probing, wrap around
+  }
+
+  return slot; // empty slot
+}
+
+
+//
+// Strings too long to be stored inline are immutable and reference
+// counted: the cell, and every copy handed out by ram_read_cell_by_*,
+// share one RAM_STR and just bump its count. value.types.s points at
+// the chars, the header sits right before them. Every live RAM_STR is
+// in a registry (a pointer set), so a string handed back to a write
+// can be recognized as shared instead of being copied again.
+//
+// A string a memory stores for itself lives in that memory's arena
+// instead (see RAM_ARENA_CLASSES). It is not registered, so only the
+// memory's cells and journal share it, and compaction can find and
+// move every reference. The first time a read or a snapshot hands it
+// out, it is published (see ram_str_publish): registered and shared
+// like any other RAM_STR from then on, its block kept until the last
+// reference is gone, even after its memory.
+//
+struct RAM_STR
+{
+  int   refs;       // # of cells and read copies sharing this string
+  int   length;     // strlen(chars)
+  short block;      // arena size class, -1 if malloc'ed and registered
+  bool  published;  // arena string handed out, and registered since
+  char  chars[];    // the string itself, never modified once created
+};
+
+//
+// one chunk of a memory's string arena, blocks are bumped off data.
+// Chunks are RAM_ARENA_CHUNK_SIZE-aligned, so a published string
+// finds its chunk from its address alone.
+//
+struct RAM_ARENA_CHUNK
+{
+  size_t size;  // bytes in data
+  size_t used;
+  int    refs;  // 1 while its memory uses it, +1 per published string in it
+  char   data[];
+};
+
+//
+// the registry of shared strings, split into stripes (picked by the
+// top bits of the pointer's hash) that each have their own lock, since
+// memories in different threads register and release strings, and a
+// string read from one memory may be written to another
+//
+#define RAM_STR_STRIPE_BITS 4
+#define RAM_STR_STRIPES (1 << RAM_STR_STRIPE_BITS)
+
+struct RAM_STR_STRIPE
+{
+  int    lock;      // 1 while a thread is using the stripe
+  char** strs;      // open addressing over chars pointers, NULL => empty
+  int    capacity;  // power of 2, kept at most half full
+  int    count;
+};
+
+static struct RAM_STR_STRIPE str_registry[RAM_STR_STRIPES];
+
+static bool ram_threaded;  // set by ram_threads_enable, the registry is locked from then on
+
+
+/* ram_str_header
+returns the header of a shared string given its chars
+
+parameters: char*
+returns: struct RAM_STR*
+*/
+static struct RAM_STR* ram_str_header(char* chars) {
+  return (struct RAM_STR*)(chars - offsetof(struct RAM_STR, chars));
+}
+
+
+/* ram_str_stripe_lock
+takes the lock of the registry stripe chars falls in, and returns the
+stripe. A stripe is only held for a probe or two, so waiting threads
+spin rather than sleep. ram_str_stripe_unlock gives it back. Until
+ram_threads_enable there is only one thread, and no lock is taken.
+
+parameters: char*
+returns: struct RAM_STR_STRIPE*
+*/
+static struct RAM_STR_STRIPE* ram_str_stripe_lock(char* chars) {
+  struct RAM_STR_STRIPE* stripe = &str_registry[ram_hash(chars) >> (32 - RAM_STR_STRIPE_BITS)];
+
+  if (!__builtin_expect(__atomic_load_n(&ram_threaded, __ATOMIC_RELAXED), 0)) {
+    return stripe;
+  }
+
+  while (__atomic_exchange_n(&stripe->lock, 1, __ATOMIC_ACQUIRE) != 0) {
+    while (__atomic_load_n(&stripe->lock, __ATOMIC_RELAXED) != 0) {
+      ;  // spin on a plain load, not on the exchange
+    }
+  }
+  return stripe;
+}
+
+static void ram_str_stripe_unlock(struct RAM_STR_STRIPE* stripe) {
+  if (__builtin_expect(__atomic_load_n(&ram_threaded, __ATOMIC_RELAXED), 0)) {
+    __atomic_store_n(&stripe->lock, 0, __ATOMIC_RELEASE);
+  }
+}
+
+
+/* ram_str_probe
+finds the slot of a registry stripe holding chars, or the empty slot
+where it would go
+
+parameters: struct RAM_STR_STRIPE*, char*
+returns: int   // slot #
+*/
+static int ram_str_probe(struct RAM_STR_STRIPE* stripe, char* chars) {
+  int mask = stripe->capacity - 1;
+  int slot = (int)(ram_hash(chars) & (unsigned int)mask);
+
+  while (stripe->strs[slot] != NULL && stripe->strs[slot] != chars) {
+    slot = (slot + 1) & mask;
+  }
+
+  return slot;
+}
+
+
+/* ram_str_is_shared
+returns true if s is the chars of a live RAM_STR, false for any other
+string (literals, malloc'ed strings, inline buffers). Only looks at the
+pointer, never at the memory around it.
+
+parameters: char*
+returns: bool
+*/
+static bool ram_str_is_shared(char* s) {
+  if (s == NULL) {
+    return false;
+  }
+
+  struct RAM_STR_STRIPE* stripe = ram_str_stripe_lock(s);
+  bool shared = (stripe->count != 0 && stripe->strs[ram_str_probe(stripe, s)] == s);
+  ram_str_stripe_unlock(stripe);
+
+  return shared;
+}
+
+
+/* ram_str_register
+adds a string to the registry, growing its stripe if it would be more
+than half full
+
+parameters: char*   // chars of a RAM_STR
+returns: nothing
+*/
+static void ram_str_register(char* chars) {
+  struct RAM_STR_STRIPE* stripe = ram_str_stripe_lock(chars);
+
+  if (2 * (stripe->count + 1) > stripe->capacity) {
+    char** old = stripe->strs;
+    int old_capacity = stripe->capacity;
+
+    stripe->capacity = (old_capacity == 0) ? 16 : 2 * old_capacity;
+    stripe->strs = (char**)calloc(stripe->capacity, sizeof(char*));
+    if (stripe->strs == NULL) {
+      //printf("ERROR: OUT OF MEMORY\n");
+      exit(1);
+    }
+
+    for (int i = 0; i < old_capacity; i++) {
+      if (old[i] != NULL) {
+        stripe->strs[ram_str_probe(stripe, old[i])] = old[i];
+      }
+    }
+    free(old);
+  }
+
+  stripe->strs[ram_str_probe(stripe, chars)] = chars;
+  stripe->count++;
+  ram_str_stripe_unlock(stripe);
+}
+
+
+/* ram_str_new
+creates a shared string holding a copy of the first len chars of s,
+with a count of 1
+
+parameters: char*, int
+returns: char*   // the chars of the new string
+*/
+static char* ram_str_new(char* s, int length) {
+  struct RAM_STR* str = (struct RAM_STR*)malloc(sizeof(struct RAM_STR) + length + 1);
+  if (str == NULL) {
+    //printf("ERROR: OUT OF MEMORY\n");
+    exit(1);
+  }
+
+  str->refs = 1;
+  str->length = length;
+  str->block = -1;
+  str->published = false;
+  memcpy(str->chars, s, length);
+  str->chars[length] = '\0';
+  RAM_STAT_COPIED(length + 1);
+
+  ram_str_register(str->chars);
+  return str->chars;
+}
+
+
+/* ram_arena_chunk_of
+returns the chunk a published arena string lives in
+
+parameters: char*   // chars of a RAM_STR with block >= 0
+returns: struct RAM_ARENA_CHUNK*
+*/
+static struct RAM_ARENA_CHUNK* ram_arena_chunk_of(char* chars) {
+  return (struct RAM_ARENA_CHUNK*)((uintptr_t)chars & ~(uintptr_t)(RAM_ARENA_CHUNK_SIZE - 1));
+}
+
+
+/* ram_arena_chunk_release
+drops a reference to a chunk, freeing it when its memory and every
+published string in it have let go. The count is atomic, since a
+published string may be released in another thread.
+
+parameters: struct RAM_ARENA_CHUNK*
+returns: nothing
+*/
+static void ram_arena_chunk_release(struct RAM_ARENA_CHUNK* chunk) {
+  if (__atomic_sub_fetch(&chunk->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+    free(chunk);
+  }
+}
+
+
+/* ram_str_retain
+adds a reference to a shared string. The count is atomic, since a
+string read from one memory may be shared by another in another thread.
+
+parameters: char*
+returns: char*   // the same chars, for convenience
+*/
+static char* ram_str_retain(char* chars) {
+  __atomic_add_fetch(&ram_str_header(chars)->refs, 1, __ATOMIC_RELAXED);
+  return chars;
+}
+
+
+/* ram_str_release
+drops a reference to a shared string, freeing it (and removing it
+from the registry) when the last reference is gone. A published arena
+string lets go of its chunk instead.
+
+parameters: char*
+returns: nothing
+*/
+static void ram_str_release(char* chars) {
+  struct RAM_STR* str = ram_str_header(chars);
+
+  if (__atomic_sub_fetch(&str->refs, 1, __ATOMIC_ACQ_REL) > 0) {
+    return;
+  }
+
+  // remove from the registry with backward-shift deletion, so linear
+  // probing never needs tombstones
+  struct RAM_STR_STRIPE* stripe = ram_str_stripe_lock(chars);
+  int mask = stripe->capacity - 1;
+  int hole = ram_str_probe(stripe, chars);
+  stripe->strs[hole] = NULL;
+  stripe->count--;
+
+  int next = (hole + 1) & mask;
+  while (stripe->strs[next] != NULL) {
+    int home = (int)(ram_hash(stripe->strs[next]) & (unsigned int)mask);
+
+    // can the entry at next move back into the hole? only if its home
+    // slot is not cyclically inside (hole, next]
+    bool stays = (hole <= next) ? (hole < home && home <= next)
+                                : (hole < home || home <= next);
+    if (!stays) {
+      stripe->strs[hole] = stripe->strs[next];
+      stripe->strs[next] = NULL;
+      hole = next;
+    }
+    next = (next + 1) & mask;
+  }
+  ram_str_stripe_unlock(stripe);
+
+  if (str->block >= 0) {
+    ram_arena_chunk_release(ram_arena_chunk_of(chars));
+  } else {
+    free(str);
+  }
+}
+
+
+/* ram_str_in_arena
+returns true if the shared string s lives in a memory's arena and
+was never published, i.e. belongs to that memory alone
+
+parameters: char*   // chars of a RAM_STR
+returns: bool
+*/
+static bool ram_str_in_arena(char* chars) {
+  struct RAM_STR* str = ram_str_header(chars);
+  return str->block >= 0 && !str->published;
+}
+
+
+/* ram_arena_owns
+returns true if s points into memory's arena, i.e. is a string
+borrowed from this memory. A binary search over the chunks, which
+only looks at the pointer.
+
+parameters: struct RAM*, char*
+returns: bool
+*/
+static bool ram_arena_owns(struct RAM* memory, char* s) {
+  uintptr_t p = (uintptr_t)s;
+  int lo = 0;
+  int hi = memory->num_arena_chunks - 1;
+
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    struct RAM_ARENA_CHUNK* chunk = memory->arena_chunks[mid];
+
+    if (p < (uintptr_t)chunk->data) {
+      hi = mid - 1;
+    } else if (p >= (uintptr_t)(chunk->data + chunk->used)) {
+      lo = mid + 1;
+    } else {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+/* ram_arena_chunk_new
+adds an empty chunk to memory's arena, keeping the chunks sorted by
+address, and makes it the one blocks are bumped off
+
+parameters: struct RAM*
+returns: nothing
+*/
+static void ram_arena_chunk_new(struct RAM* memory) {
+  if (memory->num_arena_chunks == memory->arena_chunks_capacity) {
+    int capacity = (memory->arena_chunks_capacity == 0) ? 4 : 2 * memory->arena_chunks_capacity;
+    struct RAM_ARENA_CHUNK** chunks = (struct RAM_ARENA_CHUNK**)realloc(memory->arena_chunks, capacity * sizeof(struct RAM_ARENA_CHUNK*));
+    if (chunks == NULL) {
+      //printf("ERROR: OUT OF MEMORY\n");
+      exit(1);
+    }
+    memory->arena_chunks = chunks;
+    memory->arena_chunks_capacity = capacity;
+  }
+
+  struct RAM_ARENA_CHUNK* chunk = (struct RAM_ARENA_CHUNK*)aligned_alloc(RAM_ARENA_CHUNK_SIZE, RAM_ARENA_CHUNK_SIZE);
+  if (chunk == NULL) {
+    //printf("ERROR: OUT OF MEMORY\n");
+    exit(1);
+  }
+  chunk->size = RAM_ARENA_CHUNK_SIZE - sizeof(struct RAM_ARENA_CHUNK);
+  chunk->used = 0;
+  chunk->refs = 1;
+
+  int i = memory->num_arena_chunks;
+  while (i > 0 && (uintptr_t)memory->arena_chunks[i - 1] > (uintptr_t)chunk) {
+    memory->arena_chunks[i] = memory->arena_chunks[i - 1];
+    i--;
+  }
+  memory->arena_chunks[i] = chunk;
+  memory->num_arena_chunks++;
+  memory->arena_top = chunk;
+}
+
+
+/* ram_arena_class
+returns the size class of the arena block a string of the given length
+needs, or -1 if it is too long for the arena
+
+parameters: int
+returns: int
+*/
+static int ram_arena_class(int length) {
+  size_t need = sizeof(struct RAM_STR) + length + 1;
+  size_t size = 32;
+
+  for (int c = 0; c < RAM_ARENA_CLASSES; c++) {
+    if (need <= size) {
+      return c;
+    }
+    size *= 2;
+  }
+
+  return -1;
+}
+
+
+/* ram_arena_alloc
+takes a block of the given size class from the arena: off its free
+list if there is one, else bumped off the top chunk
+
+parameters: struct RAM*, int   // memory and size class
+returns: struct RAM_STR*       // uninitialized
+*/
+static struct RAM_STR* ram_arena_alloc(struct RAM* memory, int c) {
+  size_t size = (size_t)32 << c;
+  memory->arena_live_bytes += size;
+
+  void* block = memory->arena_free[c];
+  if (block != NULL) {
+    memcpy(&memory->arena_free[c], block, sizeof(void*));  // next on the list
+    memory->arena_free_bytes -= size;
+    return (struct RAM_STR*)block;
+  }
+
+  struct RAM_ARENA_CHUNK* chunk = memory->arena_top;
+  if (chunk == NULL || chunk->size - chunk->used < size) {
+    ram_arena_chunk_new(memory);
+    chunk = memory->arena_top;
+  }
+
+  block = chunk->data + chunk->used;
+  chunk->used += size;
+  return (struct RAM_STR*)block;
+}
+
+
+/* ram_arena_free
+lets go of every chunk of an arena, and frees the array of them. A
+chunk holding published strings stays until they are released.
+
+parameters: struct RAM_ARENA_CHUNK**, int   // chunks and # of chunks
+returns: nothing
+*/
+static void ram_arena_free(struct RAM_ARENA_CHUNK** chunks, int num_chunks) {
+  for (int i = 0; i < num_chunks; i++) {
+    ram_arena_chunk_release(chunks[i]);
+  }
+  free(chunks);
+}
+
+
+/* ram_str_store
+returns the string a cell of memory should hold for s: a shared string
+(registered, or in memory's own arena) is shared, anything else is
+copied into the arena (or, if too long, into a new shared string)
+
+parameters: struct RAM*, char*, bool, int   // memory, a string (not NULL),
+                                            // whether it is shared, strlen(s)
+returns: char*
+*/
+static char* ram_str_store(struct RAM* memory, char* s, bool shared, int length) {
+  if (shared) {
+    if (!ram_str_in_arena(s)) {
+      memory->num_foreign_strs++;
+    }
+    return ram_str_retain(s);  // O(1), no copy
+  }
+
+  int c = ram_arena_class(length);
+  if (c < 0) {
+    memory->num_foreign_strs++;
+    return ram_str_new(s, length);
+  }
+
+  struct RAM_STR* str = ram_arena_alloc(memory, c);
+  str->refs = 1;
+  str->length = length;
+  str->block = (short)c;
+  str->published = false;
+  memcpy(str->chars, s, length + 1);
+  RAM_STAT_COPIED(length + 1);
+
+  return str->chars;
+}
+
+
+/* ram_str_drop
+drops a reference to a string of memory, putting an arena block back
+on its free list when the last reference is gone
+
+parameters: struct RAM*, char*
+returns: nothing
+*/
+static void ram_str_drop(struct RAM* memory, char* chars) {
+  struct RAM_STR* str = ram_str_header(chars);
+
+  if (!ram_str_in_arena(chars)) {
+    ram_str_release(chars);
+    return;
+  }
+
+  str->refs--;
+  if (str->refs > 0) {
+    return;
+  }
+
+  size_t size = (size_t)32 << str->block;
+  memcpy(str, &memory->arena_free[str->block], sizeof(void*));  // link it in
+  memory->arena_free[str->block] = str;
+  memory->arena_live_bytes -= size;
+  memory->arena_free_bytes += size;
+}
+
+
+/* ram_str_unstore
+a cell of memory lets go of its string, see ram_str_store
+
+parameters: struct RAM*, char*
+returns: nothing
+*/
+static void ram_str_unstore(struct RAM* memory, char* chars) {
+  if (!ram_str_in_arena(chars)) {
+    memory->num_foreign_strs--;
+  }
+  ram_str_drop(memory, chars);
+}
+
+
+/* ram_str_publish
+turns an arena string of memory into one that can leave it: it is
+registered, its block is never reused (its bytes count as free until
+a compaction), and its chunk stays until the string is released. The
+references memory already holds now count as foreign, see
+num_foreign_strs.
+
+parameters: struct RAM*, char*   // memory and chars of one of its arena strings
+returns: nothing
+*/
+static void ram_str_publish(struct RAM* memory, char* chars) {
+  struct RAM_STR* str = ram_str_header(chars);
+  size_t size = (size_t)32 << str->block;
+
+  memory->arena_live_bytes -= size;
+  memory->arena_free_bytes += size;
+  memory->num_foreign_strs += str->refs;
+
+  __atomic_add_fetch(&ram_arena_chunk_of(chars)->refs, 1, __ATOMIC_RELAXED);
+  str->published = true;
+  ram_str_register(chars);
+}
+
+
+/* ram_str_export
+returns a reference to a string of memory for a copy leaving it (a
+read, a snapshot): shared, an arena string is published first
+
+parameters: struct RAM*, char*   // memory and chars of a RAM_STR
+returns: char*
+*/
+static char* ram_str_export(struct RAM* memory, char* chars) {
+  if (ram_str_in_arena(chars)) {
+    ram_str_publish(memory, chars);
+  }
+  return ram_str_retain(chars);
+}
+
+
+/* ram_cell_share_str
+returns a reference to the cell's string for a copy handed out to a
+caller: a shared string just gets its count bumped, an inline string
+is copied into a new shared string
+
+parameters: struct RAM_CELL*   // cell holding a RAM_TYPE_STR
+returns: char*
+*/
+static char* ram_cell_share_str(struct RAM_CELL* cell) {
+  char* s = cell->value.types.s;
+
+  if (s == NULL) {
+    return NULL;
+  }
+  if (s == cell->inline_str) {
+    return ram_str_new(s, (int)strlen(s));
+  }
+  return ram_str_retain(s);
+}
+
+
+/* ram_copy_str_relaxed
+copies n chars a char at a time with relaxed atomic loads and stores,
+for an inline string a concurrent reader may be copying out as it
+changes (see ram_copy_str_concurrent)
+
+parameters: char*, char*, size_t   // destination, source, # of chars
+returns: nothing
+*/
+static void ram_copy_str_relaxed(char* dst, char* src, size_t n) {
+  for (size_t i = 0; i < n; i++) {  // forward, so dst == src is fine
+    __atomic_store_n(&dst[i], __atomic_load_n(&src[i], __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+  }
+}
+
+
+/* ram_cell_store
+stores a value into a cell. A string of up to RAM_INLINE_STR_MAX chars
+is copied into the cell's inline buffer. A longer one is shared if it
+already is a RAM_STR (from a read, or borrowed from this memory), and
+copied into memory's arena otherwise. The cell's old string is dropped only after
+the new one is stored, since the new value may be borrowed from this
+very cell. The cell must hold a valid value (RAM_TYPE_NONE for a new
+cell).
+
+parameters: struct RAM*, struct RAM_CELL*, struct RAM_VALUE
+returns: nothing
+*/
+static void ram_cell_store(struct RAM* memory, struct RAM_CELL* cell, struct RAM_VALUE value) {
+  char* old_heap = NULL;
+  if (cell->value.value_type == RAM_TYPE_STR && cell->value.types.s != cell->inline_str) {
+    old_heap = cell->value.types.s;
+  }
+
+  if (value.value_type == RAM_TYPE_STR && value.types.s != NULL) {
+    bool shared = ram_str_is_shared(value.types.s) || ram_arena_owns(memory, value.types.s);
+    size_t len = shared ? (size_t)ram_str_header(value.types.s)->length : strlen(value.types.s);
+
+    if (len <= RAM_INLINE_STR_MAX) {
+      if (__builtin_expect(memory->readers_enabled, 0)) {
+        ram_copy_str_relaxed(cell->inline_str, value.types.s, len + 1);
+      } else {
+        memmove(cell->inline_str, value.types.s, len + 1); // may overlap when x = x
+      }
+      RAM_STAT_COPIED(len + 1);
+      value.types.s = cell->inline_str;
+    } else {
+      value.types.s = ram_str_store(memory, value.types.s, shared, (int)len);
+    }
+  }
+
+  // word by word, since a concurrent reader may be loading them; the
+  // payload last, releasing the chars of a new string along with it
+  __atomic_store_n(&cell->value.value_type, value.value_type, __ATOMIC_RELAXED);
+  __atomic_store(&cell->value.types, &value.types, __ATOMIC_RELEASE);
+  if (old_heap != NULL) {
+    ram_str_unstore(memory, old_heap);
+  }
+}
+
+
+/* ram_cells_moved
+after realloc moves the cells array, inline strings still point into
+the old array. Re-points them at the inline buffer of their cell.
+
+parameters: struct RAM*, uintptr_t   // memory and old address of cells
+returns: nothing
+*/
+static void ram_cells_moved(struct RAM* memory, uintptr_t old_cells) {
+  for (int i = 0; i < memory->num_values; i++) {
+    struct RAM_CELL* cell = &memory->cells[i];
+    uintptr_t old_inline = old_cells + i * sizeof(struct RAM_CELL) + offsetof(struct RAM_CELL, inline_str);
+
+    if (cell->value.value_type == RAM_TYPE_STR && (uintptr_t)cell->value.types.s == old_inline) {
+      __atomic_store_n(&cell->value.types.s, (char*)cell->inline_str, __ATOMIC_RELAXED);
+    }
+  }
+}
+
+
+/* ram_box_encode, ram_box_decode
+ram_box and ram_unbox, static so the boxed layout's loads and stores
+inline them
+
+parameters: struct RAM_VALUE / uint64_t
+returns: uint64_t / struct RAM_VALUE
+*/
+static uint64_t ram_box_encode(struct RAM_VALUE value) {
+  if (value.value_type == RAM_TYPE_REAL) {
+    if (value.types.d != value.types.d) {
+      return RAM_BOX_NAN;  // every NaN is the one NaN, the others mean boxed
+    }
+
+    uint64_t bits;
+    memcpy(&bits, &value.types.d, sizeof(bits));
+    return bits;
+  }
+
+  uint64_t payload;
+  if (value.value_type == RAM_TYPE_STR) {
+    payload = (uint64_t)(uintptr_t)value.types.s;
+    assert((payload & ~RAM_BOX_PAYLOAD) == 0);  // user-space pointers fit in 48 bits
+  } else {
+    payload = (uint32_t)value.types.i;
+  }
+
+  return RAM_BOX_TAGGED | ((uint64_t)(value.value_type + 1) << 48) | payload;
+}
+
+static struct RAM_VALUE ram_box_decode(uint64_t box) {
+  struct RAM_VALUE value;
+  value.value_type = RAM_BOX_TYPE(box);
+
+  if (value.value_type == RAM_TYPE_REAL) {
+    memcpy(&value.types.d, &box, sizeof(value.types.d));
+  } else if (value.value_type == RAM_TYPE_STR) {
+    value.types.s = (char*)(uintptr_t)(box & RAM_BOX_PAYLOAD);
+  } else {
+    value.types.i = (int)(uint32_t)box;
+  }
+
+  return value;
+}
+
+
+/* ram_load
+returns the value at the given address as a RAM_VALUE, a string in it
+is borrowed from memory
+
+parameters: struct RAM*, int   // memory and a valid address
+returns: struct RAM_VALUE
+*/
+static struct RAM_VALUE ram_load(struct RAM* memory, int addr) {
+  if (memory->layout == RAM_LAYOUT_CELLS) {
+    return memory->cells[addr].value;
+  }
+  if (memory->layout == RAM_LAYOUT_BOXED) {
+    return ram_box_decode(memory->payloads[addr].box);
+  }
+
+  struct RAM_VALUE value;
+  value.value_type = memory->tags[addr];
+  if (value.value_type == RAM_TYPE_REAL) {
+    value.types.d = memory->payloads[addr].d;
+  } else if (value.value_type == RAM_TYPE_STR) {
+    value.types.s = memory->payloads[addr].s;
+  } else {
+    value.types.i = memory->payloads[addr].i;
+  }
+  return value;
+}
+
+
+/* ram_share_str_at
+returns a reference to the string at the given address for a copy
+handed out to a caller
+
+parameters: struct RAM*, int   // memory and address of a RAM_TYPE_STR
+returns: char*
+*/
+static char* ram_share_str_at(struct RAM* memory, int addr) {
+  if (memory->layout == RAM_LAYOUT_CELLS) {
+    return ram_cell_share_str(&memory->cells[addr]);
+  }
+
+  char* s = ram_load(memory, addr).types.s;
+  return (s == NULL) ? NULL : ram_str_retain(s);
+}
+
+
+/* ram_heap_str_at
+returns the shared string held at the given address, NULL if the value
+there is not a string on the heap (an inline string lives in its cell)
+
+parameters: struct RAM*, int   // memory and a valid address
+returns: char*
+*/
+static char* ram_heap_str_at(struct RAM* memory, int addr) {
+  if (memory->layout != RAM_LAYOUT_CELLS) {
+    struct RAM_VALUE value = ram_load(memory, addr);
+    return (value.value_type == RAM_TYPE_STR) ? value.types.s : NULL;
+  }
+
+  struct RAM_CELL* cell = &memory->cells[addr];
+  if (cell->value.value_type != RAM_TYPE_STR || cell->value.types.s == cell->inline_str) {
+    return NULL;
+  }
+  return cell->value.types.s;
+}
+
+
+/* ram_export_str_at
+like ram_share_str_at, for a copy leaving memory, see ram_str_export
+
+parameters: struct RAM*, int   // memory and address of a RAM_TYPE_STR
+returns: char*
+*/
+static char* ram_export_str_at(struct RAM* memory, int addr) {
+  char* s = ram_heap_str_at(memory, addr);
+
+  if (s != NULL && ram_str_in_arena(s)) {
+    ram_str_publish(memory, s);
+  }
+  return ram_share_str_at(memory, addr);
+}
+
+
+/* ram_mark_dirty
+sets the dirty bit of the cell at the given address and, the first
+time the cell is written in this epoch, logs the write for
+ram_changed_since
+
+parameters: struct RAM*, int   // memory and a valid address
+returns: nothing
+*/
+static void ram_mark_dirty(struct RAM* memory, int addr) {
+  unsigned long bit = 1UL << (addr % RAM_DIRTY_BITS);
+  unsigned long* word = &memory->dirty[addr / RAM_DIRTY_BITS];
+
+  if (*word & bit) {
+    return; // already written this epoch, already logged
+  }
+  *word |= bit;
+
+  if (memory->num_touches == memory->touches_capacity) {
+    int capacity = (memory->touches_capacity == 0) ? 16 : 2 * memory->touches_capacity;
+    struct RAM_TOUCH* touches = (struct RAM_TOUCH*)realloc(memory->touches, capacity * sizeof(struct RAM_TOUCH));
+    if (touches == NULL) {
+      //printf("ERROR: OUT OF MEMORY\n");
+      exit(1);
+    }
+    memory->touches = touches;
+    memory->touches_capacity = capacity;
+  }
+
+  memory->touches[memory->num_touches].address = addr;
+  memory->touches[memory->num_touches].epoch = memory->epoch;
+  memory->num_touches++;
+  memory->touched_epoch[addr] = memory->epoch;
+}
+
+
+/* ram_snapshot_copy_chunk
+gives the snapshot its own copy of chunk c, taken from the live memory
+as it is now (and so as it was when the snapshot was taken, since the
+chunk has not been written since). Strings are shared, an inline string
+is copied along with its cell.
+
+parameters: struct RAM_SNAPSHOT*, int   // snapshot and chunk #
+returns: nothing
+*/
+static void ram_snapshot_copy_chunk(struct RAM_SNAPSHOT* snapshot, int c) {
+  struct RAM* memory = snapshot->memory;
+  struct RAM_CELL* chunk = (struct RAM_CELL*)malloc(RAM_SNAPSHOT_CHUNK * sizeof(struct RAM_CELL));
+  if (chunk == NULL) {
+    //printf("ERROR: OUT OF MEMORY\n");
+    exit(1);
+  }
+
+  int first = c * RAM_SNAPSHOT_CHUNK;
+  for (int i = 0; i < RAM_SNAPSHOT_CHUNK; i++) {
+    int addr = first + i;
+    struct RAM_CELL* copy = &chunk[i];
+
+    if (addr >= snapshot->num_values) {
+      copy->identifier = NULL;
+      copy->value.value_type = RAM_TYPE_NONE;
+      continue;
+    }
+
+    copy->identifier = intern(ram_identifier_at(memory, addr));  // one more reference
+    copy->value = ram_load(memory, addr);
+
+    if (copy->value.value_type == RAM_TYPE_STR && copy->value.types.s != NULL) {
+      if (memory->layout == RAM_LAYOUT_CELLS && copy->value.types.s == memory->cells[addr].inline_str) {
+        strcpy(copy->inline_str, copy->value.types.s);
+        copy->value.types.s = copy->inline_str;
+      } else {
+        copy->value.types.s = ram_str_export(memory, copy->value.types.s);
+      }
+    }
+  }
+
+  snapshot->chunks[c] = chunk;
+}
+
+
+/* ram_snapshots_unshare
+called before the cell at addr is written: copies its chunk into every
+snapshot of the memory that still shares it
+
+parameters: struct RAM*, int   // memory and address about to be written
+returns: nothing
+*/
+static void ram_snapshots_unshare(struct RAM* memory, int addr) {
+  int c = addr / RAM_SNAPSHOT_CHUNK;
+
+  for (int k = 0; k < memory->num_snapshots; k++) {
+    struct RAM_SNAPSHOT* snapshot = memory->snapshots[k];
+
+    if (c < snapshot->num_chunks && snapshot->chunks[c] == NULL) {
+      ram_snapshot_copy_chunk(snapshot, c);
+    }
+  }
+}
+
+
+/* ram_retire
+hands something the writer dropped to the reclaimer instead of freeing
+it, since a concurrent reader may still be looking at it
+
+parameters: struct RAM*, void*, bool   // memory, array or shared string, is it a string?
+returns: nothing
+*/
+static void ram_retire(struct RAM* memory, void* ptr, bool is_str) {
+  if (memory->num_retired == memory->retired_capacity) {
+    int capacity = (memory->retired_capacity == 0) ? 16 : 2 * memory->retired_capacity;
+    struct RAM_RETIRED* retired = (struct RAM_RETIRED*)realloc(memory->retired, capacity * sizeof(struct RAM_RETIRED));
+    if (retired == NULL) {
+      //printf("ERROR: OUT OF MEMORY\n");
+      exit(1);
+    }
+    memory->retired = retired;
+    memory->retired_capacity = capacity;
+  }
+
+  memory->retired[memory->num_retired].ptr = ptr;
+  memory->retired[memory->num_retired].is_str = is_str;
+  memory->num_retired++;
+}
+
+
+/* ram_reclaim
+frees what was retired, once no reader is inside a read. A reader that
+starts after the check only ever finds the new arrays and strings, the
+ones retired were unlinked before it.
+
+parameters: struct RAM*
+returns: nothing
+*/
+static void ram_reclaim(struct RAM* memory) {
+  if (memory->num_retired == 0) {
+    return;
+  }
+
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);  // unlinking happens before the check
+  if (__atomic_load_n(&memory->readers, __ATOMIC_SEQ_CST) != 0) {
+    return;  // try again after a later write
+  }
+
+  for (int i = 0; i < memory->num_retired; i++) {
+    if (memory->retired[i].is_str) {
+      ram_str_drop(memory, (char*)memory->retired[i].ptr);
+    } else {
+      free(memory->retired[i].ptr);
+    }
+  }
+  memory->num_retired = 0;
+}
+
+
+/* ram_resize
+realloc for the arrays concurrent readers look at: while readers are
+enabled the old array is retired rather than freed, so a reader still
+holding it can finish
+
+parameters: struct RAM*, void*, size_t, size_t   // memory, array, its size and new size in bytes
+returns: void*   // the new array, NULL if out of memory (the old one is then untouched)
+*/
+static void* ram_resize(struct RAM* memory, void* ptr, size_t old_size, size_t size) {
+  if (!memory->readers_enabled) {
+    return realloc(ptr, size);
+  }
+
+  void* copy = malloc(size);
+  if (copy == NULL) {
+    return NULL;
+  }
+  memcpy(copy, ptr, old_size < size ? old_size : size);
+  ram_retire(memory, ptr, false);
+
+  return copy;
+}
+
+
+/* ram_shape_begin, ram_shape_end
+bracket a change concurrent readers must not see halfway: cells being
+moved, or a cell removed. Readers retry while shape is odd or changed.
+
+parameters: struct RAM*
+returns: nothing
+*/
+static void ram_shape_begin(struct RAM* memory) {
+  if (memory->readers_enabled) {
+    __atomic_store_n(&memory->shape, memory->shape + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+  }
+}
+
+static void ram_shape_end(struct RAM* memory) {
+  if (memory->readers_enabled) {
+    __atomic_store_n(&memory->shape, memory->shape + 1, __ATOMIC_RELEASE);
+    ram_reclaim(memory);
+  }
+}
+
+
+/* ram_seq_begin, ram_seq_end
+bracket a write while concurrent readers are enabled: the cell's
+sequence # is odd during the write, so a reader that overlaps it
+retries, and the string the write replaces (if any) is kept alive
+until no reader can still be copying it
+
+parameters: struct RAM*, int (, char*)   // memory, address (, what ram_seq_begin returned)
+returns: char*   // ram_seq_begin: the string being replaced, or NULL
+*/
+static char* ram_seq_begin(struct RAM* memory, int addr) {
+  char* old_str = ram_heap_str_at(memory, addr);
+  if (old_str != NULL) {
+    ram_str_retain(old_str);  // released by ram_reclaim instead
+  }
+
+  unsigned int* seq = &memory->seqs[addr];
+  __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  return old_str;
+}
+
+static void ram_seq_end(struct RAM* memory, int addr, char* old_str) {
+  unsigned int* seq = &memory->seqs[addr];
+  __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+
+  if (old_str != NULL) {
+    ram_retire(memory, old_str, true);
+  }
+  ram_reclaim(memory);
+}
+
+
+/* ram_store
+stores a value at the given address. In the cells layout this is
+ram_cell_store; in the SoA and boxed layouts every string is a RAM_STR
+(there is no inline buffer), and the old one is dropped after the new
+one is stored, just like ram_cell_store.
+
+parameters: struct RAM*, int, struct RAM_VALUE
+returns: nothing
+*/
+static void ram_store(struct RAM* memory, int addr, struct RAM_VALUE value) {
+  RAM_STAT(memory, addr, writes);
+  if (memory->num_snapshots != 0) {
+    ram_snapshots_unshare(memory, addr);  // copy-on-write
+  }
+  ram_mark_dirty(memory, addr);
+
+  char* retiring = NULL;
+  if (__builtin_expect(memory->readers_enabled, 0)) {
+    retiring = ram_seq_begin(memory, addr);
+  }
+
+  if (memory->layout == RAM_LAYOUT_CELLS) {
+    ram_cell_store(memory, &memory->cells[addr], value);
+  } else {
+    char* old_str = ram_heap_str_at(memory, addr);
+
+    if (value.value_type == RAM_TYPE_STR && value.types.s != NULL) {
+      char* s = value.types.s;
+      bool shared = ram_str_is_shared(s) || ram_arena_owns(memory, s);
+      value.types.s = ram_str_store(memory, s, shared, shared ? ram_str_header(s)->length : (int)strlen(s));
+    }
+
+    // whole words, since a concurrent reader may be loading them; the
+    // payload releases the chars of a new string along with it
+    if (memory->layout == RAM_LAYOUT_BOXED) {
+      __atomic_store_n(&memory->payloads[addr].box, ram_box_encode(value), __ATOMIC_RELEASE);
+    } else {
+      union RAM_PAYLOAD payload;
+      payload.box = 0;
+      if (value.value_type == RAM_TYPE_REAL) {
+        payload.d = value.types.d;
+      } else if (value.value_type == RAM_TYPE_STR) {
+        payload.s = value.types.s;
+      } else {
+        payload.i = value.types.i;
+      }
+      __atomic_store_n(&memory->tags[addr], (unsigned char)value.value_type, __ATOMIC_RELAXED);
+      __atomic_store(&memory->payloads[addr], &payload, __ATOMIC_RELEASE);
+    }
+
+    if (old_str != NULL) {
+      ram_str_unstore(memory, old_str);
+    }
+  }
+  RAM_STAT_CHARGE(memory, addr);
+
+  if (__builtin_expect(memory->readers_enabled, 0)) {
+    ram_seq_end(memory, addr, retiring);
+  }
+}
+
+
+/* ram_index_rebuild
+allocates an index with the given # of slots and re-inserts every
+cell. The addresses themselves do not change, only the slots do.
+
+parameters: struct RAM*, int   // memory and new # of slots (power of 2)
+returns: bool                  // false if out of memory
+*/
+static bool ram_index_rebuild(struct RAM* memory, int index_capacity) {
+  int* index = (int*)malloc(index_capacity * sizeof(int));
+  if (index == NULL) {
+    return false;
+  }
+
+  for (int i = 0; i < index_capacity; i++) {
+    index[i] = -1; // all slots start empty
+  }
+
+  free(memory->index);
+  memory->index = index;
+  memory->index_capacity = index_capacity;
+  memory->index_base = 0;
+
+  for (int addr = 0; addr < memory->num_values; addr++) {
+    int slot = ram_index_probe(memory, ram_identifier_at(memory, addr));
+    memory->index[slot] = addr;
+  }
+
+  return true;
+}
+
+
+
+/* ram_index_size
+returns the # of index slots for the given capacity: the smallest power
+of 2 that is at least twice the capacity, so the index is never more
+than half full
+
+parameters: int   // capacity
+returns: int
+*/
+static int ram_index_size(int capacity) {
+  int size = 8;
+  while (size < 2 * capacity) {
+    size *= 2;
+  }
+  return size;
+}
+
+
+/* ram_dirty_grow
+grows the dirty bits and the per-address epochs from old_capacity
+to capacity addresses (from nothing when old_capacity is 0); the new
+addresses start clean and never written
+
+parameters: struct RAM*, int, int   // memory, old and new capacity
+returns: bool                       // false if out of memory
+*/
+static bool ram_dirty_grow(struct RAM* memory, int old_capacity, int capacity) {
+  int old_words = (old_capacity + RAM_DIRTY_BITS - 1) / RAM_DIRTY_BITS;
+  int words = (capacity + RAM_DIRTY_BITS - 1) / RAM_DIRTY_BITS;
+
+  unsigned long* dirty = (unsigned long*)realloc(memory->dirty, words * sizeof(unsigned long));
+  if (dirty == NULL) {
+    return false;
+  }
+  memset(dirty + old_words, 0, (words - old_words) * sizeof(unsigned long));
+  memory->dirty = dirty;
+
+  int* touched_epoch = (int*)realloc(memory->touched_epoch, capacity * sizeof(int));
+  if (touched_epoch == NULL) {
+    return false;
+  }
+  for (int i = old_capacity; i < capacity; i++) {
+    touched_epoch[i] = -1;
+  }
+  memory->touched_epoch = touched_epoch;
+
+  return true;
+}
+
+
+/* ram_grow
+doubles the capacity of memory, in whichever layout it uses, and grows
+the hash index with it so the index stays at most half full
+
+parameters: struct RAM*
+returns: bool   // false if out of memory
+*/
+static bool ram_grow(struct RAM* memory) {
+  int old_capacity = memory->capacity;
+  int capacity = 2 * memory->capacity;
+
+  if (memory->layout == RAM_LAYOUT_SOA) {
+    unsigned char* tags = (unsigned char*)ram_resize(memory, memory->tags, old_capacity * sizeof(unsigned char), capacity * sizeof(unsigned char));
+    if (tags == NULL) {
+      return false;
+    }
+    __atomic_store_n(&memory->tags, tags, __ATOMIC_RELEASE);
+  }
+
+  if (memory->layout != RAM_LAYOUT_CELLS) {
+    union RAM_PAYLOAD* payloads = (union RAM_PAYLOAD*)ram_resize(memory, memory->payloads, old_capacity * sizeof(union RAM_PAYLOAD), capacity * sizeof(union RAM_PAYLOAD));
+    if (payloads == NULL) {
+      return false;
+    }
+    __atomic_store_n(&memory->payloads, payloads, __ATOMIC_RELEASE);
+
+    char** identifiers = (char**)ram_resize(memory, memory->identifiers, old_capacity * sizeof(char*), capacity * sizeof(char*));
+    if (identifiers == NULL) {
+      return false;
+    }
+    __atomic_store_n(&memory->identifiers, identifiers, __ATOMIC_RELEASE);
+  } else {
+    uintptr_t old_cells = (uintptr_t)memory->cells;
+    struct RAM_CELL* cells = (struct RAM_CELL*)ram_resize(memory, memory->cells, old_capacity * sizeof(struct RAM_CELL), capacity * sizeof(struct RAM_CELL));
+    if (cells == NULL) { // memory allocation failed
+      return false;
+    }
+    __atomic_store_n(&memory->cells, cells, __ATOMIC_RELEASE);
+
+    // inline strings moved with their cells
+    ram_cells_moved(memory, old_cells);
+  }
+
+  if (memory->readers_enabled) {
+    unsigned int* seqs = (unsigned int*)ram_resize(memory, memory->seqs, old_capacity * sizeof(unsigned int), capacity * sizeof(unsigned int));
+    if (seqs == NULL) {
+      return false;
+    }
+    memset(seqs + old_capacity, 0, (capacity - old_capacity) * sizeof(unsigned int));
+    __atomic_store_n(&memory->seqs, seqs, __ATOMIC_RELEASE);
+  }
+
+  if (!ram_dirty_grow(memory, memory->capacity, capacity)) {
+    return false;
+  }
+
+#ifdef RAM_STATS
+  struct RAM_CELL_STATS* stats = (struct RAM_CELL_STATS*)realloc(memory->stats, capacity * sizeof(struct RAM_CELL_STATS));
+  if (stats == NULL) {
+    return false;
+  }
+  memset(stats + memory->capacity, 0, (capacity - memory->capacity) * sizeof(struct RAM_CELL_STATS));
+  memory->stats = stats;
+#endif
+
+  memory->capacity = capacity;
+
+  return ram_index_rebuild(memory, ram_index_size(memory->capacity));
+}
+
+
+/* ram_call_hooks
+calls the write hooks registered for the given address (and the ones
+for every address) after a write
+
+parameters: struct RAM*, int   // memory and the address just written
+returns: nothing
+*/
+static void ram_call_hooks(struct RAM* memory, int address) {
+  for (int i = 0; i < memory->num_hooks; i++) {
+    struct RAM_HOOK* hook = &memory->hooks[i];
+
+    if (hook->address == -1 || hook->address == address) {
+      hook->fn(memory, address, ram_peek_cell_by_addr(memory, address), hook->context);
+    }
+  }
+}
+
+
+/* ram_store_hooked
+ram_store followed by the write hooks. Kept apart from ram_store so a
+write with no hooks registered only pays for the check, and not for
+the bookkeeping needed to call the hooks after storing
+
+parameters: struct RAM*, int, struct RAM_VALUE
+returns: nothing
+*/
+static void ram_store_hooked(struct RAM* memory, int addr, struct RAM_VALUE value) {
+  ram_store(memory, addr, value);
+  ram_call_hooks(memory, addr);
+}
+
+
+/* ram_journal
+records the current value at the given address in the undo journal,
+before a write overwrites it (or, if created, that the write about to
+happen creates the cell). Only called while a transaction is open.
+
+parameters: struct RAM*, int, bool   // memory, address, created?
+returns: nothing
+*/
+static void ram_journal(struct RAM* memory, int addr, bool created) {
+  if (memory->journal_length == memory->journal_capacity) {
+    int capacity = (memory->journal_capacity == 0) ? 16 : 2 * memory->journal_capacity;
+    struct RAM_UNDO* journal = (struct RAM_UNDO*)realloc(memory->journal, capacity * sizeof(struct RAM_UNDO));
+    if (journal == NULL) {
+      //printf("ERROR: OUT OF MEMORY\n");
+      exit(1);
+    }
+    memory->journal = journal;
+    memory->journal_capacity = capacity;
+  }
+
+  struct RAM_UNDO* undo = &memory->journal[memory->journal_length];
+  undo->address = addr;
+  undo->created = created;
+  undo->old.value_type = RAM_TYPE_NONE;
+
+  if (!created) {
+    // keep a reference to the old string rather than a copy, only an
+    // inline string has to be copied out of the cell
+    undo->old = ram_load(memory, addr);
+    if (undo->old.value_type == RAM_TYPE_STR) {
+      undo->old.types.s = ram_share_str_at(memory, addr);
+    }
+  }
+
+  memory->journal_length++;
+}
+
+
+/* ram_undo_forget
+drops journal entries from the end back to the given length, releasing
+the strings they hold
+
+parameters: struct RAM*, int   // memory and new journal length
+returns: nothing
+*/
+static void ram_undo_forget(struct RAM* memory, int length) {
+  while (memory->journal_length > length) {
+    memory->journal_length--;
+
+    struct RAM_UNDO* undo = &memory->journal[memory->journal_length];
+    if (undo->old.value_type == RAM_TYPE_STR && undo->old.types.s != NULL) {
+      ram_str_drop(memory, undo->old.types.s);
+    }
+  }
+}
+
+
+/* ram_index_remove
+removes the identifier of the cell at addr from the hash index, using
+backward-shift deletion so linear probing never needs tombstones
+
+parameters: struct RAM*, int   // memory and address of the cell
+returns: nothing
+*/
+static void ram_index_remove(struct RAM* memory, int addr) {
+  int mask = memory->index_capacity - 1;
+  int hole = ram_index_probe(memory, ram_identifier_at(memory, addr));
+  memory->index[hole] = -1;
+
+  int next = (hole + 1) & mask;
+  int moved;
+  while ((moved = ram_index_addr(memory, next)) != -1) {
+    int home = (int)(ram_hash(ram_identifier_at(memory, moved)) & (unsigned int)mask);
+
+    // the entry at next can move back into the hole unless its home
+    // slot is cyclically inside (hole, next]
+    bool stays = (hole <= next) ? (hole < home && home <= next)
+                                : (hole < home || home <= next);
+    if (!stays) {
+      memory->index[hole] = memory->index[next];
+      memory->index[next] = -1;
+      hole = next;
+    }
+    next = (next + 1) & mask;
+  }
+}
+
+
+/* ram_release_cells
+lets go of the shared strings from outside the arena the cells hold
+(arena strings go with the arena, and names stay in the intern pool
+while the memory lives), so nothing is done per cell unless there are
+any
+
+parameters: struct RAM*
+returns: nothing
+*/
+static void ram_release_cells(struct RAM* memory) {
+  for (int i = 0; i < memory->num_values && memory->num_foreign_strs > 0; i++) {
+    char* s = ram_heap_str_at(memory, i);
+    if (s != NULL && !ram_str_in_arena(s)) {
+      ram_str_release(s);
+      memory->num_foreign_strs--;
+    }
+  }
+}
+
+
+/* ram_uncreate
+removes the last cell again, undoing the write that created it
+
+parameters: struct RAM*, int   // memory and address of the last cell
+returns: nothing
+*/
+static void ram_uncreate(struct RAM* memory, int addr) {
+  assert(addr == memory->num_values - 1);  // undone newest first
+  ram_shape_begin(memory);
+
+  // Step 1: drop its value, releasing a shared string
+  struct RAM_VALUE none;
+  none.value_type = RAM_TYPE_NONE;
+  none.types.i = 0;
+  ram_store(memory, addr, none);
+
+  // Step 2: forget its name. Its dirty bit and log entry stay, so
+  // writing it again this epoch is not logged twice; ram_changed_since
+  // skips addresses past the last cell. The name stays in the intern
+  // pool, concurrent readers only compare the pointer
+  ram_index_remove(memory, addr);
+  if (memory->layout != RAM_LAYOUT_CELLS) {
+    __atomic_store_n(&memory->identifiers[addr], (char*)NULL, __ATOMIC_RELAXED);
+  } else {
+    __atomic_store_n(&memory->cells[addr].identifier, (char*)NULL, __ATOMIC_RELAXED);
+  }
+
+  __atomic_store_n(&memory->num_values, memory->num_values - 1, __ATOMIC_RELAXED);
+  ram_shape_end(memory);
+}
+
+
+/* ram_create
+allocates a memory with the given layout and room for capacity values,
+every cell None and an empty hash index
+
+parameters: int, int   // layout (enum RAM_LAYOUTS) and capacity, >= 1
+returns: struct RAM*   // NULL if out of memory
+*/
+static struct RAM* ram_create(int layout, int capacity) {
+  // Step 1: Allocate memory for the RAM structure
+  struct RAM* memory = (struct RAM*) malloc(sizeof(struct RAM));
+  if (memory == NULL) {
+    //printf("ERROR: allocation failed and NULL was returned\n");
+    return NULL;
+  }
+  
+  // Step 2: Allocate memory for the values and set the intial capacity.
+  // cells is a dynamically allocated array of RAM_CELL struct objects,
+  // the SoA layout allocates its three arrays instead, the boxed
+  // layout the same minus the tags
+  memory->layout = layout;
+  memory->cells = NULL;
+  memory->tags = NULL;
+  memory->payloads = NULL;
+  memory->identifiers = NULL;
+
+  if (layout != RAM_LAYOUT_CELLS) {
+    if (layout == RAM_LAYOUT_SOA) {
+      memory->tags = (unsigned char*) malloc(capacity * sizeof(unsigned char));
+    }
+    memory->payloads = (union RAM_PAYLOAD*) malloc(capacity * sizeof(union RAM_PAYLOAD));
+    memory->identifiers = (char**) malloc(capacity * sizeof(char*));
+    if ((layout == RAM_LAYOUT_SOA && memory->tags == NULL) || memory->payloads == NULL || memory->identifiers == NULL) {
+      free(memory->tags);
+      free(memory->payloads);
+      free(memory->identifiers);
+      free(memory);
+      return NULL;
+    }
+  } else {
+    memory->cells = (struct RAM_CELL*) malloc(capacity * sizeof(struct RAM_CELL));
+    if (memory-> cells == NULL) {
+      //printf("RAM freed because cell allocation failed and NULL is returned\n");
+      free(memory);
+      return NULL;
+    }
+  }
+
+  // Step 3: Initialize num_values to 0 and set the capacity
+  // each ram_cell struct has an identifier and a ram_value
+  memory -> num_values = 0;
+  memory -> capacity = capacity;
+
+  // Step 3.5: build an empty hash index at least twice the size of the capacity
+  memory->slot_addrs = NULL;
+  memory->num_slot_addrs = 0;
+  memory->index = NULL;
+  if (!ram_index_rebuild(memory, ram_index_size(memory->capacity))) {
+    free(memory->cells);
+    free(memory->tags);
+    free(memory->payloads);
+    free(memory->identifiers);
+    free(memory);
+    return NULL;
+  }
+
+  // Step 4: Initialize each cell’s identifier to NULL and set value type to RAM_TYPE_NONE
+  struct RAM_VALUE none;
+  none.value_type = RAM_TYPE_NONE;
+  none.types.i = 0;
+  for (int i = 0; i < capacity; i++) {
+    if (layout == RAM_LAYOUT_SOA) {
+      memory->identifiers[i] = NULL;
+      memory->tags[i] = RAM_TYPE_NONE;
+    } else if (layout == RAM_LAYOUT_BOXED) {
+      memory->identifiers[i] = NULL;
+      memory->payloads[i].box = ram_box_encode(none);
+    } else {
+      memory->cells[i].identifier = NULL;
+      memory->cells[i].value.value_type = RAM_TYPE_NONE;
+    }
+  }
+  memory->peeked.value_type = RAM_TYPE_NONE;
+
+  // Step 5: no write hooks yet
+  memory->hooks = NULL;
+  memory->num_hooks = 0;
+  memory->hooks_capacity = 0;
+  memory->next_hook_id = 0;
+
+  // Step 6: no transaction open
+  memory->journal = NULL;
+  memory->journal_length = 0;
+  memory->journal_capacity = 0;
+  memory->marks = NULL;
+  memory->num_marks = 0;
+  memory->marks_capacity = 0;
+
+  // Step 6.5: no snapshots
+  memory->snapshots = NULL;
+  memory->num_snapshots = 0;
+  memory->snapshots_capacity = 0;
+
+  // Step 6.75: no concurrent readers until ram_readers_enable
+  memory->readers_enabled = false;
+  memory->seqs = NULL;
+  memory->shape = 0;
+  memory->readers = 0;
+  memory->retired = NULL;
+  memory->num_retired = 0;
+  memory->retired_capacity = 0;
+
+  // Step 6.875: an empty string arena, chunks come with the first string
+  memory->arena_chunks = NULL;
+  memory->num_arena_chunks = 0;
+  memory->arena_chunks_capacity = 0;
+  memory->arena_top = NULL;
+  for (int c = 0; c < RAM_ARENA_CLASSES; c++) {
+    memory->arena_free[c] = NULL;
+  }
+  memory->arena_live_bytes = 0;
+  memory->arena_free_bytes = 0;
+  memory->num_foreign_strs = 0;
+
+  // Step 6.9375: the cells' names stay in the intern pool while the
+  // memory lives, so resetting or destroying it never touches the pool
+  intern_hold();
+
+  // Step 7: every cell clean, in epoch 0
+  memory->dirty = NULL;
+  memory->touched_epoch = NULL;
+  memory->touches = NULL;
+  memory->num_touches = 0;
+  memory->touches_capacity = 0;
+  memory->epoch = 0;
+  memory->stats = NULL;
+  if (!ram_dirty_grow(memory, 0, capacity)) {
+    ram_destroy(memory);
+    return NULL;
+  }
+
+  // Step 8: zeroed access statistics, if they are compiled in
+#ifdef RAM_STATS
+  memory->stats = (struct RAM_CELL_STATS*) calloc(capacity, sizeof(struct RAM_CELL_STATS));
+  if (memory->stats == NULL) {
+    ram_destroy(memory);
+    return NULL;
+  }
+#endif
+
+  return memory;
+}
+
+
+
+//
+// Public functions:
+//
+
+//
+// ram_init
+//
+// Returns a pointer to a dynamically-allocated memory
+// for storing nuPython variables and their values. All
+// memory cells are initialized to the value None.
+//
+struct RAM* ram_init(void)
+{
+  return ram_create(RAM_LAYOUT_CELLS, 4);
+}
+
+
+//
+// ram_init_layout
+//
+// Like ram_init, but stores the values using the given layout
+// (enum RAM_LAYOUTS). Returns NULL if the layout is unknown.
+//
+struct RAM* ram_init_layout(int layout)
+{
+  if (layout != RAM_LAYOUT_CELLS && layout != RAM_LAYOUT_SOA && layout != RAM_LAYOUT_BOXED) {
+    return NULL;
+  }
+
+  return ram_create(layout, 4);
+}
+
+
+//
+// ram_box
+//
+// Returns the given value packed into one 64-bit word, the way
+// RAM_LAYOUT_BOXED stores it. A string is not copied.
+//
+uint64_t ram_box(struct RAM_VALUE value)
+{
+  return ram_box_encode(value);
+}
+
+
+//
+// ram_unbox
+//
+// Returns the value packed into the given word by ram_box.
+//
+struct RAM_VALUE ram_unbox(uint64_t box)
+{
+  return ram_box_decode(box);
+}
+
+
+//
+// ram_init_with_capacity
+//
+// Like ram_init, but with room for the given # of values
+// (never less than the 4 of ram_init) before memory has to
+// grow.
+//
+struct RAM* ram_init_with_capacity(int capacity)
+{
+  if (capacity < 4) {
+    capacity = 4;
+  }
+
+  return ram_create(RAM_LAYOUT_CELLS, capacity);
+}
+
+
+/* ram_snapshots_detach
+gives every snapshot of memory its own copy of the chunks it still
+shares, and cuts it loose from memory
+
+parameters: struct RAM*
+returns: nothing
+*/
+static void ram_snapshots_detach(struct RAM* memory) {
+  for (int k = 0; k < memory->num_snapshots; k++) {
+    struct RAM_SNAPSHOT* snapshot = memory->snapshots[k];
+
+    for (int c = 0; c < snapshot->num_chunks; c++) {
+      if (snapshot->chunks[c] == NULL) {
+        ram_snapshot_copy_chunk(snapshot, c);
+      }
+    }
+    snapshot->memory = NULL;
+  }
+  memory->num_snapshots = 0;
+}
+
+
+//
+// ram_destroy
+//
+// Frees the dynamically-allocated memory associated with
+// the given memory. After the call returns, you cannot
+// use the memory.
+//
+void ram_destroy(struct RAM* memory)
+{
+  if (memory == NULL) {
+    return;  // there is nothing to destroy if memory is NULL
+  }
+
+  // Step 0: snapshots outlive the memory, so they take their own copy
+  // of every chunk they still share
+  ram_snapshots_detach(memory);
+  free(memory->snapshots);
+
+  // Step 0.5: every reader has stopped by now, whatever they held up can go
+  ram_readers_disable(memory);
+
+  // Step 1: Free each cell's value. Strings in the arena go with it in
+  // Step 2, and names stay in the intern pool until Step 3
+  ram_release_cells(memory);
+
+  // Step 2: Free the cells (or SoA arrays) and the hash index
+  free(memory->cells);
+  free(memory->tags);
+  free(memory->payloads);
+  free(memory->identifiers);
+  free(memory->index);
+  free(memory->slot_addrs);
+  free(memory->hooks);
+  ram_undo_forget(memory, 0);  // releases journaled strings
+  free(memory->journal);
+  ram_arena_free(memory->arena_chunks, memory->num_arena_chunks);  // after the journal, it may hold arena strings
+  free(memory->marks);
+  free(memory->stats);
+  free(memory->dirty);
+  free(memory->touched_epoch);
+  free(memory->touches);
+
+  // Step 3: Free the RAM structure, and let go of its names: the last
+  // memory to go takes every name nothing else uses out of the pool
+  free(memory);
+  intern_unhold();
+  return;
+}
+
+
+//
+// ram_reset
+//
+// Empties the memory so it can be used again as if it had just
+// been created, keeping what it has allocated. Nothing is done
+// per cell unless cells hold strings from outside the arena.
+//
+void ram_reset(struct RAM* memory)
+{
+  if (memory == NULL) {
+    return;
+  }
+
+  // Step 1: as in ram_destroy, snapshots and readers let go first
+  ram_snapshots_detach(memory);
+  ram_readers_disable(memory);
+
+  // Step 2: drop any open transaction, releasing journaled strings
+  ram_undo_forget(memory, 0);
+  memory->num_marks = 0;
+
+  // Step 3: release the strings the arena doesn't own. The names stay
+  // in the intern pool, the memory will likely use them again
+  ram_release_cells(memory);
+
+  // Step 4: empty the arena, keeping the chunk on top for the next
+  // run's strings (unless published strings still use it) and letting
+  // go of any others
+  if (memory->arena_top != NULL && __atomic_load_n(&memory->arena_top->refs, __ATOMIC_ACQUIRE) != 1) {
+    memory->arena_top = NULL;
+  }
+  for (int i = 0; i < memory->num_arena_chunks; i++) {
+    if (memory->arena_chunks[i] != memory->arena_top) {
+      ram_arena_chunk_release(memory->arena_chunks[i]);
+    }
+  }
+  memory->num_arena_chunks = 0;
+  if (memory->arena_top != NULL) {
+    memory->arena_top->used = 0;
+    memory->arena_chunks[0] = memory->arena_top;
+    memory->num_arena_chunks = 1;
+  }
+  for (int c = 0; c < RAM_ARENA_CLASSES; c++) {
+    memory->arena_free[c] = NULL;
+  }
+  memory->arena_live_bytes = 0;
+  memory->arena_free_bytes = 0;
+  memory->num_foreign_strs = 0;
+
+  // Step 5: every slot of the index holds less than the new base, so
+  // they all read as empty. Only when the base would overflow is the
+  // index cleared for real, which amortizes to O(1) per reset
+  if (memory->capacity > (INT_MAX - memory->index_base) / 2) {
+    for (int i = 0; i < memory->index_capacity; i++) {
+      memory->index[i] = -1;
+    }
+    memory->index_base = 0;
+  } else {
+    memory->index_base += memory->capacity;
+  }
+
+  // Step 6: clear the dirty bits of this epoch (earlier epochs have
+  // been cleared already) and start a new one, so the epochs cells
+  // were last written in are all in the past
+  ram_next_epoch(memory);
+  memory->num_touches = 0;
+
+  // Step 7: no hooks, no values
+  memory->num_hooks = 0;
+  memory->num_values = 0;
+  memory->peeked.value_type = RAM_TYPE_NONE;
+
+#ifdef RAM_STATS
+  memset(memory->stats, 0, memory->capacity * sizeof(struct RAM_CELL_STATS));
+#endif
+}
+
+
+//
+// ram_get_addr
+// 
+// If the given identifier (e.g. "x") has been written to 
+// memory, returns the address of this value --- an integer
+// in the range 0..N-1 where N is the number of values currently 
+// stored in memory. Returns -1 if no such identifier exists 
+// in memory. 
+// 
+// NOTE: a variable has to be written to memory before you can
+// get its address. Once a variable is written to memory, its
+// address never changes.
+//
+int ram_get_addr(struct RAM* memory, char* identifier)
+{
+  // Step 1: find the interned copy of the name. A name that was never
+  // interned can't have been written to any memory
+  char* interned = intern_find(identifier);
+  if (interned == NULL) {
+    return -1;
+  }
+
+  // Step 2: look the identifier up in the hash index, the slot holds
+  // the cell's address or -1 if the identifier was never written
+  int slot = ram_index_probe(memory, interned);
+  int address = ram_index_addr(memory, slot);
+
+  if (address != -1) {
+    RAM_STAT(memory, address, lookups);
+  }
+
+  return address;
+}
+
+
+//
+// ram_get_addr_by_slot
+//
+// ram_get_addr for an interned identifier the caller knows by slot #:
+// the address is remembered per slot, and checked against the cell's
+// identifier before it is trusted again.
+//
+int ram_get_addr_by_slot(struct RAM* memory, int slot, char* identifier)
+{
+  if (slot < 0 || identifier == NULL) {
+    return -1;
+  }
+
+  // Step 1: the address remembered for the slot, if its cell still
+  // holds the identifier (a rollback may have removed it since)
+  if (slot < memory->num_slot_addrs) {
+    int address = memory->slot_addrs[slot];
+
+    if (address >= 0 && address < memory->num_values && ram_identifier_at(memory, address) == identifier) {
+      return address;
+    }
+  }
+
+  // Step 2: look it up in the hash index, the identifier is interned
+  int address = ram_index_addr(memory, ram_index_probe(memory, identifier));
+  if (address == -1) {
+    return -1;
+  }
+  RAM_STAT(memory, address, lookups);
+
+  // Step 3: remember it, growing the table to cover the slot
+  if (slot >= memory->num_slot_addrs) {
+    int n = (memory->num_slot_addrs == 0) ? 16 : memory->num_slot_addrs;
+    while (n <= slot) {
+      n *= 2;
+    }
+
+    int* grown = (int*)realloc(memory->slot_addrs, n * sizeof(int));
+    if (grown == NULL) {
+      return address; // found, just not remembered
+    }
+    for (int i = memory->num_slot_addrs; i < n; i++) {
+      grown[i] = -1;
+    }
+    memory->slot_addrs = grown;
+    memory->num_slot_addrs = n;
+  }
+  memory->slot_addrs[slot] = address;
+
+  return address;
+}
+
+
+//
+// ram_read_cell_by_addr
+//
+// Given a memory address (an integer in the range 0..N-1), 
+// returns a COPY of the value contained in that memory cell.
+// Returns NULL if the address is not valid.
+//
+// NOTE: this function allocates memory for the value that
+// is returned. The caller takes ownership of the copy and 
+// must eventually free this memory via ram_free_value().
+//
+// NOTE: a variable has to be written to memory before its
+// address becomes valid. Once a variable is written to memory,
+// its address never changes.
+//
+struct RAM_VALUE* ram_read_cell_by_addr(struct RAM* memory, int address)
+{
+  //Step 1: make sure address is valid
+  if (address < 0 || address >= memory->num_values) {
+    //printf("this is a invalid address and NULL was returned\n");;
+    return NULL; // invalid address
+  }
+
+  // Step 2: Allocate memory for copy of RAM_VALUE
+  struct RAM_VALUE* copy = (struct RAM_VALUE*)malloc(sizeof(struct RAM_VALUE));
+  if (copy == NULL) {
+    //printf("ERROR: OUT OF MEMORY\n");
+    return NULL;
+  }
+
+  // Step 3: Copy the value type and the actual data
+  *copy = ram_load(memory, address);
+
+  // Step 4: Share the string, the copy holds a reference
+  if (copy->value_type == RAM_TYPE_STR) {
+    copy->types.s = ram_export_str_at(memory, address);
+  }
+
+  RAM_STAT(memory, address, reads);
+  RAM_STAT_CHARGE(memory, address);
+
+  return copy;
+}
+
+
+// 
+// ram_read_cell_by_name
+//
+// If the given name (e.g. "x") has been written to 
+// memory, returns a COPY of the value contained in memory.
+// Returns NULL if no such name exists in memory.
+//
+// NOTE: this function allocates memory for the value that
+// is returned. The caller takes ownership of the copy and 
+// must eventually free this memory via ram_free_value().
+//
+struct RAM_VALUE* ram_read_cell_by_name(struct RAM* memory, char* name)
+{
+  // Step 1: find he address of the variable by name
+  int addr = ram_get_addr(memory, name);
+  if (addr == -1) { // variable was not found
+    //printf("variable was not found and NULL was returned");
+    return NULL;
+  }
+
+  //Step 2: allocate memory for the copy of RAM_VALUE
+  struct RAM_VALUE* copy = (struct RAM_VALUE*)malloc(sizeof(struct RAM_VALUE));
+  if (copy == NULL) {
+    //printf("ERROR: OUT OF MEMORY\n");
+    return NULL;
+  }
+
+  // Step 3: copy the value type and the data
+  *copy = ram_load(memory, addr);
+
+  // step 4: share the string, the copy holds a reference
+  if (copy->value_type == RAM_TYPE_STR) {
+    copy->types.s = ram_export_str_at(memory, addr);
+  }
+
+  RAM_STAT(memory, addr, reads);
+  RAM_STAT_CHARGE(memory, addr);
+
+  return copy;
+}
+
+
+//
+// ram_peek_cell_by_addr
+//
+// Given a memory address (an integer in the range 0..N-1),
+// returns a pointer to the value stored in that memory cell
+// WITHOUT making a copy. Returns NULL if the address is not valid.
+//
+// NOTE: the value is borrowed, the caller must not modify or
+// free it. The pointer is valid until the next write to memory.
+//
+const struct RAM_VALUE* ram_peek_cell_by_addr(struct RAM* memory, int address)
+{
+  // Step 1: make sure address is valid
+  if (address < 0 || address >= memory->num_values) {
+    return NULL; // invalid address
+  }
+
+  // Step 2: hand back the cell's value itself, no malloc and no dupString.
+  // The SoA and boxed layouts have no RAM_VALUE to point at, so they
+  // fill in peeked
+  RAM_STAT(memory, address, reads);
+
+  if (memory->layout != RAM_LAYOUT_CELLS) {
+    memory->peeked = ram_load(memory, address);
+    return &memory->peeked;
+  }
+  return &memory->cells[address].value;
+}
+
+
+//
+// ram_peek_cell_by_name
+//
+// If the given name (e.g. "x") has been written to memory,
+// returns a pointer to the value stored in memory WITHOUT
+// making a copy. Returns NULL if no such name exists in memory.
+//
+// NOTE: the value is borrowed, the caller must not modify or
+// free it. The pointer is valid until the next write to memory.
+//
+const struct RAM_VALUE* ram_peek_cell_by_name(struct RAM* memory, char* name)
+{
+  return ram_peek_cell_by_addr(memory, ram_get_addr(memory, name));
+}
+
+
+//
+// ram_free_value
+//
+// Frees the memory value returned by ram_read_cell_by_name and
+// ram_read_cell_by_addr.
+//
+void ram_free_value(struct RAM_VALUE* value)
+{
+  // case 1: there is nothing to free because memory is null
+  if (value == NULL) {
+    return;
+  }
+  
+  // Release the string if the value is of type RAM_TYPE_STR, it is
+  // shared with memory (a plain malloc'ed string is just freed)
+  if (value->value_type == RAM_TYPE_STR) {
+    //printf("Freeing string: %s\n", value->types.s); // debug
+    if (ram_str_is_shared(value->types.s)) {
+      ram_str_release(value->types.s);
+    } else {
+      free(value->types.s);
+    }
+  }
+
+  // Free the RAM_VALUE struct itself
+  //printf("Freeing RAM_VALUE struct\n"); // debug
+  free(value);
+
+}
+
+
+//
+// ram_write_cell_by_addr
+//
+// Writes the given value to the memory cell at the given 
+// address. If a value already exists at this address, that
+// value is overwritten by this new value. Returns true if 
+// the value was successfully written, false if not (which 
+// implies the memory address is invalid).
+// 
+// NOTE: if the value being written is a string, it will
+// be duplicated and stored.
+// 
+// NOTE: a variable has to be written to memory before its
+// address becomes valid. Once a variable is written to memory,
+// its address never changes.
+//
+bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int address)
+{
+  // Step 1.5: make sure num_values is > 0 so that we dont produce a seg fault
+  if (memory == NULL || memory->index == NULL) {
+    return false;  // Invalid memory structure
+  }
+  
+  // Step 1: make sure the address is valid
+  if (address < 0 || address >= memory->num_values) {
+        return false;  // Invalid address
+    }
+
+  // extra addition: ensure the string value is not NULL if the type is RAM_TYPE_STR
+  if (value.value_type == RAM_TYPE_STR && value.types.s == NULL) {
+    return false; // Avoid crashing on invalid input
+  }
+
+  // Step 2: address is valid. Write the new value, a string is copied
+  // (inline or on the heap) BEFORE the old one is freed --- the caller
+  // may have borrowed it from this very cell via ram_peek_cell_by_*.
+  // Then let anyone watching know, a single check when nobody is
+  if (memory->num_marks != 0) {
+    ram_journal(memory, address, false);  // a transaction is open
+  }
+  if (RAM_HOOKS_ACTIVE(memory)) {
+    ram_store_hooked(memory, address, value);
+    return true;
+  }
+  ram_store(memory, address, value);
+
+  return true;
+}
+
+
+//
+// ram_write_cell_by_name
+//
+// Writes the given value to a memory cell named by the given
+// name. If a memory cell already exists with this name, the
+// existing value is overwritten by the given value. Returns
+// true since this operation always succeeds.
+// 
+// NOTE: if the value being written is a string, it will
+// be duplicated and stored.
+// 
+// NOTE: a variable has to be written to memory before its
+// address becomes valid. Once a variable is written to memory,
+// its address never changes.
+//
+bool ram_write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* name)
+{
+  // Check for invalid inputs
+  if (memory == NULL || name == NULL) {
+    return false; // Avoid crashing on invalid inputs
+  }
+
+  // Step 1: check if the variable exists
+  int address = ram_get_addr(memory, name);
+  if (address != -1) {
+    // Write the new value, copying the string before freeing the old
+    // one since the caller may have borrowed it from this very cell
+    if (memory->num_marks != 0) {
+      ram_journal(memory, address, false);  // a transaction is open
+    }
+    if (RAM_HOOKS_ACTIVE(memory)) {
+      ram_store_hooked(memory, address, value);
+      return true;
+    }
+    ram_store(memory, address, value);
+
+    return true;
+  }
+
+  // Step 1.5: a short string borrowed from one of our cells would move
+  // if the cells are reallocated below, so copy it out first
+  char short_str[RAM_INLINE_STR_MAX + 1];
+  if (memory->layout == RAM_LAYOUT_CELLS &&
+      value.value_type == RAM_TYPE_STR && value.types.s != NULL && strlen(value.types.s) <= RAM_INLINE_STR_MAX) {
+    strcpy(short_str, value.types.s);
+    value.types.s = short_str;
+  }
+
+  // Step 2: the variable doesn't exist, let's see if we need to expand capacity
+  if (memory->num_values == memory->capacity) {
+    // double the capacity, the hash index grows with it; concurrent
+    // readers must not see the cells halfway moved
+    ram_shape_begin(memory);
+    bool grown = ram_grow(memory);
+    ram_shape_end(memory);
+    if (!grown) { // memory allocation failed
+      return false;
+    }
+  }
+
+  // Step 3: Add new variable
+  int new_index = memory->num_values;
+  char* identifier = intern_keep(name);  // shared interned copy of the name, kept while the memory lives
+  if (memory->layout == RAM_LAYOUT_SOA) {
+    __atomic_store_n(&memory->identifiers[new_index], identifier, __ATOMIC_RELAXED);
+    __atomic_store_n(&memory->tags[new_index], (unsigned char)RAM_TYPE_NONE, __ATOMIC_RELAXED);
+  } else if (memory->layout == RAM_LAYOUT_BOXED) {
+    struct RAM_VALUE none;
+    none.value_type = RAM_TYPE_NONE;
+    none.types.i = 0;
+    __atomic_store_n(&memory->identifiers[new_index], identifier, __ATOMIC_RELAXED);
+    __atomic_store_n(&memory->payloads[new_index].box, ram_box_encode(none), __ATOMIC_RELAXED);
+  } else {
+    __atomic_store_n(&memory->cells[new_index].identifier, identifier, __ATOMIC_RELAXED);
+    __atomic_store_n(&memory->cells[new_index].value.value_type, (int)RAM_TYPE_NONE, __ATOMIC_RELAXED);
+  }
+  memory->index[ram_index_probe(memory, identifier)] = new_index + memory->index_base;
+  if (memory->num_marks != 0) {
+    ram_journal(memory, new_index, true);  // a transaction is open
+  }
+  ram_store(memory, new_index, value);  // copies a string inline or onto the heap
+
+  // Update the count of stored variables, publishing the new cell to
+  // concurrent readers only now that it is complete
+  __atomic_store_n(&memory->num_values, memory->num_values + 1, __ATOMIC_RELEASE);
+
+  if (RAM_HOOKS_ACTIVE(memory)) {
+    ram_call_hooks(memory, new_index);
+  }
+
+  return true;
+}
+
+
+//
+// ram_add_write_hook
+//
+// Registers fn to be called after every write to the given
+// address, or after every write at all if address is -1.
+// Returns an id for ram_remove_write_hook, or -1 if out of
+// memory.
+//
+int ram_add_write_hook(struct RAM* memory, int address, RAM_WRITE_HOOK fn, void* context)
+{
+  if (memory == NULL || fn == NULL) {
+    return -1;
+  }
+
+  // Step 1: make room, hooks are few so grow 4 at a time
+  if (memory->num_hooks == memory->hooks_capacity) {
+    int capacity = memory->hooks_capacity + 4;
+    struct RAM_HOOK* hooks = (struct RAM_HOOK*) realloc(memory->hooks, capacity * sizeof(struct RAM_HOOK));
+    if (hooks == NULL) {
+      return -1;
+    }
+    memory->hooks = hooks;
+    memory->hooks_capacity = capacity;
+  }
+
+  // Step 2: append, so hooks are called in the order they were added
+  struct RAM_HOOK* hook = &memory->hooks[memory->num_hooks];
+  hook->id = memory->next_hook_id;
+  hook->address = (address < 0) ? -1 : address;
+  hook->fn = fn;
+  hook->context = context;
+
+  memory->num_hooks++;
+  memory->next_hook_id++;
+
+  return hook->id;
+}
+
+
+//
+// ram_remove_write_hook
+//
+// Removes the hook with the given id. Returns true if it was
+// removed, false if there is no such hook.
+//
+bool ram_remove_write_hook(struct RAM* memory, int id)
+{
+  if (memory == NULL) {
+    return false;
+  }
+
+  for (int i = 0; i < memory->num_hooks; i++) {
+    if (memory->hooks[i].id == id) {
+      // shift the rest down to keep the order they were added in
+      memmove(&memory->hooks[i], &memory->hooks[i + 1], (memory->num_hooks - i - 1) * sizeof(struct RAM_HOOK));
+      memory->num_hooks--;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+
+
+//
+// ram_begin
+//
+// Starts a (possibly nested) transaction, see ram_rollback.
+// Returns false if out of memory.
+//
+bool ram_begin(struct RAM* memory)
+{
+  if (memory->num_marks == memory->marks_capacity) {
+    int capacity = (memory->marks_capacity == 0) ? 4 : 2 * memory->marks_capacity;
+    int* marks = (int*) realloc(memory->marks, capacity * sizeof(int));
+    if (marks == NULL) {
+      return false;
+    }
+    memory->marks = marks;
+    memory->marks_capacity = capacity;
+  }
+
+  memory->marks[memory->num_marks] = memory->journal_length;
+  memory->num_marks++;
+  return true;
+}
+
+
+//
+// ram_commit
+//
+// Ends the innermost transaction, keeping its writes. Returns
+// false if no transaction is open.
+//
+bool ram_commit(struct RAM* memory)
+{
+  if (memory->num_marks == 0) {
+    return false;
+  }
+
+  memory->num_marks--;
+
+  // an outer transaction may still roll these writes back, only the
+  // outermost commit makes them final
+  if (memory->num_marks == 0) {
+    ram_undo_forget(memory, 0);
+  }
+
+  return true;
+}
+
+
+//
+// ram_rollback
+//
+// Ends the innermost transaction, undoing its writes newest first.
+// Returns false if no transaction is open.
+//
+bool ram_rollback(struct RAM* memory)
+{
+  if (memory->num_marks == 0) {
+    return false;
+  }
+
+  int mark = memory->marks[memory->num_marks - 1];
+
+  // Step 1: undo, newest first, so a created cell is always the last
+  for (int i = memory->journal_length - 1; i >= mark; i--) {
+    struct RAM_UNDO* undo = &memory->journal[i];
+
+    if (undo->created) {
+      ram_uncreate(memory, undo->address);
+      continue;
+    }
+
+    ram_store(memory, undo->address, undo->old);  // shares the old string again
+    if (RAM_HOOKS_ACTIVE(memory)) {
+      ram_call_hooks(memory, undo->address);
+    }
+  }
+
+  // Step 2: drop the entries and the journal's string references
+  ram_undo_forget(memory, mark);
+  memory->num_marks--;
+
+  return true;
+}
+
+
+//
+// ram_compact
+//
+// Moves every arena string still held by a cell into fresh chunks,
+// fixing up the cell to point at the copy, and frees the old chunks.
+//
+bool ram_compact(struct RAM* memory, bool force)
+{
+  if (memory->num_marks != 0 || memory->readers_enabled || memory->num_arena_chunks == 0) {
+    return false;
+  }
+
+  if (!force && (memory->arena_free_bytes < RAM_ARENA_COMPACT_MIN ||
+                 memory->arena_free_bytes <= memory->arena_live_bytes)) {
+    return false;
+  }
+
+  // Step 1: start a new arena, the old chunks stay readable until Step 3
+  struct RAM_ARENA_CHUNK** old_chunks = memory->arena_chunks;
+  int num_old_chunks = memory->num_arena_chunks;
+
+  memory->arena_chunks = NULL;
+  memory->num_arena_chunks = 0;
+  memory->arena_chunks_capacity = 0;
+  memory->arena_top = NULL;
+  for (int c = 0; c < RAM_ARENA_CLASSES; c++) {
+    memory->arena_free[c] = NULL;
+  }
+  memory->arena_live_bytes = 0;
+  memory->arena_free_bytes = 0;
+
+  // Step 2: with no transaction open or reader holding one, the cells
+  // are the only references to unpublished arena strings. The first
+  // cell to reach a string moves it and leaves a forwarding pointer
+  // (refs == -1) for the other cells sharing it. A published string
+  // stays where it is, and keeps its old chunk
+  for (int addr = 0; addr < memory->num_values; addr++) {
+    char* s = ram_heap_str_at(memory, addr);
+    if (s == NULL || !ram_str_in_arena(s)) {
+      continue;
+    }
+
+    struct RAM_STR* old = ram_str_header(s);
+    char* moved;
+
+    if (old->refs == -1) {
+      memcpy(&moved, old->chars, sizeof(char*));
+    } else {
+      struct RAM_STR* str = ram_arena_alloc(memory, old->block);
+      memcpy(str, old, sizeof(struct RAM_STR) + old->length + 1);
+      moved = str->chars;
+
+      old->refs = -1;
+      memcpy(old->chars, &moved, sizeof(char*));
+    }
+
+    if (memory->layout == RAM_LAYOUT_CELLS) {
+      memory->cells[addr].value.types.s = moved;
+    } else if (memory->layout == RAM_LAYOUT_SOA) {
+      memory->payloads[addr].s = moved;
+    } else {
+      struct RAM_VALUE value;
+      value.value_type = RAM_TYPE_STR;
+      value.types.s = moved;
+      memory->payloads[addr].box = ram_box_encode(value);
+    }
+  }
+
+  // Step 3: only published strings still point into the old chunks
+  ram_arena_free(old_chunks, num_old_chunks);
+
+  return true;
+}
+
+
+//
+// ram_epoch
+//
+// Returns the current epoch #. Memory starts in epoch 0.
+//
+int ram_epoch(struct RAM* memory)
+{
+  return memory->epoch;
+}
+
+
+//
+// ram_next_epoch
+//
+// Ends the current epoch and starts the next one, whose # is
+// returned. Clears the dirty bit of every cell written in the
+// epoch that ended, and keeps the write log at most twice the
+// capacity long.
+//
+int ram_next_epoch(struct RAM* memory)
+{
+  // Step 1: the cells written this epoch are the tail of the log
+  for (int i = memory->num_touches - 1; i >= 0 && memory->touches[i].epoch == memory->epoch; i--) {
+    int addr = memory->touches[i].address;
+    memory->dirty[addr / RAM_DIRTY_BITS] &= ~(1UL << (addr % RAM_DIRTY_BITS));
+  }
+
+  // Step 2: once the log reaches twice the capacity, drop the entries
+  // ram_changed_since skips: a cell's writes in epochs before its last
+  // one, and removed cells. At most one entry per address is left, so
+  // this amortizes to O(1) per write
+  if (memory->num_touches >= 2 * memory->capacity) {
+    int kept = 0;
+    for (int i = 0; i < memory->num_touches; i++) {
+      int addr = memory->touches[i].address;
+      if (addr < memory->num_values && memory->touched_epoch[addr] == memory->touches[i].epoch) {
+        memory->touches[kept] = memory->touches[i];
+        kept++;
+      }
+    }
+    memory->num_touches = kept;
+  }
+
+  // Step 3: on to the next one
+  memory->epoch++;
+  return memory->epoch;
+}
+
+
+//
+// ram_is_dirty
+//
+// Returns true if the cell at the given address has been written
+// during the current epoch, false if not (or if the address is
+// not valid).
+//
+bool ram_is_dirty(struct RAM* memory, int address)
+{
+  if (address < 0 || address >= memory->num_values) {
+    return false;
+  }
+
+  return (memory->dirty[address / RAM_DIRTY_BITS] >> (address % RAM_DIRTY_BITS)) & 1UL;
+}
+
+
+//
+// ram_changed_since
+//
+// Stores into addresses the address of every cell written during
+// the given epoch or any later one, each address once, and returns
+// how many there are.
+//
+int ram_changed_since(struct RAM* memory, int epoch, int* addresses)
+{
+  // Step 1: binary search for the first log entry of that epoch or
+  // later, the log is in epoch order
+  int lo = 0;
+  int hi = memory->num_touches;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (memory->touches[mid].epoch < epoch) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  // Step 2: a cell written in several of those epochs is logged once
+  // per epoch, only report it at its last one. A cell a rollback
+  // removed is past the last cell, unless written again since
+  int count = 0;
+  for (int i = lo; i < memory->num_touches; i++) {
+    int addr = memory->touches[i].address;
+    if (addr < memory->num_values && memory->touched_epoch[addr] == memory->touches[i].epoch) {
+      addresses[count] = addr;
+      count++;
+    }
+  }
+
+  return count;
+}
+
+
+//
+// ram_writes_observed
+//
+// Returns true if something besides the writer sees each write as
+// it happens: hooks, readers, a transaction, a snapshot or stats.
+//
+bool ram_writes_observed(struct RAM* memory)
+{
+  return memory->num_hooks != 0 || memory->readers_enabled || memory->num_marks != 0 ||
+         memory->num_snapshots != 0 || memory->stats != NULL;
+}
+
+
+//
+// ram_print
+//
+// Prints the contents of memory to the console.
+//
+void ram_print(struct RAM* memory)
+{
+  struct RAM_DUMP_OPTIONS options;
+  ram_dump_options_init(&options);
+
+  ram_dump(memory, &options, stdout);
+}
+
+
+//
+// ram_dump
+//
+// Runs every cell in the options' address range through the dump
+// engine, stopping as soon as it wants no more.
+//
+int ram_dump(struct RAM* memory, struct RAM_DUMP_OPTIONS* options, FILE* out)
+{
+  struct RAM_DUMP dump;
+  ram_dump_begin(&dump, options, out);
+  ram_dump_header(&dump, "MEMORY", memory->capacity, memory->num_values);
+
+  for (int i = options->first; i < memory->num_values; i++) {
+    struct RAM_VALUE value = ram_load(memory, i);
+
+    if (!ram_dump_row(&dump, i, ram_identifier_at(memory, i), &value)) {
+      break;
+    }
+  }
+
+  return ram_dump_end(&dump);
 }
 
 
-
+#ifdef RAM_STATS
 //
-// Public functions:
+// one line of the ram_print_stats report
 //
+struct RAM_STATS_ROW
+{
+  int address;
+  unsigned long heat;  // reads + writes + lookups
+};
+
+
+/* ram_stats_hotter
+qsort comparison for ram_print_stats: hottest first, and by address
+when equally hot
+
+parameters: const void*, const void*   // two struct RAM_STATS_ROW*
+returns: int
+*/
+static int ram_stats_hotter(const void* a, const void* b) {
+  const struct RAM_STATS_ROW* x = (const struct RAM_STATS_ROW*)a;
+  const struct RAM_STATS_ROW* y = (const struct RAM_STATS_ROW*)b;
+
+  if (x->heat != y->heat) {
+    return (x->heat > y->heat) ? -1 : 1;
+  }
+  return x->address - y->address;
+}
+#endif
+
 
 //
-// ram_init
+// ram_print_stats
 //
-// Returns a pointer to a dynamically-allocated memory
-// for storing nuPython variables and their values. All
-// memory cells are initialized to the value None.
+// Prints how often each variable was read, written and looked up
+// by name, and how many string bytes were copied for it, hottest
+// (most reads + writes + lookups) first.
 //
-struct RAM* ram_init(void)
+void ram_print_stats(struct RAM* memory)
 {
-  // Step 1: Allocate memory for the RAM structure
-  struct RAM* memory = (struct RAM*) malloc(sizeof(struct RAM));
-  if (memory == NULL) {
-    //printf("ERROR: allocation failed and NULL was returned\n");
-    return NULL;
+  printf("**MEMORY STATS**\n");
+
+#ifdef RAM_STATS
+  struct RAM_STATS_ROW* rows = (struct RAM_STATS_ROW*)malloc((memory->num_values + 1) * sizeof(struct RAM_STATS_ROW));
+  if (rows == NULL) {
+    printf("**END STATS**\n");
+    return;
   }
-  
-  // Step 2: Allocate memory for 4 RAM_CELLS and set the intial capacity
-  // cells is a dynamically allocated array of RAM_CELL struct objects
-  memory->cells = (struct RAM_CELL*) malloc(4 * sizeof(struct RAM_CELL));
-  if (memory-> cells == NULL) {
-    //printf("RAM freed because cell allocation failed and NULL is returned\n");
-    free(memory);
-    return NULL;
+
+  // Step 1: sort the addresses by heat
+  for (int i = 0; i < memory->num_values; i++) {
+    rows[i].address = i;
+    rows[i].heat = memory->stats[i].reads + memory->stats[i].writes + memory->stats[i].lookups;
   }
+  qsort(rows, memory->num_values, sizeof(struct RAM_STATS_ROW), ram_stats_hotter);
 
-  // Step 3: Initialize num_values to 0 and capacity to 4
-  // each ram_cell struct has an identifier and a ram_value
-  memory -> num_values = 0;
-  memory -> capacity = 4;
+  // Step 2: one line per variable
+  printf("%6s  %-16s %10s %10s %10s %12s\n", "addr", "name", "reads", "writes", "lookups", "str bytes");
+  for (int i = 0; i < memory->num_values; i++) {
+    int addr = rows[i].address;
+    struct RAM_CELL_STATS* stats = &memory->stats[addr];
 
-  // Step 4: Initialize each cell’s identifier to NULL and set value type to RAM_TYPE_NONE
-  for (int i = 0; i < 4; i++) {
-    memory->cells[i].identifier = NULL;
-    memory->cells[i].value.value_type = RAM_TYPE_NONE;
+    printf("%6d  %-16s %10lu %10lu %10lu %12lu\n", addr, ram_identifier_at(memory, addr),
+           stats->reads, stats->writes, stats->lookups, stats->str_bytes);
   }
 
-  return memory;
+  free(rows);
+#else
+  printf("not counted, build with -DRAM_STATS\n");
+#endif
+
+  printf("**END STATS**\n");
 }
 
 
 //
-// ram_destroy
+// ram_snapshot
 //
-// Frees the dynamically-allocated memory associated with
-// the given memory. After the call returns, you cannot
-// use the memory.
+// Returns an immutable snapshot of the given memory as it is now,
+// or NULL if out of memory. Copies nothing, every chunk starts out
+// shared with the memory.
 //
-void ram_destroy(struct RAM* memory)
+struct RAM_SNAPSHOT* ram_snapshot(struct RAM* memory)
 {
-  if (memory == NULL) {
-    return;  // there is nothing to destroy if memory is NULL
+  // Step 1: make room in the memory's list of snapshots
+  if (memory->num_snapshots == memory->snapshots_capacity) {
+    int capacity = (memory->snapshots_capacity == 0) ? 4 : 2 * memory->snapshots_capacity;
+    struct RAM_SNAPSHOT** snapshots = (struct RAM_SNAPSHOT**) realloc(memory->snapshots, capacity * sizeof(struct RAM_SNAPSHOT*));
+    if (snapshots == NULL) {
+      return NULL;
+    }
+    memory->snapshots = snapshots;
+    memory->snapshots_capacity = capacity;
   }
 
-  // Step 1: Free each cell's identifier and value
-  for (int i = 0; i < memory->num_values; i++) {
-    // Free the identifier if it was dynamically allocated
-    free(memory->cells[i].identifier);
+  // Step 2: a snapshot with every chunk shared
+  struct RAM_SNAPSHOT* snapshot = (struct RAM_SNAPSHOT*) malloc(sizeof(struct RAM_SNAPSHOT));
+  if (snapshot == NULL) {
+    return NULL;
+  }
 
-    // free string memory if it is of the correct type
-    if (memory->cells[i].value.value_type == RAM_TYPE_STR) {
-      free(memory->cells[i].value.types.s);
-    }
+  snapshot->memory = memory;
+  snapshot->num_values = memory->num_values;
+  snapshot->num_chunks = (memory->num_values + RAM_SNAPSHOT_CHUNK - 1) / RAM_SNAPSHOT_CHUNK;
+  snapshot->chunks = (struct RAM_CELL**) calloc(snapshot->num_chunks + 1, sizeof(struct RAM_CELL*));
+  snapshot->peeked.value_type = RAM_TYPE_NONE;
+  if (snapshot->chunks == NULL) {
+    free(snapshot);
+    return NULL;
   }
 
-  // Step 2: Free the cells array itself
-  free(memory->cells);
+  memory->snapshots[memory->num_snapshots] = snapshot;
+  memory->num_snapshots++;
 
-  // Step 3: Free the RAM structure
-  free(memory);
-  return;
+  return snapshot;
 }
 
 
 //
-// ram_get_addr
-// 
-// If the given identifier (e.g. "x") has been written to 
-// memory, returns the address of this value --- an integer
-// in the range 0..N-1 where N is the number of values currently 
-// stored in memory. Returns -1 if no such identifier exists 
-// in memory. 
-// 
-// NOTE: a variable has to be written to memory before you can
-// get its address. Once a variable is written to memory, its
-// address never changes.
+// ram_snapshot_release
 //
-int ram_get_addr(struct RAM* memory, char* identifier)
+// Frees the snapshot. After the call returns, you cannot use it.
+//
+void ram_snapshot_release(struct RAM_SNAPSHOT* snapshot)
 {
-  // Step 1: loop through all stored values in memory right now
-  for (int i = 0; i < memory->num_values; i++) {
-    // check if the cell's identifier matches the given identifier by the parameter
-    if (strcmp(memory->cells[i].identifier, identifier) == 0) {
-      return i; // return the cell's index if a match is found
+  if (snapshot == NULL) {
+    return;
+  }
+
+  // Step 1: the memory no longer has to copy chunks for it
+  struct RAM* memory = snapshot->memory;
+  if (memory != NULL) {
+    for (int k = 0; k < memory->num_snapshots; k++) {
+      if (memory->snapshots[k] == snapshot) {
+        memory->snapshots[k] = memory->snapshots[memory->num_snapshots - 1];
+        memory->num_snapshots--;
+        break;
+      }
     }
   }
-  return -1; // if not found return -1
+
+  // Step 2: free its own chunks, releasing the names and strings they share
+  for (int c = 0; c < snapshot->num_chunks; c++) {
+    struct RAM_CELL* chunk = snapshot->chunks[c];
+    if (chunk == NULL) {
+      continue;
+    }
+
+    for (int i = 0; i < RAM_SNAPSHOT_CHUNK; i++) {
+      intern_release(chunk[i].identifier);
+      if (chunk[i].value.value_type == RAM_TYPE_STR &&
+          chunk[i].value.types.s != NULL &&
+          chunk[i].value.types.s != chunk[i].inline_str) {
+        ram_str_release(chunk[i].value.types.s);
+      }
+    }
+    free(chunk);
+  }
+
+  free(snapshot->chunks);
+  free(snapshot);
 }
 
 
 //
-// ram_read_cell_by_addr
-//
-// Given a memory address (an integer in the range 0..N-1), 
-// returns a COPY of the value contained in that memory cell.
-// Returns NULL if the address is not valid.
-//
-// NOTE: this function allocates memory for the value that
-// is returned. The caller takes ownership of the copy and 
-// must eventually free this memory via ram_free_value().
+// ram_snapshot_peek_by_addr
 //
-// NOTE: a variable has to be written to memory before its
-// address becomes valid. Once a variable is written to memory,
-// its address never changes.
+// Returns a pointer to the value at the given address at the time
+// the snapshot was taken, or NULL if the address was not valid then.
 //
-struct RAM_VALUE* ram_read_cell_by_addr(struct RAM* memory, int address)
+const struct RAM_VALUE* ram_snapshot_peek_by_addr(struct RAM_SNAPSHOT* snapshot, int address)
 {
-  //Step 1: make sure address is valid
-  if (address < 0 || address >= memory->num_values) {
-    //printf("this is a invalid address and NULL was returned\n");;
-    return NULL; // invalid address
-  }
-
-  // Step 2: Allocate memory for copy of RAM_VALUE
-  struct RAM_VALUE* copy = (struct RAM_VALUE*)malloc(sizeof(struct RAM_VALUE));
-  if (copy == NULL) {
-    //printf("ERROR: OUT OF MEMORY\n");
+  if (address < 0 || address >= snapshot->num_values) {
     return NULL;
   }
 
-  // Step 3: Copy the value type
-  copy->value_type = memory->cells[address].value.value_type;
-
-  // Step 4: Copy the actual data based on the type
-  if (copy->value_type == RAM_TYPE_STR) {
-    // Duplicate the string
-    copy->types.s = dupString(memory->cells[address].value.types.s);
-  } else {
-    // it is not a string type so just copy the data directly
-    copy->types = memory->cells[address].value.types;
+  // a copied chunk holds the value, a shared one is still unchanged in memory
+  struct RAM_CELL* chunk = snapshot->chunks[address / RAM_SNAPSHOT_CHUNK];
+  if (chunk != NULL) {
+    return &chunk[address % RAM_SNAPSHOT_CHUNK].value;
   }
 
-  return copy;
+  snapshot->peeked = ram_load(snapshot->memory, address);
+  return &snapshot->peeked;
 }
 
 
-// 
-// ram_read_cell_by_name
 //
-// If the given name (e.g. "x") has been written to 
-// memory, returns a COPY of the value contained in memory.
-// Returns NULL if no such name exists in memory.
+// ram_snapshot_peek_by_name
 //
-// NOTE: this function allocates memory for the value that
-// is returned. The caller takes ownership of the copy and 
-// must eventually free this memory via ram_free_value().
+// Like ram_snapshot_peek_by_addr, for the variable with the given
+// name. Returns NULL if there was no such variable.
 //
-struct RAM_VALUE* ram_read_cell_by_name(struct RAM* memory, char* name)
+const struct RAM_VALUE* ram_snapshot_peek_by_name(struct RAM_SNAPSHOT* snapshot, char* name)
 {
-  // Step 1: find he address of the variable by name
-  int addr = ram_get_addr(memory, name);
-  if (addr == -1) { // variable was not found
-    //printf("variable was not found and NULL was returned");
+  char* interned = intern_find(name);
+  if (interned == NULL) {
     return NULL;
   }
 
-  //Step 2: allocate memory for the copy of RAM_VALUE
-  struct RAM_VALUE* copy = (struct RAM_VALUE*)malloc(sizeof(struct RAM_VALUE));
-  if (copy == NULL) {
-    //printf("ERROR: OUT OF MEMORY\n");
-    return NULL;
+  // Step 1: addresses never change, so the memory's index usually knows
+  if (snapshot->memory != NULL) {
+    int addr = ram_get_addr(snapshot->memory, interned);
+    if (addr != -1 && addr < snapshot->num_values) {
+      return ram_snapshot_peek_by_addr(snapshot, addr);
+    }
   }
 
-  // Step 3: copy the value type 
-  copy->value_type = memory->cells[addr].value.value_type;
-
-  // step 4: copy the data based on the type
-  if (copy->value_type == RAM_TYPE_STR) {
-    // duplicate the string
-    copy->types.s = dupString(memory->cells[addr].value.types.s);
-  } else {
-    // if its not a string copy the data directly
-    copy->types = memory->cells[addr].value.types;
+  // Step 2: the memory is gone, or the variable was rolled back
+  // since; look through the snapshot itself
+  for (int addr = 0; addr < snapshot->num_values; addr++) {
+    struct RAM_CELL* chunk = snapshot->chunks[addr / RAM_SNAPSHOT_CHUNK];
+    char* identifier = (chunk != NULL) ? chunk[addr % RAM_SNAPSHOT_CHUNK].identifier
+                                       : ram_identifier_at(snapshot->memory, addr);
+    if (identifier == interned) {
+      return ram_snapshot_peek_by_addr(snapshot, addr);
+    }
   }
 
-  return copy;
+  return NULL;
 }
 
 
 //
-// ram_free_value
+// ram_snapshot_print
 //
-// Frees the memory value returned by ram_read_cell_by_name and
-// ram_read_cell_by_addr.
+// Prints the snapshot to the console, in the format of ram_print.
 //
-void ram_free_value(struct RAM_VALUE* value)
+void ram_snapshot_print(struct RAM_SNAPSHOT* snapshot)
 {
-  // case 1: there is nothing to free because memory is null
-  if (value == NULL) {
-    return;
-  }
-  
-  // Free the string if the value is of type RAM_TYPE_STR
-  if (value->value_type == RAM_TYPE_STR) {
-    //printf("Freeing string: %s\n", value->types.s); // debug
-    free(value->types.s);
-  }
+  struct RAM_DUMP_OPTIONS options;
+  struct RAM_DUMP dump;
 
-  // Free the RAM_VALUE struct itself
-  //printf("Freeing RAM_VALUE struct\n"); // debug
-  free(value);
+  ram_dump_options_init(&options);
+  ram_dump_begin(&dump, &options, stdout);
+  ram_dump_header(&dump, "SNAPSHOT", -1, snapshot->num_values);
+
+  for (int addr = 0; addr < snapshot->num_values; addr++) {
+    struct RAM_CELL* chunk = snapshot->chunks[addr / RAM_SNAPSHOT_CHUNK];
+
+    if (chunk != NULL) {
+      ram_dump_row(&dump, addr, chunk[addr % RAM_SNAPSHOT_CHUNK].identifier, &chunk[addr % RAM_SNAPSHOT_CHUNK].value);
+    } else {
+      struct RAM_VALUE value = ram_load(snapshot->memory, addr);
+      ram_dump_row(&dump, addr, ram_identifier_at(snapshot->memory, addr), &value);
+    }
+  }
 
+  ram_dump_end(&dump);
 }
 
 
 //
-// ram_write_cell_by_addr
+// ram_readers_enable
 //
-// Writes the given value to the memory cell at the given 
-// address. If a value already exists at this address, that
-// value is overwritten by this new value. Returns true if 
-// the value was successfully written, false if not (which 
-// implies the memory address is invalid).
-// 
-// NOTE: if the value being written is a string, it will
-// be duplicated and stored.
-// 
-// NOTE: a variable has to be written to memory before its
-// address becomes valid. Once a variable is written to memory,
-// its address never changes.
+// Lets other threads read memory with ram_read_concurrent while
+// this thread keeps writing. Returns false if out of memory.
 //
-bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int address)
+bool ram_readers_enable(struct RAM* memory)
 {
-  // Step 1.5: make sure num_values is > 0 so that we dont produce a seg fault
-  if (memory == NULL || memory->cells == NULL) {
-    return false;  // Invalid memory structure
+  if (memory->readers_enabled) {
+    return true;
   }
-  
-  // Step 1: make sure the address is valid
-  if (address < 0 || address >= memory->num_values) {
-        return false;  // Invalid address
-    }
 
-  // Step 2: address is valid. Lets free the old value if its a string
-  if (memory->cells[address].value.value_type == RAM_TYPE_STR) {
-    free(memory->cells[address].value.types.s);
-  }
+  ram_threads_enable();  // readers may release strings they read
 
-  // extra addition: ensure the string value is not NULL if the type is RAM_TYPE_STR
-  if (value.value_type == RAM_TYPE_STR && value.types.s == NULL) {
-    return false; // Avoid crashing on invalid input
+  memory->seqs = (unsigned int*) calloc(memory->capacity, sizeof(unsigned int));
+  if (memory->seqs == NULL) {
+    return false;
   }
 
-  // // Step 2.5: free the identifier and duplicate it
-  // if (memory->cells[address].identifier != NULL) {
-  //   char* new_identifier = dupString(memory->cells[address].identifier);
-  //   free(memory->cells[address].identifier);
-  //   memory->cells[address].identifier = new_identifier;
-  // } else { // we must account for the fact that the identifier could be NULL
-  //   memory->cells[address].identifier = NULL;
-  // }
+  // published before any reader starts, so no atomics needed here
+  memory->readers_enabled = true;
+  return true;
+}
 
-  // Step 3: Write the new value
-  memory->cells[address].value = value;
-  
-  // Step 4: If the new value is a string, duplicate it and assign to types.s
-  if (value.value_type == RAM_TYPE_STR) {
-    // if (value.types.s != NULL) {
-      memory->cells[address].value.types.s = dupString(value.types.s);  // Duplicate the string
-    // }
-  // } else { // handle the case where string is NULL
-  //   memory->cells[address].value.types.s = NULL;  
-  }
 
-  return true;
+//
+// ram_threads_enable
+//
+// From now on the intern pool and the registry of shared strings
+// take locks, so several threads may use memories at once.
+//
+void ram_threads_enable(void)
+{
+  __atomic_store_n(&ram_threaded, true, __ATOMIC_RELEASE);
+  intern_threads_enable();
 }
 
 
 //
-// ram_write_cell_by_name
+// ram_readers_disable
 //
-// Writes the given value to a memory cell named by the given
-// name. If a memory cell already exists with this name, the
-// existing value is overwritten by the given value. Returns
-// true since this operation always succeeds.
-// 
-// NOTE: if the value being written is a string, it will
-// be duplicated and stored.
-// 
-// NOTE: a variable has to be written to memory before its
-// address becomes valid. Once a variable is written to memory,
-// its address never changes.
+// Undoes ram_readers_enable once every reader has stopped.
 //
-bool ram_write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* name)
+void ram_readers_disable(struct RAM* memory)
 {
-  // Check for invalid inputs
-  if (memory == NULL || name == NULL) {
-    return false; // Avoid crashing on invalid inputs
+  memory->readers_enabled = false;
+
+  free(memory->seqs);
+  memory->seqs = NULL;
+
+  assert(memory->readers == 0);
+  ram_reclaim(memory);
+  free(memory->retired);
+  memory->retired = NULL;
+  memory->retired_capacity = 0;
+}
+
+
+/* ram_copy_str_concurrent
+copies a string a concurrent reader found into its buffer. The string
+itself cannot be freed under the reader, but an inline one can be
+overwritten, and then it may have no terminator for a moment, so the
+copy never goes past the inline buffer.
+
+parameters: char*, int, char*, int   // buffer, its size, string, most chars it can hold
+returns: nothing
+*/
+static void ram_copy_str_concurrent(char* buffer, int size, char* s, int limit) {
+  int n = 0;
+
+  while (n < size - 1 && n < limit) {
+    char c = __atomic_load_n(&s[n], __ATOMIC_RELAXED);  // an inline one may be being written
+    if (c == '\0') {
+      break;
+    }
+    buffer[n] = c;
+    n++;
   }
+  buffer[n] = '\0';
+}
 
-  // Step 1: check if the variable exists
-  int address = ram_get_addr(memory, name);
-  if (address != -1) {
-    // Free the old value if it is a string
-    if (memory->cells[address].value.value_type == RAM_TYPE_STR) {
-      free(memory->cells[address].value.types.s);
+
+//
+// ram_read_concurrent
+//
+// Copies the value at the given address into *value, and a string
+// into the given buffer, from any thread. Returns false if the
+// address is invalid.
+//
+bool ram_read_concurrent(struct RAM* memory, int address, struct RAM_VALUE* value, char* buffer, int size)
+{
+  // Step 1: announce the read, so nothing it may hold is freed under it
+  __atomic_add_fetch(&memory->readers, 1, __ATOMIC_SEQ_CST);
+
+  bool found = false;
+  for (;;) {
+    // Step 2: wait out a move, then see where the cell is now
+    unsigned int shape = __atomic_load_n(&memory->shape, __ATOMIC_ACQUIRE);
+    if (shape & 1) {
+      continue;
     }
 
-    // Handle the new value
-    if (value.value_type == RAM_TYPE_STR && value.types.s != NULL) {
-      memory->cells[address].value.types.s = dupString(value.types.s);
+    int num_values = __atomic_load_n(&memory->num_values, __ATOMIC_ACQUIRE);
+    if (address < 0 || address >= num_values) {
+      found = false;
     } else {
-      memory->cells[address].value = value; // Copy non-string types
-    }
+      unsigned int* seqs = __atomic_load_n(&memory->seqs, __ATOMIC_ACQUIRE);
+      struct RAM_CELL* cells = __atomic_load_n(&memory->cells, __ATOMIC_ACQUIRE);
 
-    // Update the value type
-    memory->cells[address].value.value_type = value.value_type;
+      // Step 3: copy the value, retrying if a write overlapped
+      unsigned int seq = __atomic_load_n(&seqs[address], __ATOMIC_ACQUIRE);
+      if (seq & 1) {
+        continue;
+      }
 
-    return true;
-  }
+      struct RAM_VALUE copy;
+      if (memory->layout == RAM_LAYOUT_SOA) {
+        unsigned char* tags = __atomic_load_n(&memory->tags, __ATOMIC_ACQUIRE);
+        union RAM_PAYLOAD* payloads = __atomic_load_n(&memory->payloads, __ATOMIC_ACQUIRE);
+        union RAM_PAYLOAD payload;
+        copy.value_type = __atomic_load_n(&tags[address], __ATOMIC_RELAXED);
+        __atomic_load(&payloads[address], &payload, __ATOMIC_ACQUIRE);
+        memcpy(&copy.types, &payload, sizeof(copy.types));  // whichever member it is
+      } else if (memory->layout == RAM_LAYOUT_BOXED) {
+        union RAM_PAYLOAD* payloads = __atomic_load_n(&memory->payloads, __ATOMIC_ACQUIRE);
+        copy = ram_box_decode(__atomic_load_n(&payloads[address].box, __ATOMIC_ACQUIRE));
+      } else {
+        copy.value_type = __atomic_load_n(&cells[address].value.value_type, __ATOMIC_RELAXED);
+        __atomic_load(&cells[address].value.types, &copy.types, __ATOMIC_ACQUIRE);
+      }
 
-  // Step 2: the variable doesn't exist, let's see if we need to expand capacity
-  if (memory->num_values == memory->capacity) {
-    // double the capacity
-    memory->capacity *= 2;
-    memory->cells = (struct RAM_CELL*) realloc(memory->cells, memory->capacity * sizeof(struct RAM_CELL));
-    if (memory->cells == NULL) { // memory allocation failed
-      return false;
-    }
-  }
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&seqs[address], __ATOMIC_RELAXED) != seq) {
+        continue;
+      }
 
-  // Step 3: Add new variable
-  int new_index = memory->num_values;
-  memory->cells[new_index].identifier = dupString(name);  // Copy the name
-  memory->cells[new_index].value = value;
+      // Step 4: the value is whole, so a string pointer in it is real;
+      // copy the chars, then make sure they did not change meanwhile
+      if (copy.value_type == RAM_TYPE_STR && copy.types.s != NULL) {
+        bool inline_str = (cells != NULL && copy.types.s == cells[address].inline_str);
+        ram_copy_str_concurrent(buffer, size, copy.types.s, inline_str ? RAM_INLINE_STR_MAX : size);
+        copy.types.s = buffer;
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&seqs[address], __ATOMIC_RELAXED) != seq) {
+          continue;
+        }
+      }
 
-  // If the new value is a string, duplicate it
-  if (value.value_type == RAM_TYPE_STR) {
-    memory->cells[new_index].value.types.s = dupString(value.types.s);
+      *value = copy;
+      found = true;
+    }
+
+    // Step 5: and the cells did not move (or the cell vanish) meanwhile
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&memory->shape, __ATOMIC_RELAXED) == shape) {
+      break;
+    }
   }
 
-  memory->num_values++;  // Update the count of stored variables
-  return true;
+  __atomic_sub_fetch(&memory->readers, 1, __ATOMIC_SEQ_CST);
+  return found;
 }
 
 
-
-
 //
-// ram_print
+// ram_get_addr_concurrent
 //
-// Prints the contents of memory to the console.
+// Like ram_get_addr, from any thread. Takes time proportional to
+// the # of values.
 //
-void ram_print(struct RAM* memory)
+int ram_get_addr_concurrent(struct RAM* memory, char* name)
 {
-  printf("**MEMORY PRINT**\n");
-
-  printf("Capacity: %d\n", memory->capacity);
-  printf("Num values: %d\n", memory->num_values);
-  printf("Contents:\n");
-
-  for (int i = 0; i < memory->num_values; i++)
-  {
-    printf(" %d: %s, ", i, memory->cells[i].identifier);
-
-    if (memory->cells[i].value.value_type == RAM_TYPE_INT){
-      printf("int, %d", memory->cells[i].value.types.i);
-    } else if (memory->cells[i].value.value_type == RAM_TYPE_REAL) {
-      printf("real, %lf", memory->cells[i].value.types.d);
-    } else if (memory->cells[i].value.value_type == RAM_TYPE_STR) {
-      printf("str, '%s'", memory->cells[i].value.types.s);
-    } else if (memory->cells[i].value.value_type == RAM_TYPE_PTR) {
-      printf("ptr, %d", memory->cells[i].value.types.i);
-    } else if (memory->cells[i].value.value_type == RAM_TYPE_BOOLEAN) {
-      if (memory->cells[i].value.types.i == false) {
-        printf("boolean, False");
-      } else if (memory->cells[i].value.types.i == true) {
-        printf("boolean, True");
+  // the cells hold interned names, so only the pointer is compared: a
+  // cell removed meanwhile may already have released its name
+  char* interned = intern_find(name);
+  if (interned == NULL) {
+    return -1;
+  }
+
+  __atomic_add_fetch(&memory->readers, 1, __ATOMIC_SEQ_CST);
+
+  int address;
+  for (;;) {
+    unsigned int shape = __atomic_load_n(&memory->shape, __ATOMIC_ACQUIRE);
+    if (shape & 1) {
+      continue;
+    }
+
+    int num_values = __atomic_load_n(&memory->num_values, __ATOMIC_ACQUIRE);
+    struct RAM_CELL* cells = __atomic_load_n(&memory->cells, __ATOMIC_ACQUIRE);
+    char** identifiers = __atomic_load_n(&memory->identifiers, __ATOMIC_ACQUIRE);
+
+    address = -1;
+    for (int addr = 0; addr < num_values; addr++) {
+      char* identifier = (memory->layout != RAM_LAYOUT_CELLS) ? __atomic_load_n(&identifiers[addr], __ATOMIC_RELAXED)
+                                                              : __atomic_load_n(&cells[addr].identifier, __ATOMIC_RELAXED);
+
+      if (identifier == interned) {
+        address = addr;
+        break;
       }
-    } else if (memory->cells[i].value.value_type == RAM_TYPE_NONE) {
-      printf("none, None");
-    } else {
-      printf("unknown type");
     }
-    
-   printf("\n");
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&memory->shape, __ATOMIC_RELAXED) == shape) {
+      break;
+    }
   }
 
-  printf("**END PRINT**\n");
+  __atomic_sub_fetch(&memory->readers, 1, __ATOMIC_SEQ_CST);
+  return address;
 }
-
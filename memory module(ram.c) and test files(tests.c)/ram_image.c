@@ -0,0 +1,504 @@
+/*ram_image.c*/
+
+//
+// Saving memory to a binary image file and mapping it back in,
+// see ram_image.h for the file layout.
+//
+// Irene Ha
+// Northwestern University
+// CS 211
+//
+
+// mmap, fstat etc. are POSIX, not C11
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+#include <string.h>
+#include <stdint.h>
+
+#include <fcntl.h>     // open
+#include <unistd.h>    // close
+#include <sys/mman.h>  // mmap, munmap
+#include <sys/stat.h>  // fstat
+
+#include "ram_image.h"
+#include "ram_dump.h"
+#include "ram.h"
+
+
+/* ram_image_hash
+FNV-1a hash of a string, used for the image's identifier index. The
+index is part of the file format, so this must never change without
+bumping RAM_IMAGE_VERSION.
+
+parameters: char*   // the string
+returns: uint32_t
+*/
+static uint32_t ram_image_hash(char* s) {
+  uint32_t h = 2166136261u;
+
+  for (; *s != '\0'; s++) {
+    h = (h ^ (unsigned char)*s) * 16777619u;
+  }
+
+  return h;
+}
+
+
+/* ram_image_align
+rounds n up to a multiple of 8, so every section of an image is aligned
+
+parameters: uint64_t
+returns: uint64_t
+*/
+static uint64_t ram_image_align(uint64_t n) {
+  return (n + 7) & ~(uint64_t)7;
+}
+
+
+/* ram_image_identifier_of
+returns the identifier of the cell at addr, whichever layout memory has
+
+parameters: struct RAM*, int   // memory and a valid address
+returns: char*
+*/
+static char* ram_image_identifier_of(struct RAM* memory, int addr) {
+  if (memory->layout != RAM_LAYOUT_CELLS) {
+    return memory->identifiers[addr];
+  }
+  return memory->cells[addr].identifier;
+}
+
+
+/* ram_image_put_str
+copies a string to the heap of the image being built
+
+parameters: char*, uint64_t*, char*   // heap, # of bytes used so far, string or NULL
+returns: uint64_t   // its heap offset, RAM_IMAGE_NO_STR if NULL
+*/
+static uint64_t ram_image_put_str(char* heap, uint64_t* used, char* s) {
+  if (s == NULL) {
+    return RAM_IMAGE_NO_STR;
+  }
+
+  uint64_t offset = *used;
+  size_t len = strlen(s) + 1;  // +1 for the null terminator
+  memcpy(heap + offset, s, len);
+  *used += len;
+
+  return offset;
+}
+
+
+/* ram_image_str
+returns the string at the given heap offset, or NULL if there is none
+(or the offset is out of the heap, e.g. a damaged file)
+
+parameters: struct RAM_IMAGE*, uint64_t
+returns: char*
+*/
+static char* ram_image_str(struct RAM_IMAGE* image, uint64_t offset) {
+  if (offset >= image->header->heap_size) {
+    return NULL;
+  }
+  return image->heap + offset;
+}
+
+
+/* ram_image_value
+decodes the value stored in an image cell
+
+parameters: struct RAM_IMAGE*, struct RAM_IMAGE_CELL*
+returns: struct RAM_VALUE   // a string points into the mapping
+*/
+static struct RAM_VALUE ram_image_value(struct RAM_IMAGE* image, struct RAM_IMAGE_CELL* cell) {
+  struct RAM_VALUE value;
+  value.value_type = cell->value_type;
+
+  if (cell->value_type == RAM_TYPE_REAL) {
+    value.types.d = cell->payload.d;
+  } else if (cell->value_type == RAM_TYPE_STR) {
+    value.types.s = ram_image_str(image, cell->payload.s);
+  } else {
+    value.types.i = (int)cell->payload.i;
+  }
+
+  return value;
+}
+
+
+//
+// ram_image_save
+//
+// Writes the contents of memory to the given file as an image,
+// replacing the file if it exists. Returns true if successful,
+// false if the file could not be written.
+//
+bool ram_image_save(struct RAM* memory, char* filename)
+{
+  int n = memory->num_values;
+
+  // Step 1: size the sections, the heap holds every identifier and string
+  int32_t index_size = 8;
+  while (index_size < 2 * n) {
+    index_size *= 2;
+  }
+
+  uint64_t heap_size = 0;
+  for (int addr = 0; addr < n; addr++) {
+    char* identifier = ram_image_identifier_of(memory, addr);
+    const struct RAM_VALUE* value = ram_peek_cell_by_addr(memory, addr);
+
+    if (identifier != NULL) {
+      heap_size += strlen(identifier) + 1;
+    }
+    if (value->value_type == RAM_TYPE_STR && value->types.s != NULL) {
+      heap_size += strlen(value->types.s) + 1;
+    }
+  }
+
+  struct RAM_IMAGE_HEADER header;
+  memset(&header, 0, sizeof(header));
+  header.magic = RAM_IMAGE_MAGIC;
+  header.version = RAM_IMAGE_VERSION;
+  header.num_values = n;
+  header.index_size = index_size;
+  header.cells_offset = ram_image_align(sizeof(struct RAM_IMAGE_HEADER));
+  header.index_offset = ram_image_align(header.cells_offset + (uint64_t)n * sizeof(struct RAM_IMAGE_CELL));
+  header.heap_offset = ram_image_align(header.index_offset + (uint64_t)index_size * sizeof(int32_t));
+  header.heap_size = heap_size;
+  header.file_size = ram_image_align(header.heap_offset + heap_size);
+
+  // Step 2: build the whole image, then write it in one go
+  char* buffer = (char*)calloc(header.file_size, 1);
+  if (buffer == NULL) {
+    return false;
+  }
+
+  memcpy(buffer, &header, sizeof(header));
+  struct RAM_IMAGE_CELL* cells = (struct RAM_IMAGE_CELL*)(buffer + header.cells_offset);
+  int32_t* index = (int32_t*)(buffer + header.index_offset);
+  char* heap = buffer + header.heap_offset;
+
+  for (int32_t slot = 0; slot < index_size; slot++) {
+    index[slot] = -1;
+  }
+
+  uint64_t used = 0;
+  for (int addr = 0; addr < n; addr++) {
+    char* identifier = ram_image_identifier_of(memory, addr);
+    const struct RAM_VALUE* value = ram_peek_cell_by_addr(memory, addr);
+    struct RAM_IMAGE_CELL* cell = &cells[addr];
+
+    cell->identifier = ram_image_put_str(heap, &used, identifier);
+    cell->value_type = value->value_type;
+
+    if (value->value_type == RAM_TYPE_REAL) {
+      cell->payload.d = value->types.d;
+    } else if (value->value_type == RAM_TYPE_STR) {
+      cell->payload.s = ram_image_put_str(heap, &used, value->types.s);
+    } else {
+      cell->payload.i = value->types.i;
+    }
+
+    if (identifier != NULL) {
+      uint32_t slot = ram_image_hash(identifier) & (uint32_t)(index_size - 1);
+      while (index[slot] != -1) {
+        slot = (slot + 1) & (uint32_t)(index_size - 1);
+      }
+      index[slot] = addr;
+    }
+  }
+
+  // Step 3: write it out
+  FILE* output = fopen(filename, "wb");
+  if (output == NULL) {
+    free(buffer);
+    return false;
+  }
+
+  bool written = (fwrite(buffer, 1, header.file_size, output) == header.file_size);
+  written = (fclose(output) == 0) && written;
+
+  free(buffer);
+  return written;
+}
+
+
+//
+// ram_image_open
+//
+// Maps the given image file into memory, in the given mode. Returns
+// NULL if the file cannot be mapped or is not a valid image. Only
+// the header is checked, the cells are decoded as they are read.
+//
+struct RAM_IMAGE* ram_image_open(char* filename, int mode)
+{
+  // Step 1: map the whole file
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || (uint64_t)info.st_size < sizeof(struct RAM_IMAGE_HEADER)) {
+    close(fd);
+    return NULL;
+  }
+
+  size_t size = (size_t)info.st_size;
+  void* base;
+  if (mode == RAM_IMAGE_PRIVATE) {
+    base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  } else {
+    base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);  // the mapping keeps the file open
+
+  if (base == MAP_FAILED) {
+    return NULL;
+  }
+
+  // Step 2: is it an image we can read, with every section inside the file?
+  struct RAM_IMAGE_HEADER* header = (struct RAM_IMAGE_HEADER*)base;
+  int32_t index_size = header->index_size;
+
+  bool valid = header->magic == RAM_IMAGE_MAGIC &&
+               header->version == RAM_IMAGE_VERSION &&
+               header->file_size == size &&
+               header->num_values >= 0 &&
+               index_size >= 8 && (index_size & (index_size - 1)) == 0 &&
+               index_size >= 2 * (int64_t)header->num_values &&
+               header->cells_offset % 8 == 0 && header->index_offset % 8 == 0 &&
+               header->cells_offset >= sizeof(struct RAM_IMAGE_HEADER) &&
+               header->cells_offset + (uint64_t)header->num_values * sizeof(struct RAM_IMAGE_CELL) <= header->index_offset &&
+               header->index_offset + (uint64_t)index_size * sizeof(int32_t) <= header->heap_offset &&
+               header->heap_offset <= size &&
+               header->heap_size <= size - header->heap_offset;
+
+  // strings can only run off the end of the heap if its last byte is not a terminator
+  if (valid && header->heap_size > 0) {
+    valid = ((char*)base)[header->heap_offset + header->heap_size - 1] == '\0';
+  }
+
+  if (!valid) {
+    munmap(base, size);
+    return NULL;
+  }
+
+  // Step 3: the image is just pointers into the mapping
+  struct RAM_IMAGE* image = (struct RAM_IMAGE*)malloc(sizeof(struct RAM_IMAGE));
+  if (image == NULL) {
+    munmap(base, size);
+    return NULL;
+  }
+
+  image->base = base;
+  image->size = size;
+  image->mode = mode;
+  image->header = header;
+  image->cells = (struct RAM_IMAGE_CELL*)((char*)base + header->cells_offset);
+  image->index = (int32_t*)((char*)base + header->index_offset);
+  image->heap = (char*)base + header->heap_offset;
+
+  return image;
+}
+
+
+//
+// ram_image_close
+//
+// Unmaps the image. After the call returns, you cannot use it, nor
+// any string read from it.
+//
+void ram_image_close(struct RAM_IMAGE* image)
+{
+  if (image == NULL) {
+    return;
+  }
+
+  munmap(image->base, image->size);
+  free(image);
+}
+
+
+//
+// ram_image_num_values
+//
+// Returns the # of values in the image.
+//
+int ram_image_num_values(struct RAM_IMAGE* image)
+{
+  return image->header->num_values;
+}
+
+
+//
+// ram_image_identifier
+//
+// Returns the name of the variable at the given address, or NULL
+// if the address is invalid.
+//
+char* ram_image_identifier(struct RAM_IMAGE* image, int address)
+{
+  if (address < 0 || address >= image->header->num_values) {
+    return NULL;
+  }
+
+  return ram_image_str(image, image->cells[address].identifier);
+}
+
+
+//
+// ram_image_get_addr
+//
+// Returns the address of the variable with the given name, or -1
+// if the image holds no such variable.
+//
+int ram_image_get_addr(struct RAM_IMAGE* image, char* name)
+{
+  uint32_t mask = (uint32_t)(image->header->index_size - 1);
+  uint32_t slot = ram_image_hash(name) & mask;
+
+  // the index is never full, so there is always an empty slot to stop at
+  for (int32_t probes = 0; probes < image->header->index_size; probes++) {
+    int32_t addr = image->index[slot];
+    if (addr == -1) {
+      break;
+    }
+
+    char* identifier = ram_image_identifier(image, addr);
+    if (identifier != NULL && strcmp(identifier, name) == 0) {
+      return addr;
+    }
+
+    slot = (slot + 1) & mask;
+  }
+
+  return -1;
+}
+
+
+//
+// ram_image_read_by_addr
+//
+// Returns the value at the given address, NULL if the address is
+// invalid. The caller frees the returned value with free; a string
+// value points into the mapping.
+//
+struct RAM_VALUE* ram_image_read_by_addr(struct RAM_IMAGE* image, int address)
+{
+  if (address < 0 || address >= image->header->num_values) {
+    return NULL;
+  }
+
+  struct RAM_VALUE* value = (struct RAM_VALUE*)malloc(sizeof(struct RAM_VALUE));
+  if (value == NULL) {
+    //printf("ERROR: OUT OF MEMORY\n");
+    exit(1);
+  }
+
+  *value = ram_image_value(image, &image->cells[address]);
+  return value;
+}
+
+
+//
+// ram_image_read_by_name
+//
+// Like ram_image_read_by_addr, for the variable with the given name.
+//
+struct RAM_VALUE* ram_image_read_by_name(struct RAM_IMAGE* image, char* name)
+{
+  return ram_image_read_by_addr(image, ram_image_get_addr(image, name));
+}
+
+
+//
+// ram_image_write_by_addr
+//
+// Writes the given (non-string) value to the given address of an
+// image opened RAM_IMAGE_PRIVATE. Returns true if successful, false
+// otherwise.
+//
+bool ram_image_write_by_addr(struct RAM_IMAGE* image, struct RAM_VALUE value, int address)
+{
+  if (image->mode != RAM_IMAGE_PRIVATE) {
+    return false;
+  }
+  if (address < 0 || address >= image->header->num_values) {
+    return false;
+  }
+  if (value.value_type == RAM_TYPE_STR) {
+    return false;
+  }
+
+  struct RAM_IMAGE_CELL* cell = &image->cells[address];
+  cell->value_type = value.value_type;
+
+  if (value.value_type == RAM_TYPE_REAL) {
+    cell->payload.d = value.types.d;
+  } else {
+    cell->payload.i = value.types.i;
+  }
+
+  return true;
+}
+
+
+//
+// ram_image_load
+//
+// Returns a new memory holding a copy of every variable in the
+// image, at the same addresses. Returns NULL if out of memory or
+// the image has a cell without a name.
+//
+struct RAM* ram_image_load(struct RAM_IMAGE* image)
+{
+  int n = image->header->num_values;
+
+  struct RAM* memory = ram_init_with_capacity(n);
+  if (memory == NULL) {
+    return NULL;
+  }
+
+  // variables are created in address order, so each lands where it was
+  for (int addr = 0; addr < n; addr++) {
+    char* identifier = ram_image_identifier(image, addr);
+
+    if (identifier == NULL ||
+        !ram_write_cell_by_name(memory, ram_image_value(image, &image->cells[addr]), identifier)) {
+      ram_destroy(memory);
+      return NULL;
+    }
+  }
+
+  return memory;
+}
+
+
+//
+// ram_image_print
+//
+// Prints the image to the console, in the format of ram_print.
+//
+void ram_image_print(struct RAM_IMAGE* image)
+{
+  struct RAM_DUMP_OPTIONS options;
+  struct RAM_DUMP dump;
+
+  ram_dump_options_init(&options);
+  ram_dump_begin(&dump, &options, stdout);
+  ram_dump_header(&dump, "IMAGE", -1, image->header->num_values);
+
+  for (int i = 0; i < image->header->num_values; i++)
+  {
+    struct RAM_VALUE value = ram_image_value(image, &image->cells[i]);
+
+    ram_dump_row(&dump, i, ram_image_identifier(image, i), &value);
+  }
+
+  ram_dump_end(&dump);
+}
@@ -0,0 +1,184 @@
+/*ram_image.h*/
+
+//
+// Saving memory to a binary image file, and mapping an image back
+// in with mmap. An image is relocatable: it holds no pointers, only
+// offsets, so opening one does not parse or fix up anything --- the
+// header is checked, and every read goes straight to the mapping.
+//
+// File layout (native byte order, every section 8-byte aligned):
+//
+//   struct RAM_IMAGE_HEADER
+//   struct RAM_IMAGE_CELL  cells[num_values]
+//   int32_t                index[index_size]   // hash of identifier -> address, -1 empty
+//   char                   heap[heap_size]     // identifiers and strings, null-terminated
+//
+// Irene Ha
+// Northwestern University
+// CS 211
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+#include <stdint.h>   // int32_t, uint64_t
+
+#include "ram.h"
+
+
+#define RAM_IMAGE_MAGIC   0x4D415255u  // "URAM" on little-endian machines
+#define RAM_IMAGE_VERSION 1
+
+//
+// offset of "no string", e.g. a str value that is NULL
+//
+#define RAM_IMAGE_NO_STR UINT64_MAX
+
+struct RAM_IMAGE_HEADER
+{
+  uint32_t magic;         // RAM_IMAGE_MAGIC
+  uint32_t version;       // RAM_IMAGE_VERSION
+  int32_t  num_values;
+  int32_t  index_size;    // power of two, >= 2 * num_values
+  uint64_t cells_offset;  // offsets are from the start of the file
+  uint64_t index_offset;
+  uint64_t heap_offset;
+  uint64_t heap_size;
+  uint64_t file_size;
+};
+
+struct RAM_IMAGE_CELL
+{
+  uint64_t identifier;    // heap offset
+  int32_t  value_type;    // enum RAM_VALUE_TYPES
+  int32_t  unused;
+  union
+  {
+    int64_t  i;           // INT, PTR, BOOLEAN
+    double   d;           // REAL
+    uint64_t s;           // STR, heap offset
+  } payload;
+};
+
+//
+// How an image is mapped:
+//
+//   RAM_IMAGE_READONLY: shared read-only mapping, writes are refused
+//   RAM_IMAGE_PRIVATE:  copy-on-write mapping, ram_image_write_by_addr
+//                       changes the mapped copy, never the file
+//
+enum RAM_IMAGE_MODES
+{
+  RAM_IMAGE_READONLY = 0,
+  RAM_IMAGE_PRIVATE
+};
+
+struct RAM_IMAGE
+{
+  void*  base;            // the mapping
+  size_t size;
+  int    mode;            // enum RAM_IMAGE_MODES
+
+  struct RAM_IMAGE_HEADER* header;
+  struct RAM_IMAGE_CELL*   cells;
+  int32_t*                 index;
+  char*                    heap;
+};
+
+
+//
+// ram_image_save
+//
+// Writes the contents of memory to the given file as an image,
+// replacing the file if it exists. Returns true if successful,
+// false if the file could not be written.
+//
+bool ram_image_save(struct RAM* memory, char* filename);
+
+//
+// ram_image_open
+//
+// Maps the given image file into memory, in the given mode (enum
+// RAM_IMAGE_MODES). Returns NULL if the file cannot be mapped or is
+// not an image written by this version. Takes constant time, no
+// matter how many values the image holds.
+//
+struct RAM_IMAGE* ram_image_open(char* filename, int mode);
+
+//
+// ram_image_close
+//
+// Unmaps the image. After the call returns, you cannot use it, nor
+// any string read from it.
+//
+void ram_image_close(struct RAM_IMAGE* image);
+
+//
+// ram_image_num_values
+//
+// Returns the # of values in the image.
+//
+int ram_image_num_values(struct RAM_IMAGE* image);
+
+//
+// ram_image_identifier
+//
+// Returns the name of the variable at the given address, or NULL
+// if the address is invalid. The string lives in the mapping.
+//
+char* ram_image_identifier(struct RAM_IMAGE* image, int address);
+
+//
+// ram_image_get_addr
+//
+// Returns the address of the variable with the given name, or -1
+// if the image holds no such variable.
+//
+int ram_image_get_addr(struct RAM_IMAGE* image, char* name);
+
+//
+// ram_image_read_by_addr
+//
+// Returns the value at the given address. A string value points
+// into the mapping: it is valid until the image is closed, and
+// must not be modified or freed. Returns NULL if the address is
+// invalid, else a pointer to a value the caller must free (but
+// NOT with ram_free_value, which would free the string too ---
+// use free).
+//
+struct RAM_VALUE* ram_image_read_by_addr(struct RAM_IMAGE* image, int address);
+
+//
+// ram_image_read_by_name
+//
+// Like ram_image_read_by_addr, for the variable with the given name.
+//
+struct RAM_VALUE* ram_image_read_by_name(struct RAM_IMAGE* image, char* name);
+
+//
+// ram_image_write_by_addr
+//
+// Writes the given value to the given address of an image opened
+// RAM_IMAGE_PRIVATE; the file itself is never changed. Strings
+// cannot be written, the string heap of an image is fixed.
+// Returns true if successful, false if the image is read-only,
+// the address is invalid, or the value is a string.
+//
+bool ram_image_write_by_addr(struct RAM_IMAGE* image, struct RAM_VALUE value, int address);
+
+//
+// ram_image_load
+//
+// Returns a new memory holding a copy of every variable in the
+// image, at the same addresses, so a run can be resumed from it.
+// The memory must be freed with ram_destroy; it does not depend
+// on the image. Returns NULL if out of memory.
+//
+struct RAM* ram_image_load(struct RAM_IMAGE* image);
+
+//
+// ram_image_print
+//
+// Prints the image to the console, in the format of ram_print.
+//
+void ram_image_print(struct RAM_IMAGE* image);
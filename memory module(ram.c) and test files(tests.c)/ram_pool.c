@@ -0,0 +1,142 @@
+/*ram_pool.c*/
+
+//
+// A lock-free pool of memories, see ram_pool.h.
+//
+// Irene Ha
+// Northwestern University
+// CS 211
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+
+#include "ram_pool.h"
+#include "ram.h"
+
+
+//
+// Public functions:
+//
+
+//
+// ram_pool_create
+//
+// Returns a new, empty pool that holds up to size memories.
+//
+struct RAM_POOL* ram_pool_create(int size, int capacity)
+{
+  if (size < 1) {
+    size = 1;
+  }
+
+  struct RAM_POOL* pool = (struct RAM_POOL*)malloc(sizeof(struct RAM_POOL));
+  if (pool == NULL) {
+    return NULL;
+  }
+
+  pool->slots = (struct RAM**)calloc(size, sizeof(struct RAM*));
+  if (pool->slots == NULL) {
+    free(pool);
+    return NULL;
+  }
+
+  pool->size = size;
+  pool->capacity = capacity;
+  pool->next = 0;
+  pool->created = 0;
+  pool->reused = 0;
+
+  ram_threads_enable();  // memories may be acquired by other threads
+
+  return pool;
+}
+
+
+//
+// ram_pool_destroy
+//
+// Destroys every memory in the pool, and the pool.
+//
+void ram_pool_destroy(struct RAM_POOL* pool)
+{
+  if (pool == NULL) {
+    return;
+  }
+
+  for (int i = 0; i < pool->size; i++) {
+    ram_destroy(pool->slots[i]);
+  }
+
+  free(pool->slots);
+  free(pool);
+}
+
+
+//
+// ram_pool_acquire
+//
+// Returns an empty memory, from the pool if it has one. Threads
+// start their scans at different slots, so they rarely compete for
+// the same one; a slot is emptied with an atomic exchange, so only
+// one of them can get the memory in it.
+//
+struct RAM* ram_pool_acquire(struct RAM_POOL* pool)
+{
+  // Step 1: take the first memory found in the pool
+  unsigned int start = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED);
+
+  for (int i = 0; i < pool->size; i++) {
+    struct RAM** slot = &pool->slots[(start + i) % pool->size];
+
+    if (__atomic_load_n(slot, __ATOMIC_RELAXED) == NULL) {
+      continue;  // cheap check first, no write to the cache line
+    }
+
+    // acquire pairs with the release in ram_pool_release, so the
+    // reset done by the releasing thread is seen here
+    struct RAM* memory = __atomic_exchange_n(slot, NULL, __ATOMIC_ACQUIRE);
+    if (memory != NULL) {
+      __atomic_fetch_add(&pool->reused, 1, __ATOMIC_RELAXED);
+      return memory;
+    }
+  }
+
+  // Step 2: the pool is empty, make a new one
+  __atomic_fetch_add(&pool->created, 1, __ATOMIC_RELAXED);
+  return ram_init_with_capacity(pool->capacity);
+}
+
+
+//
+// ram_pool_release
+//
+// Resets the memory and puts it in the first empty slot found, or
+// destroys it if there is none.
+//
+void ram_pool_release(struct RAM_POOL* pool, struct RAM* memory)
+{
+  if (memory == NULL) {
+    return;
+  }
+
+  // Step 1: reset while the memory is still ours alone
+  ram_reset(memory);
+
+  // Step 2: publish it in an empty slot
+  unsigned int start = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED);
+
+  for (int i = 0; i < pool->size; i++) {
+    struct RAM** slot = &pool->slots[(start + i) % pool->size];
+    struct RAM* empty = NULL;
+
+    if (__atomic_load_n(slot, __ATOMIC_RELAXED) == NULL &&
+        __atomic_compare_exchange_n(slot, &empty, memory, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+      return;
+    }
+  }
+
+  // Step 3: the pool is full
+  ram_destroy(memory);
+}
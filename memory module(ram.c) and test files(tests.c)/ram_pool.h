@@ -0,0 +1,75 @@
+/*ram_pool.h*/
+
+//
+// A pool of memories for running many short programs: instead of
+// being destroyed, a memory is reset (see ram_reset) and handed out
+// again, so a run starts with cells, an index and a string arena that
+// are already allocated and already grown to what earlier runs needed.
+//
+// The pool itself is safe to share between threads and takes no lock:
+// each slot holds a memory or NULL, and memories move in and out of
+// the slots with atomic exchanges. A memory handed out belongs to the
+// thread that acquired it until it is released. What the memories
+// still share, the intern pool (intern.h) and the registry of shared
+// strings, is locked stripe by stripe once the first pool is created
+// (see ram_threads_enable), so memories in different threads may
+// intern names and exchange strings freely. Names stay in the intern
+// pool until the last memory is destroyed, resetting a memory never
+// touches it.
+//
+// Irene Ha
+// Northwestern University
+// CS 211
+//
+
+#pragma once
+
+#include "ram.h"
+
+
+struct RAM_POOL
+{
+  struct RAM** slots;  // size slots, each a pooled memory or NULL
+  int size;
+  int capacity;        // capacity of the memories the pool creates
+  unsigned int next;   // slot the next scan starts at
+  int created;         // # of memories created by ram_pool_acquire
+  int reused;          // # of memories ram_pool_acquire took from the pool
+};
+
+
+//
+// ram_pool_create
+//
+// Returns a new, empty pool that holds up to size memories. Memories
+// it creates have room for the given # of values, see
+// ram_init_with_capacity. Returns NULL if out of memory.
+//
+struct RAM_POOL* ram_pool_create(int size, int capacity);
+
+//
+// ram_pool_destroy
+//
+// Destroys every memory in the pool, and the pool. Memories still
+// acquired are not affected, but can no longer be released to the
+// pool (destroy them with ram_destroy). No other thread may be using
+// the pool.
+//
+void ram_pool_destroy(struct RAM_POOL* pool);
+
+//
+// ram_pool_acquire
+//
+// Returns an empty memory, taken from the pool if it has one, else
+// newly created. Returns NULL if out of memory.
+//
+struct RAM* ram_pool_acquire(struct RAM_POOL* pool);
+
+//
+// ram_pool_release
+//
+// Resets the given memory and puts it back in the pool, or destroys
+// it if the pool is full. After the call returns, you cannot use the
+// memory.
+//
+void ram_pool_release(struct RAM_POOL* pool, struct RAM* memory);
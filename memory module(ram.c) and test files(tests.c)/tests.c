@@ -13,8 +13,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>  // INT_MIN
+#include <math.h>    // INFINITY, NAN
+#include <unistd.h>  // close
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <cmath>
 
 #include "ram.h"
+#include "intern.h"
+#include "ram_image.h"
+#include "ram_dump.h"
+#include "ram_pool.h"
 #include "gtest/gtest.h"
 
 //
@@ -774,4 +786,1428 @@ TEST(memory_module, get_addr_skipped_a_house) //* attempt at test 2
   ASSERT_TRUE(ram_get_addr(memory, "key2") == 1);
 
   ram_destroy(memory);
-}
\ No newline at end of file
+}
+
+TEST(memory_module, get_addr_many_identifiers_through_index)
+{
+  struct RAM* memory = ram_init();
+
+  struct RAM_VALUE value;
+  value.value_type = RAM_TYPE_INT;
+
+  // write enough identifiers to force the index to be rebuilt many times
+  for (int i = 0; i < 10000; i++) {
+    value.types.i = i;
+    char key[16];
+    snprintf(key, sizeof(key), "v%d", i);
+    ASSERT_TRUE(ram_write_cell_by_name(memory, value, key));
+  }
+
+  ASSERT_EQ(memory->num_values, 10000);
+  ASSERT_TRUE(memory->index_capacity >= 2 * memory->capacity);
+
+  // addresses are still handed out in the order the names were written
+  for (int i = 0; i < 10000; i++) {
+    char key[16];
+    snprintf(key, sizeof(key), "v%d", i);
+    ASSERT_EQ(ram_get_addr(memory, key), i);
+  }
+
+  ASSERT_EQ(ram_get_addr(memory, "v10000"), -1);
+  ASSERT_EQ(ram_get_addr(memory, "v"), -1);
+
+  // overwriting by name must not hand out a new address
+  value.types.i = -1;
+  ASSERT_TRUE(ram_write_cell_by_name(memory, value, "v5000"));
+  ASSERT_EQ(memory->num_values, 10000);
+  ASSERT_EQ(ram_get_addr(memory, "v5000"), 5000);
+  ASSERT_EQ(memory->cells[5000].value.types.i, -1);
+
+  ram_destroy(memory);
+}
+
+
+TEST(memory_module, peek_borrows_without_copying)
+{
+  struct RAM* memory = ram_init();
+
+  struct RAM_VALUE value;
+  value.value_type = RAM_TYPE_STR;
+  value.types.s = "borrowed";
+
+  ASSERT_TRUE(ram_write_cell_by_name(memory, value, "s"));
+
+  // peek hands back the cell itself, not a copy
+  const struct RAM_VALUE* by_name = ram_peek_cell_by_name(memory, "s");
+  const struct RAM_VALUE* by_addr = ram_peek_cell_by_addr(memory, 0);
+  ASSERT_TRUE(by_name != NULL);
+  ASSERT_TRUE(by_name == by_addr);
+  ASSERT_TRUE(by_name == &memory->cells[0].value);
+  ASSERT_TRUE(by_name->types.s == memory->cells[0].value.types.s);
+  ASSERT_STREQ(by_name->types.s, "borrowed");
+
+  ASSERT_TRUE(ram_peek_cell_by_name(memory, "t") == NULL);
+  ASSERT_TRUE(ram_peek_cell_by_addr(memory, 1) == NULL);
+  ASSERT_TRUE(ram_peek_cell_by_addr(memory, -1) == NULL);
+
+  // writing a borrowed string back into the cell it came from (s = s)
+  ASSERT_TRUE(ram_write_cell_by_name(memory, *by_name, "s"));
+  ASSERT_STREQ(memory->cells[0].value.types.s, "borrowed");
+
+  by_addr = ram_peek_cell_by_addr(memory, 0);
+  ASSERT_TRUE(ram_write_cell_by_addr(memory, *by_addr, 0));
+  ASSERT_STREQ(memory->cells[0].value.types.s, "borrowed");
+
+  ram_destroy(memory);
+}
+
+
+TEST(memory_module, identifiers_are_interned)
+{
+  struct RAM* memory1 = ram_init();
+  struct RAM* memory2 = ram_init();
+
+  struct RAM_VALUE value;
+  value.value_type = RAM_TYPE_INT;
+  value.types.i = 7;
+
+  char name[] = "shared_name";  // not a canonical copy
+
+  ASSERT_TRUE(ram_write_cell_by_name(memory1, value, name));
+  ASSERT_TRUE(ram_write_cell_by_name(memory2, value, name));
+
+  // both memories point at the one interned copy, not at name
+  char* interned = intern_find(name);
+  ASSERT_TRUE(interned != NULL);
+  ASSERT_TRUE(interned != name);
+  ASSERT_TRUE(intern_is_canonical(interned));
+  ASSERT_FALSE(intern_is_canonical(name));
+  ASSERT_TRUE(memory1->cells[0].identifier == interned);
+  ASSERT_TRUE(memory2->cells[0].identifier == interned);
+  ASSERT_TRUE(intern(name) == interned);
+  intern_release(interned);  // the reference intern just added
+
+  // lookups work with either the canonical copy or any equal string
+  ASSERT_EQ(ram_get_addr(memory1, interned), 0);
+  ASSERT_EQ(ram_get_addr(memory1, name), 0);
+
+  // interned somewhere else but never written to this memory
+  char* pooled = intern("only_in_the_pool");
+  ASSERT_TRUE(pooled != NULL);
+  ASSERT_EQ(ram_get_addr(memory1, "only_in_the_pool"), -1);
+  ASSERT_TRUE(intern_find("never_seen_anywhere") == NULL);
+  ASSERT_EQ(ram_get_addr(memory1, "never_seen_anywhere"), -1);
+
+  // the last reference gone, the name leaves the pool
+  intern_release(pooled);
+  ASSERT_TRUE(intern_find("only_in_the_pool") == NULL);
+
+  // releasing a string that was never interned does nothing
+  intern_release((char*)"never_seen_anywhere");
+  ASSERT_TRUE(intern_find("never_seen_anywhere") == NULL);
+
+  // resetting a memory keeps its names in the pool, only the last
+  // memory to go takes them out
+  ASSERT_TRUE(ram_write_cell_by_name(memory1, value, "reset_name"));
+  ram_reset(memory1);
+  ASSERT_EQ(ram_get_addr(memory1, "reset_name"), -1);
+  ASSERT_TRUE(intern_find("reset_name") != NULL);
+
+  // destroying one memory leaves the other's identifier intact
+  ram_destroy(memory1);
+  ASSERT_STREQ(memory2->cells[0].identifier, "shared_name");
+
+  // a snapshot keeps the name after its memory is gone
+  struct RAM_SNAPSHOT* snapshot = ram_snapshot(memory2);
+  ram_destroy(memory2);
+  ASSERT_TRUE(intern_find(name) == interned);
+  ASSERT_EQ(ram_snapshot_peek_by_name(snapshot, name)->types.i, 7);
+
+  ram_snapshot_release(snapshot);
+  ASSERT_TRUE(intern_find(name) == NULL);
+  ASSERT_TRUE(intern_find("reset_name") == NULL);
+}
+
+
+TEST(memory_module, addresses_by_slot)
+{
+  struct RAM* memory = ram_init();
+
+  struct RAM_VALUE i;
+  i.value_type = RAM_TYPE_INT;
+  i.types.i = 1;
+
+  char* x = intern("x");
+  char* y = intern("y");
+
+  ASSERT_EQ(ram_get_addr_by_slot(memory, 0, x), -1);
+  ASSERT_EQ(ram_get_addr_by_slot(memory, -1, x), -1);
+
+  // a variable written by name before is found by slot, and remembered
+  ASSERT_TRUE(ram_write_cell_by_name(memory, i, "y"));
+  ASSERT_TRUE(ram_write_cell_by_name(memory, i, "x"));
+  ASSERT_EQ(ram_get_addr_by_slot(memory, 0, x), 1);
+  ASSERT_EQ(ram_get_addr_by_slot(memory, 40, y), 0);  // the table grows
+  ASSERT_EQ(memory->slot_addrs[0], 1);
+  ASSERT_EQ(ram_get_addr_by_slot(memory, 0, x), 1);
+
+  // a remembered address is checked before it is used again
+  ASSERT_TRUE(ram_begin(memory));
+  ASSERT_TRUE(ram_write_cell_by_name(memory, i, "z"));
+  ASSERT_EQ(ram_get_addr_by_slot(memory, 1, intern("z")), 2);
+  ASSERT_TRUE(ram_rollback(memory));
+  ASSERT_EQ(ram_get_addr_by_slot(memory, 1, intern("z")), -1);
+  ASSERT_TRUE(ram_write_cell_by_name(memory, i, "w"));
+  ASSERT_EQ(ram_get_addr_by_slot(memory, 1, intern("z")), -1);
+
+  ram_reset(memory);
+  ASSERT_EQ(ram_get_addr_by_slot(memory, 0, x), -1);
+  ASSERT_TRUE(ram_write_cell_by_name(memory, i, "x"));
+  ASSERT_EQ(ram_get_addr_by_slot(memory, 0, x), 0);
+
+  ram_destroy(memory);
+}
+
+TEST(memory_module, short_strings_stored_inline)
+{
+  struct RAM* memory = ram_init();
+
+  struct RAM_VALUE short_str;
+  short_str.value_type = RAM_TYPE_STR;
+  short_str.types.s = "fits";
+
+  struct RAM_VALUE long_str;
+  long_str.value_type = RAM_TYPE_STR;
+  long_str.types.s = "this one is too long to fit inline";
+
+  ASSERT_TRUE(ram_write_cell_by_name(memory, short_str, "a"));
+  ASSERT_TRUE(ram_write_cell_by_name(memory, long_str, "b"));
+
+  // short string lives in the cell, long one on the heap
+  ASSERT_TRUE(memory->cells[0].value.types.s == memory->cells[0].inline_str);
+  ASSERT_TRUE(memory->cells[1].value.types.s != memory->cells[1].inline_str);
+  ASSERT_STREQ(memory->cells[0].value.types.s, "fits");
+  ASSERT_STREQ(memory->cells[1].value.types.s, "this one is too long to fit inline");
+
+  // overwrite inline with heap and heap with inline
+  ASSERT_TRUE(ram_write_cell_by_addr(memory, long_str, 0));
+  ASSERT_TRUE(ram_write_cell_by_addr(memory, short_str, 1));
+  ASSERT_TRUE(memory->cells[0].value.types.s != memory->cells[0].inline_str);
+  ASSERT_TRUE(memory->cells[1].value.types.s == memory->cells[1].inline_str);
+
+  // fill the memory so the next write moves the cells, while writing
+  // a short string borrowed from one of those cells
+  ASSERT_TRUE(ram_write_cell_by_name(memory, short_str, "c"));
+  ASSERT_TRUE(ram_write_cell_by_name(memory, short_str, "d"));
+  ASSERT_EQ(memory->num_values, memory->capacity);
+
+  const struct RAM_VALUE* borrowed = ram_peek_cell_by_name(memory, "b");
+  ASSERT_TRUE(ram_write_cell_by_name(memory, *borrowed, "e"));
+  ASSERT_EQ(memory->capacity, 8);
+
+  // every inline string points into its own (moved) cell
+  for (int i = 1; i < memory->num_values; i++) {
+    ASSERT_TRUE(memory->cells[i].value.types.s == memory->cells[i].inline_str);
+    ASSERT_STREQ(memory->cells[i].value.types.s, "fits");
+  }
+
+  // reads still hand back copies the caller owns
+  struct RAM_VALUE* copy = ram_read_cell_by_name(memory, "e");
+  ASSERT_TRUE(copy != NULL);
+  ASSERT_TRUE(copy->types.s != memory->cells[4].inline_str);
+  ASSERT_STREQ(copy->types.s, "fits");
+  ram_free_value(copy);
+
+  ram_destroy(memory);
+}
+
+TEST(memory_module, long_strings_shared_not_copied)
+{
+  struct RAM* memory = ram_init();
+
+  struct RAM_VALUE long_str;
+  long_str.value_type = RAM_TYPE_STR;
+  long_str.types.s = "a string long enough to live on the heap";
+
+  ASSERT_TRUE(ram_write_cell_by_name(memory, long_str, "s"));
+  char* payload = memory->cells[0].value.types.s;
+  ASSERT_TRUE(payload != long_str.types.s);  // first write copies
+
+  // t = s: writing the borrowed value shares the string
+  const struct RAM_VALUE* borrowed = ram_peek_cell_by_name(memory, "s");
+  ASSERT_TRUE(ram_write_cell_by_name(memory, *borrowed, "t"));
+  ASSERT_TRUE(memory->cells[1].value.types.s == payload);
+
+  // a read copy shares it too, and so does writing the copy back
+  struct RAM_VALUE* copy = ram_read_cell_by_name(memory, "t");
+  ASSERT_TRUE(copy != NULL);
+  ASSERT_TRUE(copy->types.s == payload);
+  ASSERT_TRUE(ram_write_cell_by_name(memory, *copy, "u"));
+  ASSERT_TRUE(memory->cells[2].value.types.s == payload);
+
+  // overwriting s leaves t, u and the copy intact
+  struct RAM_VALUE i;
+  i.value_type = RAM_TYPE_INT;
+  i.types.i = 123;
+  ASSERT_TRUE(ram_write_cell_by_name(memory, i, "s"));
+  ASSERT_STREQ(memory->cells[1].value.types.s, "a string long enough to live on the heap");
+  ASSERT_STREQ(copy->types.s, "a string long enough to live on the heap");
+
+  // the copy outlives the memory it came from
+  ram_destroy(memory);
+  ASSERT_STREQ(copy->types.s, "a string long enough to live on the heap");
+  ram_free_value(copy);
+}
+
+TEST(memory_module, soa_layout_behaves_like_cells)
+{
+  ASSERT_TRUE(ram_init_layout(42) == NULL);
+
+  struct RAM* cells = ram_init_layout(RAM_LAYOUT_CELLS);
+  struct RAM* soa = ram_init_layout(RAM_LAYOUT_SOA);
+  ASSERT_TRUE(soa != NULL);
+  ASSERT_TRUE(soa->cells == NULL);
+
+  // same writes to both, enough to grow a few times
+  char name[32];
+  for (int i = 0; i < 100; i++) {
+    struct RAM_VALUE value;
+    snprintf(name, sizeof(name), "v%d", i);
+
+    if (i % 3 == 0) {
+      value.value_type = RAM_TYPE_INT;
+      value.types.i = i;
+    } else if (i % 3 == 1) {
+      value.value_type = RAM_TYPE_REAL;
+      value.types.d = i / 4.0;
+    } else {
+      value.value_type = RAM_TYPE_STR;
+      value.types.s = (i % 2 == 0) ? (char*) "short" : (char*) "a string too long to be stored inline";
+    }
+
+    ASSERT_TRUE(ram_write_cell_by_name(cells, value, name));
+    ASSERT_TRUE(ram_write_cell_by_name(soa, value, name));
+  }
+
+  // overwrite a string by address with a borrowed string
+  const struct RAM_VALUE* borrowed = ram_peek_cell_by_name(soa, "v5");
+  ASSERT_TRUE(ram_write_cell_by_addr(soa, *borrowed, 2));
+  borrowed = ram_peek_cell_by_name(cells, "v5");
+  ASSERT_TRUE(ram_write_cell_by_addr(cells, *borrowed, 2));
+
+  ASSERT_EQ(soa->num_values, cells->num_values);
+  ASSERT_EQ(soa->capacity, cells->capacity);
+
+  for (int i = 0; i < 100; i++) {
+    snprintf(name, sizeof(name), "v%d", i);
+    ASSERT_EQ(ram_get_addr(soa, name), i);
+
+    struct RAM_VALUE* a = ram_read_cell_by_addr(cells, i);
+    struct RAM_VALUE* b = ram_read_cell_by_name(soa, name);
+    ASSERT_TRUE(a != NULL && b != NULL);
+    ASSERT_EQ(a->value_type, b->value_type);
+
+    if (a->value_type == RAM_TYPE_INT) {
+      ASSERT_EQ(a->types.i, b->types.i);
+    } else if (a->value_type == RAM_TYPE_REAL) {
+      ASSERT_DOUBLE_EQ(a->types.d, b->types.d);
+    } else {
+      ASSERT_STREQ(a->types.s, b->types.s);
+    }
+
+    ram_free_value(a);
+    ram_free_value(b);
+  }
+
+  ASSERT_FALSE(ram_write_cell_by_addr(soa, *ram_peek_cell_by_addr(soa, 0), 100));
+  ASSERT_TRUE(ram_peek_cell_by_addr(soa, 100) == NULL);
+
+  ram_destroy(cells);
+  ram_destroy(soa);
+}
+
+TEST(memory_module, init_with_capacity_never_grows)
+{
+  struct RAM* small = ram_init_with_capacity(0);
+  ASSERT_EQ(small->capacity, 4);
+  ram_destroy(small);
+
+  struct RAM* memory = ram_init_with_capacity(100);
+  ASSERT_EQ(memory->capacity, 100);
+  ASSERT_EQ(memory->num_values, 0);
+
+  struct RAM_CELL* cells = memory->cells;
+
+  struct RAM_VALUE value;
+  value.value_type = RAM_TYPE_INT;
+
+  char name[32];
+  for (int i = 0; i < 100; i++) {
+    value.types.i = i;
+    snprintf(name, sizeof(name), "v%d", i);
+    ASSERT_TRUE(ram_write_cell_by_name(memory, value, name));
+  }
+
+  // all 100 fit, the cells never moved
+  ASSERT_EQ(memory->capacity, 100);
+  ASSERT_TRUE(memory->cells == cells);
+  ASSERT_EQ(ram_get_addr(memory, "v99"), 99);
+
+  // one more still grows as usual
+  ASSERT_TRUE(ram_write_cell_by_name(memory, value, "extra"));
+  ASSERT_EQ(memory->capacity, 200);
+  ASSERT_EQ(ram_get_addr(memory, "v42"), 42);
+  ASSERT_EQ(ram_get_addr(memory, "extra"), 100);
+
+  ram_destroy(memory);
+}
+
+struct HOOK_LOG
+{
+  int calls;
+  int last_address;
+  int last_int;
+};
+
+static void log_write(struct RAM* memory, int address, const struct RAM_VALUE* value, void* context)
+{
+  struct HOOK_LOG* log = (struct HOOK_LOG*) context;
+  log->calls++;
+  log->last_address = address;
+  log->last_int = value->types.i;
+}
+
+TEST(memory_module, write_hooks)
+{
+  struct RAM* memory = ram_init();
+
+  struct RAM_VALUE value;
+  value.value_type = RAM_TYPE_INT;
+  value.types.i = 1;
+  ASSERT_TRUE(ram_write_cell_by_name(memory, value, "x"));
+
+  struct HOOK_LOG all = { 0, -1, 0 };
+  struct HOOK_LOG only_y = { 0, -1, 0 };
+
+  int all_id = ram_add_write_hook(memory, -1, log_write, &all);
+  ASSERT_TRUE(all_id >= 0);
+  ASSERT_TRUE(ram_add_write_hook(memory, 1, log_write, &only_y) >= 0);  // y will be at 1
+
+  // creating y, then writing it by address, fires both hooks
+  value.types.i = 2;
+  ASSERT_TRUE(ram_write_cell_by_name(memory, value, "y"));
+  ASSERT_EQ(all.calls, 1);
+  ASSERT_EQ(only_y.calls, 1);
+  ASSERT_EQ(only_y.last_int, 2);
+
+  value.types.i = 3;
+  ASSERT_TRUE(ram_write_cell_by_addr(memory, value, 1));
+  ASSERT_EQ(all.calls, 2);
+  ASSERT_EQ(only_y.calls, 2);
+  ASSERT_EQ(only_y.last_int, 3);
+
+  // writing x only fires the global hook
+  value.types.i = 4;
+  ASSERT_TRUE(ram_write_cell_by_name(memory, value, "x"));
+  ASSERT_EQ(all.calls, 3);
+  ASSERT_EQ(all.last_address, 0);
+  ASSERT_EQ(all.last_int, 4);
+  ASSERT_EQ(only_y.calls, 2);
+
+  // a failed write fires nothing, a removed hook is not called again
+  ASSERT_FALSE(ram_write_cell_by_addr(memory, value, 7));
+  ASSERT_EQ(all.calls, 3);
+
+  ASSERT_TRUE(ram_remove_write_hook(memory, all_id));
+  ASSERT_FALSE(ram_remove_write_hook(memory, all_id));
+  ASSERT_TRUE(ram_write_cell_by_name(memory, value, "y"));
+  ASSERT_EQ(all.calls, 3);
+  ASSERT_EQ(only_y.calls, 3);
+
+  ram_destroy(memory);
+}
+
+TEST(memory_module, writes_observed)
+{
+  struct RAM* memory = ram_init();
+
+  struct RAM_VALUE value;
+  value.value_type = RAM_TYPE_INT;
+  value.types.i = 1;
+  ASSERT_TRUE(ram_write_cell_by_name(memory, value, "x"));
+
+#ifdef RAM_STATS
+  ASSERT_TRUE(ram_writes_observed(memory));  // every access is counted
+#else
+  ASSERT_FALSE(ram_writes_observed(memory));
+
+  // each observer, for as long as it is there
+  struct HOOK_LOG log = { 0, -1, 0 };
+  int id = ram_add_write_hook(memory, -1, log_write, &log);
+  ASSERT_TRUE(ram_writes_observed(memory));
+  ASSERT_TRUE(ram_remove_write_hook(memory, id));
+  ASSERT_FALSE(ram_writes_observed(memory));
+
+  ASSERT_TRUE(ram_begin(memory));
+  ASSERT_TRUE(ram_writes_observed(memory));
+  ASSERT_TRUE(ram_commit(memory));
+  ASSERT_FALSE(ram_writes_observed(memory));
+
+  struct RAM_SNAPSHOT* snapshot = ram_snapshot(memory);
+  ASSERT_TRUE(ram_writes_observed(memory));
+  ram_snapshot_release(snapshot);
+  ASSERT_FALSE(ram_writes_observed(memory));
+
+  ASSERT_TRUE(ram_readers_enable(memory));
+  ASSERT_TRUE(ram_writes_observed(memory));
+  ram_readers_disable(memory);
+  ASSERT_FALSE(ram_writes_observed(memory));
+#endif
+
+  ram_destroy(memory);
+}
+
+TEST(memory_module, access_stats)
+{
+  struct RAM* memory = ram_init();
+
+  struct RAM_VALUE value;
+  value.value_type = RAM_TYPE_STR;
+  value.types.s = "hi";
+
+  ASSERT_TRUE(ram_write_cell_by_name(memory, value, "x"));  // new cell, no lookup hit
+  ASSERT_TRUE(ram_write_cell_by_name(memory, value, "x"));  // lookup + write
+  ASSERT_TRUE(ram_peek_cell_by_addr(memory, 0) != NULL);     // read
+  ram_free_value(ram_read_cell_by_name(memory, "x"));       // lookup + read
+
+#ifdef RAM_STATS
+  ASSERT_TRUE(memory->stats != NULL);
+  ASSERT_EQ(memory->stats[0].writes, 2UL);
+  ASSERT_EQ(memory->stats[0].reads, 2UL);
+  ASSERT_EQ(memory->stats[0].lookups, 2UL);
+  ASSERT_EQ(memory->stats[0].str_bytes, 3UL + 3UL + 3UL);  // 2 inline writes, 1 read copy
+#else
+  ASSERT_TRUE(memory->stats == NULL);  // counting compiled out
+#endif
+
+  ram_destroy(memory);
+}
+
+TEST(memory_module, dirty_cells_and_diffs)
+{
+  struct RAM* memory = ram_init();
+  int changed[100];
+
+  struct RAM_VALUE value;
+  value.value_type = RAM_TYPE_INT;
+
+  // epoch 0: create a..j (enough to grow twice)
+  char name[32];
+  for (int i = 0; i < 10; i++) {
+    value.types.i = i;
+    snprintf(name, sizeof(name), "%c", 'a' + i);
+    ASSERT_TRUE(ram_write_cell_by_name(memory, value, name));
+  }
+  ASSERT_EQ(ram_epoch(memory), 0);
+  ASSERT_TRUE(ram_is_dirty(memory, 9));
+  ASSERT_EQ(ram_changed_since(memory, 0, changed), 10);
+
+  // epoch 1: write c twice and h once
+  ASSERT_EQ(ram_next_epoch(memory), 1);
+  ASSERT_FALSE(ram_is_dirty(memory, 2));
+  ASSERT_EQ(ram_changed_since(memory, 1, changed), 0);
+
+  ASSERT_TRUE(ram_write_cell_by_addr(memory, value, 2));
+  ASSERT_TRUE(ram_write_cell_by_name(memory, value, "c"));
+  ASSERT_TRUE(ram_write_cell_by_name(memory, value, "h"));
+  ASSERT_TRUE(ram_is_dirty(memory, 2));
+  ASSERT_FALSE(ram_is_dirty(memory, 3));
+
+  ASSERT_EQ(ram_changed_since(memory, 1, changed), 2);
+  ASSERT_EQ(changed[0], 2);
+  ASSERT_EQ(changed[1], 7);
+
+  // epoch 2: write c again and create k; since epoch 1, c shows up once
+  ASSERT_EQ(ram_next_epoch(memory), 2);
+  ASSERT_FALSE(ram_is_dirty(memory, 2));
+  ASSERT_FALSE(ram_is_dirty(memory, 7));
+
+  ASSERT_TRUE(ram_write_cell_by_name(memory, value, "c"));
+  ASSERT_TRUE(ram_write_cell_by_name(memory, value, "k"));
+
+  ASSERT_EQ(ram_changed_since(memory, 2, changed), 2);
+  ASSERT_EQ(changed[0], 2);
+  ASSERT_EQ(changed[1], 10);
+
+  int n = ram_changed_since(memory, 1, changed);
+  ASSERT_EQ(n, 3);
+  ASSERT_EQ(changed[0], 7);
+  ASSERT_EQ(changed[1], 2);
+  ASSERT_EQ(changed[2], 10);
+
+  // a failed write changes nothing
+  ASSERT_FALSE(ram_write_cell_by_addr(memory, value, 50));
+  ASSERT_FALSE(ram_is_dirty(memory, 50));
+  ASSERT_EQ(ram_changed_since(memory, 2, changed), 2);
+
+  // epoch 3: a cell created, rolled back and created again shows up once
+  ASSERT_EQ(ram_next_epoch(memory), 3);
+  ASSERT_TRUE(ram_begin(memory));
+  ASSERT_TRUE(ram_write_cell_by_name(memory, value, "x"));
+  ASSERT_EQ(ram_changed_since(memory, 3, changed), 1);
+  ASSERT_TRUE(ram_rollback(memory));
+  ASSERT_FALSE(ram_is_dirty(memory, 11));
+  ASSERT_EQ(ram_changed_since(memory, 3, changed), 0);
+
+  ASSERT_TRUE(ram_write_cell_by_name(memory, value, "x"));
+  ASSERT_EQ(ram_changed_since(memory, 3, changed), 1);
+  ASSERT_EQ(changed[0], 11);
+
+  // the log is compacted as epochs go by, each cell still shows up once
+  for (int e = 0; e < 100; e++) {
+    ram_next_epoch(memory);
+    ASSERT_TRUE(ram_write_cell_by_name(memory, value, "c"));
+  }
+  ASSERT_LE(memory->num_touches, 2 * memory->capacity);
+  ASSERT_EQ(ram_changed_since(memory, 0, changed), 12);
+  ASSERT_EQ(ram_changed_since(memory, 103, changed), 1);
+  ASSERT_EQ(changed[0], 2);
+
+  ram_destroy(memory);
+}
+
+TEST(memory_module, transactions_roll_back)
+{
+  struct RAM* memory = ram_init();
+
+  struct RAM_VALUE i;
+  i.value_type = RAM_TYPE_INT;
+  i.types.i = 1;
+
+  struct RAM_VALUE long_str;
+  long_str.value_type = RAM_TYPE_STR;
+  long_str.types.s = "a string long enough to live on the heap";
+
+  struct RAM_VALUE short_str;
+  short_str.value_type = RAM_TYPE_STR;
+  short_str.types.s = "short";
+
+  ASSERT_FALSE(ram_commit(memory));
+  ASSERT_FALSE(ram_rollback(memory));
+
+  ASSERT_TRUE(ram_write_cell_by_name(memory, i, "x"));
+  ASSERT_TRUE(ram_write_cell_by_name(memory, long_str, "s"));
+  ASSERT_TRUE(ram_write_cell_by_name(memory, short_str, "t"));
+
+  // a whole "run": overwrite everything, create a few variables
+  ASSERT_TRUE(ram_begin(memory));
+  i.types.i = 2;
+  ASSERT_TRUE(ram_write_cell_by_name(memory, i, "x"));
+  ASSERT_TRUE(ram_write_cell_by_addr(memory, i, 1));
+  ASSERT_TRUE(ram_write_cell_by_name(memory, long_str, "t"));
+  for (int k = 0; k < 10; k++) {
+    char name[32];
+    snprintf(name, sizeof(name), "new%d", k);
+    ASSERT_TRUE(ram_write_cell_by_name(memory, i, name));
+  }
+
+  // one "statement" inside it, rolled back on its own
+  ASSERT_TRUE(ram_begin(memory));
+  i.types.i = 3;
+  ASSERT_TRUE(ram_write_cell_by_name(memory, i, "new0"));
+  ASSERT_TRUE(ram_write_cell_by_name(memory, i, "new10"));
+  ASSERT_EQ(memory->num_values, 14);
+  ASSERT_TRUE(ram_rollback(memory));
+  ASSERT_EQ(memory->num_values, 13);
+  ASSERT_EQ(ram_get_addr(memory, "new10"), -1);
+  ASSERT_EQ(ram_peek_cell_by_name(memory, "new0")->types.i, 2);
+
+  // another one, committed into the outer transaction
+  ASSERT_TRUE(ram_begin(memory));
+  ASSERT_TRUE(ram_write_cell_by_name(memory, i, "x"));
+  ASSERT_TRUE(ram_commit(memory));
+  ASSERT_EQ(ram_peek_cell_by_name(memory, "x")->types.i, 3);
+
+  // rolling back the run restores everything as it was
+  ASSERT_TRUE(ram_rollback(memory));
+  ASSERT_EQ(memory->num_values, 3);
+  ASSERT_EQ(ram_get_addr(memory, "new0"), -1);
+  ASSERT_EQ(ram_peek_cell_by_name(memory, "x")->types.i, 1);
+  ASSERT_EQ(ram_peek_cell_by_addr(memory, 1)->value_type, RAM_TYPE_STR);
+  ASSERT_STREQ(ram_peek_cell_by_addr(memory, 1)->types.s, "a string long enough to live on the heap");
+  ASSERT_STREQ(ram_peek_cell_by_name(memory, "t")->types.s, "short");
+
+  // addresses of removed variables are handed out again
+  ASSERT_TRUE(ram_write_cell_by_name(memory, i, "again"));
+  ASSERT_EQ(ram_get_addr(memory, "again"), 3);
+
+  // a committed run stays
+  ASSERT_TRUE(ram_begin(memory));
+  ASSERT_TRUE(ram_write_cell_by_name(memory, long_str, "x"));
+  ASSERT_TRUE(ram_commit(memory));
+  ASSERT_FALSE(ram_rollback(memory));
+  ASSERT_STREQ(ram_peek_cell_by_name(memory, "x")->types.s, "a string long enough to live on the heap");
+
+  // an open transaction is cleaned up by ram_destroy
+  ASSERT_TRUE(ram_begin(memory));
+  ASSERT_TRUE(ram_write_cell_by_name(memory, i, "s"));
+  ram_destroy(memory);
+}
+
+TEST(memory_module, snapshots_copy_on_write)
+{
+  for (int layout = RAM_LAYOUT_CELLS; layout <= RAM_LAYOUT_BOXED; layout++) {
+    struct RAM* memory = ram_init_layout(layout);
+
+    struct RAM_VALUE i;
+    i.value_type = RAM_TYPE_INT;
+
+    struct RAM_VALUE long_str;
+    long_str.value_type = RAM_TYPE_STR;
+    long_str.types.s = "a string long enough to live on the heap";
+
+    struct RAM_VALUE short_str;
+    short_str.value_type = RAM_TYPE_STR;
+    short_str.types.s = "short";
+
+    // enough variables for several chunks
+    int n = 3 * RAM_SNAPSHOT_CHUNK + 5;
+    for (int k = 0; k < n; k++) {
+      char name[32];
+      snprintf(name, sizeof(name), "v%d", k);
+      i.types.i = k;
+      ASSERT_TRUE(ram_write_cell_by_name(memory, i, name));
+    }
+    ASSERT_TRUE(ram_write_cell_by_name(memory, long_str, "s"));
+    ASSERT_TRUE(ram_write_cell_by_name(memory, short_str, "t"));
+
+    struct RAM_SNAPSHOT* snapshot = ram_snapshot(memory);
+    ASSERT_TRUE(snapshot != NULL);
+    for (int c = 0; c < snapshot->num_chunks; c++) {
+      ASSERT_TRUE(snapshot->chunks[c] == NULL);  // nothing copied yet
+    }
+
+    // writing one cell copies only its chunk
+    i.types.i = -1;
+    ASSERT_TRUE(ram_write_cell_by_addr(memory, i, 1));
+    ASSERT_TRUE(snapshot->chunks[0] != NULL);
+    ASSERT_TRUE(snapshot->chunks[1] == NULL);
+    ASSERT_EQ(ram_peek_cell_by_addr(memory, 1)->types.i, -1);
+    ASSERT_EQ(ram_snapshot_peek_by_addr(snapshot, 1)->types.i, 1);
+    ASSERT_EQ(ram_snapshot_peek_by_name(snapshot, "v2")->types.i, 2);
+    ASSERT_EQ(ram_snapshot_peek_by_name(snapshot, "v100")->types.i, 100);
+
+    // strings, overwritten and new variables
+    ASSERT_TRUE(ram_write_cell_by_name(memory, i, "s"));
+    ASSERT_TRUE(ram_write_cell_by_name(memory, i, "t"));
+    ASSERT_TRUE(ram_write_cell_by_name(memory, i, "new"));
+    ASSERT_STREQ(ram_snapshot_peek_by_name(snapshot, "s")->types.s, "a string long enough to live on the heap");
+    ASSERT_STREQ(ram_snapshot_peek_by_name(snapshot, "t")->types.s, "short");
+    ASSERT_TRUE(ram_snapshot_peek_by_name(snapshot, "new") == NULL);
+    ASSERT_TRUE(ram_snapshot_peek_by_addr(snapshot, n + 2) == NULL);
+
+    // a second snapshot sees the writes, the first still does not
+    struct RAM_SNAPSHOT* later = ram_snapshot(memory);
+    ASSERT_EQ(later->num_values, n + 3);
+    ASSERT_EQ(ram_snapshot_peek_by_addr(later, 1)->types.i, -1);
+    ASSERT_TRUE(ram_write_cell_by_addr(memory, long_str, 1));
+    ASSERT_EQ(ram_snapshot_peek_by_addr(later, 1)->types.i, -1);
+    ASSERT_EQ(ram_snapshot_peek_by_addr(snapshot, 1)->types.i, 1);
+    ram_snapshot_release(later);
+
+    // snapshots outlive the memory
+    ram_destroy(memory);
+    ASSERT_TRUE(snapshot->memory == NULL);
+    ASSERT_EQ(ram_snapshot_peek_by_name(snapshot, "v1")->types.i, 1);
+    ASSERT_EQ(ram_snapshot_peek_by_addr(snapshot, n - 1)->types.i, n - 1);
+    ASSERT_STREQ(ram_snapshot_peek_by_name(snapshot, "s")->types.s, "a string long enough to live on the heap");
+    ASSERT_STREQ(ram_snapshot_peek_by_name(snapshot, "t")->types.s, "short");
+    ram_snapshot_release(snapshot);
+  }
+}
+
+TEST(memory_module, images_save_and_map)
+{
+  for (int layout = RAM_LAYOUT_CELLS; layout <= RAM_LAYOUT_BOXED; layout++) {
+    struct RAM* memory = ram_init_layout(layout);
+
+    struct RAM_VALUE i;
+    i.value_type = RAM_TYPE_INT;
+    i.types.i = -123;
+
+    struct RAM_VALUE d;
+    d.value_type = RAM_TYPE_REAL;
+    d.types.d = 2.5;
+
+    struct RAM_VALUE b;
+    b.value_type = RAM_TYPE_BOOLEAN;
+    b.types.i = true;
+
+    struct RAM_VALUE none;
+    none.value_type = RAM_TYPE_NONE;
+    none.types.i = 0;
+
+    struct RAM_VALUE long_str;
+    long_str.value_type = RAM_TYPE_STR;
+    long_str.types.s = "a string long enough to live on the heap";
+
+    struct RAM_VALUE short_str;
+    short_str.value_type = RAM_TYPE_STR;
+    short_str.types.s = "short";
+
+    ASSERT_TRUE(ram_write_cell_by_name(memory, i, "i"));
+    ASSERT_TRUE(ram_write_cell_by_name(memory, d, "d"));
+    ASSERT_TRUE(ram_write_cell_by_name(memory, b, "b"));
+    ASSERT_TRUE(ram_write_cell_by_name(memory, none, "none"));
+    ASSERT_TRUE(ram_write_cell_by_name(memory, long_str, "s"));
+    ASSERT_TRUE(ram_write_cell_by_name(memory, short_str, "t"));
+    for (int k = 0; k < 100; k++) {
+      char name[32];
+      snprintf(name, sizeof(name), "v%d", k);
+      i.types.i = k;
+      ASSERT_TRUE(ram_write_cell_by_name(memory, i, name));
+    }
+
+    char filename[] = "/tmp/ram_image_test.XXXXXX";
+    int fd = mkstemp(filename);
+    ASSERT_TRUE(fd >= 0);
+    close(fd);
+
+    ASSERT_TRUE(ram_image_save(memory, filename));
+    ASSERT_FALSE(ram_image_save(memory, "/no/such/directory/image.ram"));
+
+    // read-only: values keep their types, writes are refused
+    struct RAM_IMAGE* image = ram_image_open(filename, RAM_IMAGE_READONLY);
+    ASSERT_TRUE(image != NULL);
+    ASSERT_EQ(ram_image_num_values(image), 106);
+    ASSERT_STREQ(ram_image_identifier(image, 4), "s");
+    ASSERT_TRUE(ram_image_identifier(image, 106) == NULL);
+    ASSERT_EQ(ram_image_get_addr(image, "v99"), 105);
+    ASSERT_EQ(ram_image_get_addr(image, "nope"), -1);
+    ASSERT_TRUE(ram_image_read_by_name(image, "nope") == NULL);
+
+    struct RAM_VALUE* value = ram_image_read_by_name(image, "d");
+    ASSERT_EQ(value->value_type, RAM_TYPE_REAL);
+    ASSERT_DOUBLE_EQ(value->types.d, 2.5);
+    free(value);
+
+    value = ram_image_read_by_name(image, "b");
+    ASSERT_EQ(value->value_type, RAM_TYPE_BOOLEAN);
+    ASSERT_EQ(value->types.i, true);
+    free(value);
+
+    value = ram_image_read_by_addr(image, 3);
+    ASSERT_EQ(value->value_type, RAM_TYPE_NONE);
+    free(value);
+
+    value = ram_image_read_by_name(image, "s");
+    ASSERT_STREQ(value->types.s, "a string long enough to live on the heap");
+    free(value);
+
+    value = ram_image_read_by_name(image, "t");
+    ASSERT_STREQ(value->types.s, "short");
+    free(value);
+
+    ASSERT_FALSE(ram_image_write_by_addr(image, d, 0));
+
+    // loading it back gives the same memory
+    struct RAM* loaded = ram_image_load(image);
+    ASSERT_TRUE(loaded != NULL);
+    ASSERT_EQ(loaded->num_values, 106);
+    ASSERT_EQ(ram_get_addr(loaded, "v50"), ram_get_addr(memory, "v50"));
+    ASSERT_EQ(ram_peek_cell_by_name(loaded, "i")->types.i, -123);
+    ASSERT_STREQ(ram_peek_cell_by_name(loaded, "s")->types.s, "a string long enough to live on the heap");
+    ASSERT_STREQ(ram_peek_cell_by_name(loaded, "t")->types.s, "short");
+    ram_destroy(loaded);
+    ram_image_close(image);
+
+    // copy-on-write: writes change the mapping, never the file
+    image = ram_image_open(filename, RAM_IMAGE_PRIVATE);
+    ASSERT_TRUE(image != NULL);
+    ASSERT_TRUE(ram_image_write_by_addr(image, d, 0));
+    ASSERT_FALSE(ram_image_write_by_addr(image, long_str, 0));
+    ASSERT_FALSE(ram_image_write_by_addr(image, d, 106));
+    value = ram_image_read_by_addr(image, 0);
+    ASSERT_EQ(value->value_type, RAM_TYPE_REAL);
+    free(value);
+    ram_image_close(image);
+
+    image = ram_image_open(filename, RAM_IMAGE_READONLY);
+    value = ram_image_read_by_addr(image, 0);
+    ASSERT_EQ(value->value_type, RAM_TYPE_INT);
+    ASSERT_EQ(value->types.i, -123);
+    free(value);
+    ram_image_close(image);
+
+    // anything else is refused
+    FILE* output = fopen(filename, "wb");
+    fputs("not an image, just some text that is long enough for a header", output);
+    fclose(output);
+    ASSERT_TRUE(ram_image_open(filename, RAM_IMAGE_READONLY) == NULL);
+    ASSERT_TRUE(ram_image_open("/no/such/image.ram", RAM_IMAGE_READONLY) == NULL);
+
+    remove(filename);
+    ram_destroy(memory);
+  }
+}
+
+TEST(memory_module, concurrent_readers)
+{
+  for (int layout = RAM_LAYOUT_CELLS; layout <= RAM_LAYOUT_BOXED; layout++) {
+    struct RAM* memory = ram_init_layout(layout);
+
+    struct RAM_VALUE i;
+    i.value_type = RAM_TYPE_INT;
+    i.types.i = 0;
+
+    struct RAM_VALUE short_str;
+    short_str.value_type = RAM_TYPE_STR;
+    short_str.types.s = "aaaaa";
+
+    ASSERT_TRUE(ram_write_cell_by_name(memory, i, "x"));
+    ASSERT_TRUE(ram_write_cell_by_name(memory, short_str, "s"));
+    ASSERT_TRUE(ram_readers_enable(memory));
+
+    // the reader only ever sees whole values: x a non-negative int or
+    // 0.5, s five or forty copies of one letter
+    std::atomic<bool> done(false);
+    std::atomic<long> reads(0);
+    std::atomic<int> torn(0);
+
+    std::thread reader([&]() {
+      int x = ram_get_addr_concurrent(memory, "x");
+      int s = ram_get_addr_concurrent(memory, "s");
+      if (x != 0 || s != 1 || ram_get_addr_concurrent(memory, "nope") != -1) {
+        torn++;
+      }
+
+      while (!done) {
+        struct RAM_VALUE value;
+        char buffer[64];
+
+        if (!ram_read_concurrent(memory, x, &value, buffer, sizeof(buffer)) ||
+            !((value.value_type == RAM_TYPE_INT && value.types.i >= 0) ||
+              (value.value_type == RAM_TYPE_REAL && value.types.d == 0.5))) {
+          torn++;
+        }
+
+        if (!ram_read_concurrent(memory, s, &value, buffer, sizeof(buffer)) ||
+            value.value_type != RAM_TYPE_STR || value.types.s != buffer) {
+          torn++;
+          continue;
+        }
+        size_t len = strlen(buffer);
+        if ((len != 5 && len != 40) || strspn(buffer, buffer[0] == 'a' ? "a" : "b") != len) {
+          torn++;
+        }
+        reads++;
+      }
+    });
+
+    // the writer keeps going: overwrites, new variables (so memory
+    // grows and moves), and rolled back transactions (cells removed)
+    char long_a[41], long_b[41], short_b[6];
+    memset(long_a, 'a', 40);
+    long_a[40] = '\0';
+    memset(long_b, 'b', 40);
+    long_b[40] = '\0';
+    strcpy(short_b, "bbbbb");
+    char* strs[] = { short_str.types.s, long_a, short_b, long_b };
+
+    struct RAM_VALUE d;
+    d.value_type = RAM_TYPE_REAL;
+    d.types.d = 0.5;
+
+    struct RAM_VALUE str;
+    str.value_type = RAM_TYPE_STR;
+
+    for (int k = 0; k < 200000 || reads < 1000; k++) {
+      i.types.i = k;
+      ASSERT_TRUE(ram_write_cell_by_addr(memory, (k % 3 == 0) ? d : i, 0));
+      str.types.s = strs[k % 4];
+      ASSERT_TRUE(ram_write_cell_by_addr(memory, str, 1));
+
+      if (k % 50 == 0 && k < 100000) {
+        char name[32];
+        snprintf(name, sizeof(name), "v%d", k);
+        ASSERT_TRUE(ram_write_cell_by_name(memory, str, name));
+      }
+      if (k % 1000 == 0) {
+        ASSERT_TRUE(ram_begin(memory));
+        ASSERT_TRUE(ram_write_cell_by_name(memory, i, "temporary"));
+        ASSERT_TRUE(ram_write_cell_by_addr(memory, str, 1));
+        ASSERT_TRUE(ram_rollback(memory));
+      }
+    }
+
+    done = true;
+    reader.join();
+    ASSERT_EQ(torn, 0);
+    ASSERT_GT(memory->capacity, 2000);
+
+    // without readers, nothing is held up any more
+    ram_readers_disable(memory);
+    ASSERT_EQ(memory->num_retired, 0);
+    ASSERT_TRUE(ram_write_cell_by_name(memory, i, "after"));
+    ram_destroy(memory);
+  }
+}
+
+TEST(memory_module, boxed_values)
+{
+  // every kind of value round-trips through one 64-bit word
+  struct RAM_VALUE values[12];
+  int types[] = { RAM_TYPE_INT, RAM_TYPE_INT, RAM_TYPE_INT, RAM_TYPE_REAL, RAM_TYPE_REAL, RAM_TYPE_REAL,
+                  RAM_TYPE_REAL, RAM_TYPE_STR, RAM_TYPE_STR, RAM_TYPE_PTR, RAM_TYPE_BOOLEAN, RAM_TYPE_NONE };
+  for (int k = 0; k < 12; k++) {
+    values[k].value_type = types[k];
+  }
+  values[0].types.i = 0;
+  values[1].types.i = -1;
+  values[2].types.i = INT_MIN;
+  values[3].types.d = -0.0;
+  values[4].types.d = 1e300;
+  values[5].types.d = -INFINITY;
+  values[6].types.d = 0.1;
+  values[7].types.s = (char*) "hello";
+  values[8].types.s = NULL;
+  values[9].types.i = 123;
+  values[10].types.i = true;
+  values[11].types.i = 0;
+
+  for (int k = 0; k < 12; k++) {
+    struct RAM_VALUE v = ram_unbox(ram_box(values[k]));
+    ASSERT_EQ(v.value_type, values[k].value_type);
+
+    if (v.value_type == RAM_TYPE_REAL) {
+      ASSERT_EQ(memcmp(&v.types.d, &values[k].types.d, sizeof(double)), 0);  // -0.0 too
+    } else if (v.value_type == RAM_TYPE_STR) {
+      ASSERT_TRUE(v.types.s == values[k].types.s);  // the pointer, not a copy
+    } else if (v.value_type != RAM_TYPE_NONE) {
+      ASSERT_EQ(v.types.i, values[k].types.i);
+    }
+  }
+
+  // NaN stays a real
+  struct RAM_VALUE nan;
+  nan.value_type = RAM_TYPE_REAL;
+  nan.types.d = -NAN;
+  ASSERT_EQ(ram_box(nan), RAM_BOX_NAN);
+  ASSERT_EQ(ram_unbox(ram_box(nan)).value_type, RAM_TYPE_REAL);
+  ASSERT_TRUE(std::isnan(ram_unbox(ram_box(nan)).types.d));
+
+  // the boxed layout takes 8 bytes a value and behaves like the others
+  struct RAM* memory = ram_init_layout(RAM_LAYOUT_BOXED);
+  ASSERT_TRUE(memory != NULL);
+  ASSERT_TRUE(memory->cells == NULL && memory->tags == NULL);
+  ASSERT_EQ(sizeof(memory->payloads[0]), 8u);
+
+  char name[32];
+  for (int i = 0; i < 100; i++) {
+    snprintf(name, sizeof(name), "v%d", i);
+    ASSERT_TRUE(ram_write_cell_by_name(memory, values[i % 12], name));
+  }
+  ASSERT_EQ(memory->num_values, 100);
+
+  for (int i = 0; i < 100; i++) {
+    snprintf(name, sizeof(name), "v%d", i);
+    struct RAM_VALUE* v = ram_read_cell_by_name(memory, name);
+    ASSERT_EQ(v->value_type, values[i % 12].value_type);
+
+    if (v->value_type == RAM_TYPE_STR && values[i % 12].types.s != NULL) {
+      ASSERT_STREQ(v->types.s, values[i % 12].types.s);
+      ASSERT_TRUE(v->types.s != values[i % 12].types.s);  // memory has its own copy
+    } else if (v->value_type == RAM_TYPE_INT) {
+      ASSERT_EQ(v->types.i, values[i % 12].types.i);
+    }
+    ram_free_value(v);
+  }
+
+  // overwriting a string with itself, borrowed from memory
+  const struct RAM_VALUE* borrowed = ram_peek_cell_by_name(memory, "v7");
+  ASSERT_TRUE(ram_write_cell_by_name(memory, *borrowed, "v7"));
+  ASSERT_STREQ(ram_peek_cell_by_name(memory, "v7")->types.s, "hello");
+  ASSERT_TRUE(ram_write_cell_by_addr(memory, values[0], 7));
+  ASSERT_EQ(ram_peek_cell_by_addr(memory, 7)->value_type, RAM_TYPE_INT);
+
+  ram_destroy(memory);
+}
+
+TEST(memory_module, string_arena)
+{
+  for (int layout = RAM_LAYOUT_CELLS; layout <= RAM_LAYOUT_BOXED; layout++) {
+    struct RAM* memory = ram_init_layout(layout);
+    char name[32];
+    char text[64];
+
+    struct RAM_VALUE str;
+    str.value_type = RAM_TYPE_STR;
+    str.types.s = text;
+
+    struct RAM_VALUE i;
+    i.value_type = RAM_TYPE_INT;
+    i.types.i = 0;
+
+    for (int k = 0; k < 2000; k++) {
+      snprintf(name, sizeof(name), "v%d", k);
+      snprintf(text, sizeof(text), "string #%d, too long to be stored inline", k);
+      ASSERT_TRUE(ram_write_cell_by_name(memory, str, name));
+    }
+    ASSERT_TRUE(memory->num_arena_chunks > 0);
+    ASSERT_EQ(memory->num_foreign_strs, 0);
+    ASSERT_FALSE(ram_compact(memory, false));  // nothing to reclaim
+
+    // t = s shares the arena string
+    const struct RAM_VALUE* borrowed = ram_peek_cell_by_name(memory, "v1999");
+    char* v1999 = borrowed->types.s;
+    ASSERT_TRUE(ram_write_cell_by_name(memory, *borrowed, "t"));
+    ASSERT_TRUE(ram_peek_cell_by_name(memory, "t")->types.s == v1999);
+
+    // a freed block is reused by the next string of its size
+    char* v0 = ram_peek_cell_by_name(memory, "v0")->types.s;
+    ASSERT_TRUE(ram_write_cell_by_name(memory, i, "v0"));
+    snprintf(text, sizeof(text), "another string too long to be stored inline");
+    ASSERT_TRUE(ram_write_cell_by_name(memory, str, "u"));
+    ASSERT_TRUE(ram_peek_cell_by_name(memory, "u")->types.s == v0);
+
+    // free most of the arena, then compact at a safe point
+    for (int k = 0; k < 1800; k++) {
+      ASSERT_TRUE(ram_write_cell_by_addr(memory, i, k));
+    }
+    ASSERT_TRUE(memory->arena_free_bytes > memory->arena_live_bytes);
+
+    ASSERT_TRUE(ram_begin(memory));
+    ASSERT_FALSE(ram_compact(memory, true));  // not inside a transaction
+    ASSERT_TRUE(ram_commit(memory));
+
+    int chunks = memory->num_arena_chunks;
+    ASSERT_TRUE(ram_compact(memory, false));
+    ASSERT_TRUE(memory->num_arena_chunks < chunks);
+    ASSERT_EQ(memory->arena_free_bytes, 0u);
+
+    // every string survived the move, and t still shares with v1999
+    for (int k = 1800; k < 2000; k++) {
+      snprintf(name, sizeof(name), "v%d", k);
+      snprintf(text, sizeof(text), "string #%d, too long to be stored inline", k);
+      ASSERT_STREQ(ram_peek_cell_by_name(memory, name)->types.s, text);
+    }
+    ASSERT_TRUE(ram_peek_cell_by_name(memory, "t")->types.s != v1999);
+    ASSERT_TRUE(ram_peek_cell_by_name(memory, "t")->types.s == ram_peek_cell_by_name(memory, "v1999")->types.s);
+    ASSERT_STREQ(ram_peek_cell_by_name(memory, "u")->types.s, "another string too long to be stored inline");
+
+    // a forced compaction runs whenever it is safe
+    ASSERT_TRUE(ram_compact(memory, true));
+
+    // a read copy shares the arena string, which stays valid after
+    // ram_destroy; u and w now hold it as a string from outside
+    char* u = ram_peek_cell_by_name(memory, "u")->types.s;
+    struct RAM_VALUE* copy = ram_read_cell_by_name(memory, "u");
+    ASSERT_TRUE(copy->types.s == u);
+    ASSERT_TRUE(ram_write_cell_by_name(memory, *copy, "w"));
+    ASSERT_TRUE(ram_peek_cell_by_name(memory, "w")->types.s == u);
+    ASSERT_EQ(memory->num_foreign_strs, 2);
+
+    // its block is not reused, and a compaction leaves it in place
+    ASSERT_TRUE(ram_write_cell_by_name(memory, i, "u"));
+    ASSERT_TRUE(ram_write_cell_by_name(memory, str, "x"));
+    ASSERT_TRUE(ram_peek_cell_by_name(memory, "x")->types.s != u);
+    ASSERT_TRUE(ram_compact(memory, true));
+    ASSERT_TRUE(ram_peek_cell_by_name(memory, "w")->types.s == u);
+    ram_destroy(memory);
+    ASSERT_STREQ(copy->types.s, "another string too long to be stored inline");
+    ram_free_value(copy);
+  }
+}
+
+//
+// dumps memory to a temporary file with the given options (name=value
+// strings, NULL-terminated) and returns what was written
+//
+static std::string dump_to_string(struct RAM* memory, const char* args[], int* dumped)
+{
+  struct RAM_DUMP_OPTIONS options;
+  ram_dump_options_init(&options);
+  for (int k = 0; args[k] != NULL; k++) {
+    EXPECT_TRUE(ram_dump_option(&options, (char*) args[k]));
+  }
+
+  FILE* out = tmpfile();
+  *dumped = ram_dump(memory, &options, out);
+
+  std::string text;
+  char chunk[4096];
+  size_t n;
+  rewind(out);
+  while ((n = fread(chunk, 1, sizeof(chunk), out)) > 0) {
+    text.append(chunk, n);
+  }
+  fclose(out);
+
+  return text;
+}
+
+TEST(memory_module, dump_filters_and_formats)
+{
+  struct RAM* memory = ram_init();
+  struct RAM_VALUE value;
+  char name[32];
+
+  for (int k = 0; k < 20; k++) {
+    value.value_type = RAM_TYPE_INT;
+    value.types.i = k * 10;
+    snprintf(name, sizeof(name), "%s%d", (k % 2 == 0) ? "x" : "y", k);
+    ASSERT_TRUE(ram_write_cell_by_name(memory, value, name));
+  }
+  value.value_type = RAM_TYPE_REAL;
+  value.types.d = -2.5;
+  ASSERT_TRUE(ram_write_cell_by_name(memory, value, "r"));
+  value.value_type = RAM_TYPE_STR;
+  value.types.s = (char*) "say \"hi\"\n";
+  ASSERT_TRUE(ram_write_cell_by_name(memory, value, "s"));
+  value.value_type = RAM_TYPE_BOOLEAN;
+  value.types.i = true;
+  ASSERT_TRUE(ram_write_cell_by_name(memory, value, "b"));
+
+  // the default is exactly ram_print's output
+  int dumped;
+  const char* none[] = { NULL };
+  std::string text = dump_to_string(memory, none, &dumped);
+  ASSERT_EQ(dumped, 23);
+  ASSERT_EQ(text.find("**MEMORY PRINT**\nCapacity: 32\nNum values: 23\nContents:\n 0: x0, int, 0\n"), 0u);
+  ASSERT_NE(text.find(" 20: r, real, -2.500000\n 21: s, str, 'say \"hi\"\n'\n 22: b, boolean, True\n**END PRINT**\n"), std::string::npos);
+
+  // glob, prefix, range and paging
+  const char* glob[] = { "match=x1[0-4]", NULL };
+  text = dump_to_string(memory, glob, &dumped);
+  ASSERT_EQ(dumped, 3);  // x10, x12, x14
+  ASSERT_NE(text.find(" 14: x14, int, 140\n**END"), std::string::npos);
+
+  const char* prefix[] = { "prefix=y", "range=3..11", NULL };
+  text = dump_to_string(memory, prefix, &dumped);
+  ASSERT_EQ(dumped, 5);  // y3 .. y11
+
+  const char* page[] = { "match=*", "offset=5", "limit=4", NULL };
+  text = dump_to_string(memory, page, &dumped);
+  ASSERT_EQ(dumped, 4);
+  ASSERT_NE(text.find("Contents:\n 5: y5, int, 50\n 6: x6"), std::string::npos);
+  ASSERT_NE(text.find(" 8: x8, int, 80\n**END"), std::string::npos);
+
+  // JSON lines, strings escaped
+  const char* json[] = { "format=json", "range=20..", NULL };
+  text = dump_to_string(memory, json, &dumped);
+  ASSERT_EQ(dumped, 3);
+  ASSERT_EQ(text, "{\"address\":20,\"identifier\":\"r\",\"type\":\"real\",\"value\":-2.5}\n"
+                  "{\"address\":21,\"identifier\":\"s\",\"type\":\"str\",\"value\":\"say \\\"hi\\\"\\u000a\"}\n"
+                  "{\"address\":22,\"identifier\":\"b\",\"type\":\"boolean\",\"value\":true}\n");
+
+  // binary: header, then rows
+  const char* binary[] = { "format=binary", "range=21", NULL };
+  text = dump_to_string(memory, binary, &dumped);
+  ASSERT_EQ(dumped, 1);
+  ASSERT_EQ(text.size(), sizeof(struct RAM_DUMP_HEADER) + sizeof(struct RAM_DUMP_ROW) + 1 + sizeof(int32_t) + 9);
+
+  struct RAM_DUMP_HEADER header;
+  struct RAM_DUMP_ROW row;
+  memcpy(&header, text.data(), sizeof(header));
+  memcpy(&row, text.data() + sizeof(header), sizeof(row));
+  ASSERT_EQ(header.magic, RAM_DUMP_MAGIC);
+  ASSERT_EQ(header.num_values, 23);
+  ASSERT_EQ(row.address, 21);
+  ASSERT_EQ(row.value_type, RAM_TYPE_STR);
+  ASSERT_EQ(row.identifier_length, 1);
+
+  // bad options are refused and change nothing
+  struct RAM_DUMP_OPTIONS options;
+  ram_dump_options_init(&options);
+  ASSERT_FALSE(ram_dump_option(&options, (char*) "format=xml"));
+  ASSERT_FALSE(ram_dump_option(&options, (char*) "range=5..2"));
+  ASSERT_FALSE(ram_dump_option(&options, (char*) "limit=-1"));
+  ASSERT_FALSE(ram_dump_option(&options, (char*) "colour=red"));
+  ASSERT_FALSE(ram_dump_option(&options, (char*) "match"));
+  ASSERT_EQ(options.format, RAM_DUMP_HUMAN);
+  ASSERT_EQ(options.last, -1);
+
+  ram_destroy(memory);
+}
+
+static void reset_count_hook(struct RAM* memory, int address, const struct RAM_VALUE* value, void* context)
+{
+  (*(int*) context)++;
+}
+
+TEST(memory_module, reset_and_pool)
+{
+  struct RAM_VALUE i;
+  i.value_type = RAM_TYPE_INT;
+  i.types.i = 7;
+
+  struct RAM_VALUE str;
+  str.value_type = RAM_TYPE_STR;
+  str.types.s = "a string too long to be stored inline, in the arena";
+
+  for (int layout = RAM_LAYOUT_CELLS; layout <= RAM_LAYOUT_BOXED; layout++) {
+    struct RAM* memory = ram_init_layout(layout);
+    char name[32];
+
+    for (int k = 0; k < 100; k++) {
+      snprintf(name, sizeof(name), "r%d", k);
+      ASSERT_TRUE(ram_write_cell_by_name(memory, (k % 2 == 0) ? i : str, name));
+    }
+
+    // a string from outside the arena, a hook, a snapshot and an open
+    // transaction are all let go by the reset
+    struct RAM_VALUE* copy = ram_read_cell_by_name(memory, "r1");
+    ASSERT_TRUE(ram_write_cell_by_name(memory, *copy, "foreign"));
+    ram_free_value(copy);
+    ASSERT_TRUE(memory->num_foreign_strs > 0);
+
+    int calls = 0;
+    ASSERT_TRUE(ram_add_write_hook(memory, 0, reset_count_hook, &calls) >= 0);
+    struct RAM_SNAPSHOT* snapshot = ram_snapshot(memory);
+    ASSERT_TRUE(ram_begin(memory));
+    ASSERT_TRUE(ram_write_cell_by_name(memory, str, "r0"));
+    ASSERT_EQ(calls, 1);
+
+    int capacity = memory->capacity;
+    int epoch = ram_epoch(memory);
+    ram_reset(memory);
+
+    ASSERT_EQ(memory->num_values, 0);
+    ASSERT_EQ(memory->capacity, capacity);  // kept, so no growth next time
+    ASSERT_TRUE(ram_epoch(memory) > epoch);
+    ASSERT_EQ(memory->num_foreign_strs, 0);
+    ASSERT_TRUE(memory->num_arena_chunks <= 1);
+    ASSERT_EQ(ram_get_addr(memory, "r0"), -1);
+    ASSERT_EQ(ram_get_addr(memory, "foreign"), -1);
+    ASSERT_TRUE(ram_read_cell_by_addr(memory, 0) == NULL);
+    ASSERT_FALSE(ram_rollback(memory));  // the transaction is gone
+    int changed[128];
+    ASSERT_EQ(ram_changed_since(memory, 0, changed), 0);
+
+    // the snapshot kept its own copy
+    ASSERT_STREQ(ram_snapshot_peek_by_name(snapshot, "r1")->types.s, str.types.s);
+    ram_snapshot_release(snapshot);
+
+    // written again in another order, the names get new addresses
+    for (int k = 99; k >= 0; k--) {
+      snprintf(name, sizeof(name), "r%d", k);
+      ASSERT_TRUE(ram_write_cell_by_name(memory, (k % 2 == 0) ? str : i, name));
+    }
+    ASSERT_EQ(calls, 1);  // the hook went with the reset
+    for (int k = 0; k < 100; k++) {
+      snprintf(name, sizeof(name), "r%d", k);
+      ASSERT_EQ(ram_get_addr(memory, name), 99 - k);
+      const struct RAM_VALUE* value = ram_peek_cell_by_addr(memory, 99 - k);
+      if (k % 2 == 0) {
+        ASSERT_STREQ(value->types.s, str.types.s);
+      } else {
+        ASSERT_EQ(value->types.i, 7);
+      }
+    }
+    ASSERT_EQ(memory->capacity, capacity);
+
+    // a base about to overflow clears the index for real instead
+    ram_reset(memory);
+    memory->index_base = INT_MAX - memory->capacity;
+    ASSERT_TRUE(ram_write_cell_by_name(memory, i, "r5"));
+    ASSERT_EQ(ram_get_addr(memory, "r5"), 0);
+    ram_reset(memory);
+    ASSERT_EQ(memory->index_base, 0);
+    ASSERT_EQ(ram_get_addr(memory, "r5"), -1);
+    ASSERT_TRUE(ram_write_cell_by_name(memory, i, "r6"));
+    ASSERT_EQ(ram_get_addr(memory, "r6"), 0);
+
+    ram_destroy(memory);
+  }
+
+  // a pool of 2: the third memory released is destroyed instead
+  struct RAM_POOL* pool = ram_pool_create(2, 16);
+  struct RAM* a = ram_pool_acquire(pool);
+  struct RAM* b = ram_pool_acquire(pool);
+  struct RAM* c = ram_pool_acquire(pool);
+  ASSERT_EQ(pool->created, 3);
+  ASSERT_TRUE(a->capacity >= 16);
+  ASSERT_TRUE(ram_write_cell_by_name(a, i, "x"));
+  ram_pool_release(pool, a);
+  ram_pool_release(pool, b);
+  ram_pool_release(pool, c);
+
+  struct RAM* d = ram_pool_acquire(pool);
+  ASSERT_TRUE(d == a || d == b);
+  ASSERT_EQ(pool->reused, 1);
+  ASSERT_EQ(d->num_values, 0);
+  ASSERT_EQ(ram_get_addr(d, "x"), -1);
+  ram_pool_release(pool, d);
+  ram_pool_destroy(pool);
+
+  // threads sharing a pool never share a memory, but do share the
+  // intern pool and the string registry: each run interns names no
+  // other thread uses alongside ones they all use, and writes one
+  // string all the threads share
+  const int num_threads = 4;
+  const int runs = 2000;
+
+  struct RAM* source = ram_init();
+  struct RAM_VALUE text;
+  text.value_type = RAM_TYPE_STR;
+  text.types.s = (char*)"a string too long to be stored inline";
+  ASSERT_TRUE(ram_write_cell_by_name(source, text, "text"));
+  struct RAM_VALUE* shared = ram_read_cell_by_name(source, "text");  // a registered copy
+  ram_destroy(source);
+
+  pool = ram_pool_create(num_threads, 4);
+  std::atomic<int> wrong(0);
+  std::vector<std::thread> threads;
+
+  for (int t = 0; t < num_threads; t++) {
+    threads.push_back(std::thread([&, t]() {
+      for (int run = 0; run < runs; run++) {
+        struct RAM* memory = ram_pool_acquire(pool);
+        if (memory->num_values != 0) {
+          wrong++;
+        }
+
+        char names[10][32];
+        struct RAM_VALUE value;
+        value.value_type = RAM_TYPE_INT;
+        for (int k = 0; k < 10; k++) {
+          if (k % 2 == 0) {
+            snprintf(names[k], sizeof(names[k]), "p%d", k);
+          } else {
+            snprintf(names[k], sizeof(names[k]), "t%d_%d_%d", t, run % 100, k);
+          }
+          value.types.i = t * runs + run + k;
+          ram_write_cell_by_name(memory, value, names[k]);
+        }
+        ram_write_cell_by_name(memory, *shared, "text");
+
+        for (int k = 0; k < 10; k++) {
+          const struct RAM_VALUE* read = ram_peek_cell_by_name(memory, names[k]);
+          if (read == NULL || read->types.i != t * runs + run + k || ram_get_addr(memory, names[k]) != k) {
+            wrong++;
+          }
+        }
+        struct RAM_VALUE* read = ram_read_cell_by_name(memory, "text");
+        if (read == NULL || read->types.s != shared->types.s) {
+          wrong++;
+        }
+        ram_free_value(read);
+
+        ram_pool_release(pool, memory);
+      }
+    }));
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(wrong, 0);
+  ASSERT_EQ(pool->created + pool->reused, num_threads * runs);
+  ASSERT_TRUE(pool->reused > 0);
+  ram_pool_destroy(pool);
+
+  // the pooled memories are gone, and with them every name they held
+  ASSERT_TRUE(intern_find((char*)"p0") == NULL);
+  ASSERT_TRUE(intern_find((char*)"t0_0_1") == NULL);
+  ram_free_value(shared);
+}
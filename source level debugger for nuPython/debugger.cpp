@@ -10,9 +10,13 @@
 
 #include <iostream>
 #include <cassert>
+#include <cstdlib>  // realloc
+#include <vector>
+#include <sstream>
 
 #include "debugger.h"
 #include "execute.h"
+#include "ram_dump.h"
 
 using namespace std;
 
@@ -22,7 +26,7 @@ using namespace std;
 //
 // Prints the contents of a RAM cell, both type and value.
 //
-void Debugger::print_value(string varname, struct RAM_VALUE* value)
+void Debugger::print_value(string varname, const struct RAM_VALUE* value)
 {
   cout << varname << " ("; 
   
@@ -55,6 +59,94 @@ void Debugger::print_value(string varname, struct RAM_VALUE* value)
 }
 
 
+//
+// peek_value
+//
+// Returns a pointer to the value of the given variable as it
+// sits in memory, WITHOUT making a copy, or nullptr if no such
+// variable exists. Same contract as ram_peek_cell_by_name: the
+// value is borrowed and only valid until the next write to
+// memory.
+//
+const struct RAM_VALUE* Debugger::peek_value(const string& varname)
+{
+  int addr = ram_get_addr(this->Memory, (char*) varname.c_str());
+  
+  if (addr < 0 || addr >= this->Memory->num_values)
+    return nullptr;
+    
+  return &this->Memory->cells[addr].value;
+}
+
+
+//
+// presize_memory
+//
+// Grows the (still empty) memory to the given capacity up front,
+// so running the program never has to realloc the cells, the
+// way ram_init_with_capacity would.
+//
+void Debugger::presize_memory(int capacity)
+{
+  if (capacity <= this->Memory->capacity)
+    return;
+
+  struct RAM_CELL* cells = (struct RAM_CELL*) realloc(this->Memory->cells, capacity * sizeof(struct RAM_CELL));
+  if (cells == nullptr)
+    return;  // keep the smaller memory, it still grows on demand
+
+  for (int i = this->Memory->capacity; i < capacity; i++) {
+    cells[i].identifier = nullptr;
+    cells[i].value.value_type = RAM_TYPE_NONE;
+  }
+
+  this->Memory->cells = cells;
+  this->Memory->capacity = capacity;
+}
+
+
+//
+// show_memory
+//
+// The sm command: dumps memory through the dump engine, with the
+// options given after sm (see ram_dump_option), e.g.
+// sm match=x* format=json.
+//
+void Debugger::show_memory(const string& args)
+{
+  struct RAM_DUMP_OPTIONS options;
+  ram_dump_options_init(&options);
+
+  vector<string> words;  // the options point into these
+  istringstream in(args);
+  string word;
+  while (in >> word)
+    words.push_back(word);
+
+  for (string& w : words) {
+    if (!ram_dump_option(&options, &w[0]) || options.format == RAM_DUMP_BINARY) {
+      cout << "invalid sm option '" << w << "'" << endl;
+      return;
+    }
+  }
+
+  cout << flush;  // the dump goes through stdio
+
+  struct RAM_DUMP dump;
+  ram_dump_begin(&dump, &options, stdout);
+  ram_dump_header(&dump, "MEMORY", this->Memory->capacity, this->Memory->num_values);
+
+  for (int i = options.first; i < this->Memory->num_values; i++) {
+    struct RAM_CELL* cell = &this->Memory->cells[i];
+
+    if (!ram_dump_row(&dump, i, cell->identifier, &cell->value))
+      break;
+  }
+
+  ram_dump_end(&dump);
+}
+
+
 //
 // findBreakpoint
 //
@@ -269,14 +361,21 @@ Debugger::Debugger(struct STMT* program)
 {
   this->Memory = ram_init();
 
-  // fill the map with every line in the program
+  // fill the map with every line in the program, and count the
+  // distinct variables assigned along the way
   // map<int, struct STMT&> int_to_stmt
+  set<string> variables;
   struct STMT* current = this->Program;
   while (current != nullptr) {
     int_to_stmt[current->line] = current;
+    if (current->stmt_type == STMT_ASSIGNMENT && !current->types.assignment->isPtrDeref)
+      variables.insert(current->types.assignment->var_name);
     current= get_next_statement(current);
   }
 
+  // room for every variable, so running never reallocates memory
+  presize_memory((int) variables.size());
+
   // // debug to check if the map was populated correctly
   // for (auto pair : int_to_stmt) {
   //   cout << pair.first<< " : " << pair.second->line<< endl;
@@ -345,7 +444,7 @@ void Debugger::run()
       << endl << "lb -> List all breakpoints"
       << endl << "cb -> Clear all breakpoints"
       << endl << "p varname -> Print variable"
-      << endl << "sm -> Show memory contents"
+      << endl << "sm [options] -> Show memory contents, e.g. sm match=x* format=json"
       << endl << "ss -> Show state of debugger"
       << endl << "w -> What line are we on?"
       << endl << "q -> Quit the debugger"
@@ -458,21 +557,20 @@ void Debugger::run()
       string varname;
       cin >> varname;
       
-      const char* name = varname.c_str();
-      
-      struct RAM_VALUE* value = ram_read_cell_by_name(this->Memory, (char*) name);
+      const struct RAM_VALUE* value = peek_value(varname);
       
       if (value == nullptr) {
         cout << "no such variable" << endl;
         continue;  // skip code below and continue with next cmd:
       }
       
-      print_value(varname, value);
-      ram_free_value(value);
+      print_value(varname, value); // borrowed, nothing to free
     }
     else if (cmd == "sm") {
       
-      ram_print(this->Memory);
+      string args;
+      getline(cin, args);  // options, if any, on the rest of the line
+      show_memory(args);
     }
     else if (cmd == "ss") {
       
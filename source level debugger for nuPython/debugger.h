@@ -35,7 +35,15 @@ private:
 
 
   
-  void print_value(string varname, struct RAM_VALUE* value);
+  void print_value(string varname, const struct RAM_VALUE* value);
+  //
+  // The prebuilt nupython.o predates the newer RAM functions
+  // (ram_peek_cell_by_name, ram_init_with_capacity, ram_dump), so
+  // these work on Memory's cells directly instead:
+  //
+  const struct RAM_VALUE* peek_value(const string& varname);
+  void presize_memory(int capacity);
+  void show_memory(const string& args);
   bool findBreakpoint(struct STMT*& prev, struct STMT*& breakpoint, int lineNum);
   void linkOrUnlinkStmts(struct STMT* prev, struct STMT* cur);
   /* get_next_statement
@@ -0,0 +1,643 @@
+/*ram_dump.c*/
+
+//
+// Filtered, paged and buffered dumps of memory, see ram_dump.h.
+//
+// Irene Ha
+// Northwestern University
+// CS 211
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+#include <string.h>
+#include <stdint.h>
+#include <math.h>    // isnan, isinf, fma, floor
+
+#include "ram_dump.h"
+#include "ram.h"
+
+
+/* ram_dump_flush
+writes out whatever is in the dump's buffer
+
+parameters: struct RAM_DUMP*
+returns: nothing
+*/
+static void ram_dump_flush(struct RAM_DUMP* dump) {
+  if (dump->length > 0 && fwrite(dump->buffer, 1, dump->length, dump->out) != dump->length) {
+    dump->failed = true;
+  }
+  dump->length = 0;
+}
+
+
+/* ram_dump_write
+appends bytes to the dump, flushing the buffer when they do not fit.
+A write bigger than the whole buffer goes straight to the file.
+
+parameters: struct RAM_DUMP*, const void*, size_t   // dump, bytes and # of bytes
+returns: nothing
+*/
+static void ram_dump_write(struct RAM_DUMP* dump, const void* data, size_t n) {
+  if (dump->length + n > RAM_DUMP_BUFFER_SIZE || dump->buffer == NULL) {
+    if (dump->buffer != NULL) {
+      ram_dump_flush(dump);
+    }
+    if (n > RAM_DUMP_BUFFER_SIZE || dump->buffer == NULL) {
+      if (fwrite(data, 1, n, dump->out) != n) {
+        dump->failed = true;
+      }
+      return;
+    }
+  }
+
+  memcpy(dump->buffer + dump->length, data, n);
+  dump->length += n;
+}
+
+
+/* ram_dump_text
+appends a string to the dump, "(null)" if NULL, the way printf's %s
+prints it
+
+parameters: struct RAM_DUMP*, const char*
+returns: nothing
+*/
+static void ram_dump_text(struct RAM_DUMP* dump, const char* s) {
+  if (s == NULL) {
+    s = "(null)";
+  }
+  ram_dump_write(dump, s, strlen(s));
+}
+
+
+/* ram_dump_int
+appends an integer in decimal, without going through printf
+
+parameters: struct RAM_DUMP*, long long
+returns: nothing
+*/
+static void ram_dump_int(struct RAM_DUMP* dump, long long value) {
+  char digits[24];
+  int  n = sizeof(digits);
+  unsigned long long u = (value < 0) ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+
+  do {
+    digits[--n] = (char)('0' + u % 10);
+    u /= 10;
+  } while (u != 0);
+
+  if (value < 0) {
+    digits[--n] = '-';
+  }
+
+  ram_dump_write(dump, digits + n, sizeof(digits) - n);
+}
+
+
+/* ram_dump_real
+appends a real in the given printf format
+
+parameters: struct RAM_DUMP*, const char*, double
+returns: nothing
+*/
+static void ram_dump_real(struct RAM_DUMP* dump, const char* format, double value) {
+  char text[512];  // %f of the largest double is 316 chars
+  int  n = snprintf(text, sizeof(text), format, value);
+
+  if (n > 0) {
+    ram_dump_write(dump, text, (n < (int)sizeof(text)) ? (size_t)n : sizeof(text) - 1);
+  }
+}
+
+
+/* ram_dump_micros
+rounds |value| to a whole # of millionths exactly the way printf's %f
+does (to nearest, ties to even, on the exact binary value), without
+printf. fma gives the exact error of value * 1e6, so the rounding
+decision never depends on a rounded product.
+
+parameters: double, long long*   // value and where the millionths go
+returns: bool   // false if |value| >= 1e9 or not finite, use printf
+*/
+static bool ram_dump_micros(double value, long long* micros) {
+  double x = fabs(value);
+  if (!(x < 1e9)) {
+    return false;
+  }
+
+  double p = x * 1e6;            // < 2^50, so p - floor(p) is exact
+  double error = fma(x, 1e6, -p);  // x * 1e6 == p + error exactly
+  double whole = floor(p);
+
+  // the exact product may lie just across an integer from p; the
+  // sign of a rounded sum is always the sign of the exact sum
+  if ((p - whole) + error < 0) {
+    whole -= 1;
+  } else if (((p - whole) - 1) + error >= 0) {
+    whole += 1;
+  }
+
+  double half = ((p - whole) - 0.5) + error;  // sign of fraction - 1/2
+  long long n = (long long)whole;
+  if (half > 0 || (half == 0 && n % 2 != 0)) {
+    n++;
+  }
+
+  *micros = n;
+  return true;
+}
+
+
+/* ram_dump_fixed
+appends a real the way printf's %f (and %lf) prints it: 6 decimals
+
+parameters: struct RAM_DUMP*, double
+returns: nothing
+*/
+static void ram_dump_fixed(struct RAM_DUMP* dump, double value) {
+  long long micros;
+  if (!ram_dump_micros(value, &micros)) {
+    ram_dump_real(dump, "%f", value);
+    return;
+  }
+
+  char digits[8];
+  long long fraction = micros % 1000000;
+  for (int i = 6; i >= 1; i--) {
+    digits[i] = (char)('0' + fraction % 10);
+    fraction /= 10;
+  }
+  digits[0] = '.';
+
+  if (signbit(value)) {
+    ram_dump_write(dump, "-", 1);
+  }
+  ram_dump_int(dump, micros / 1000000);
+  ram_dump_write(dump, digits, 7);
+}
+
+
+/* ram_dump_json_real
+appends a real as a JSON number that reads back as the same double:
+the %f digits with trailing zeros dropped when they are enough, as
+they are for most values a program computes, else %.17g
+
+parameters: struct RAM_DUMP*, double   // a finite value
+returns: nothing
+*/
+static void ram_dump_json_real(struct RAM_DUMP* dump, double value) {
+  long long micros;
+  if (!ram_dump_micros(value, &micros) || (double)micros / 1e6 != fabs(value)) {
+    ram_dump_real(dump, "%.17g", value);
+    return;
+  }
+
+  char digits[8];
+  long long fraction = micros % 1000000;
+  int length = 7;
+  for (int i = 6; i >= 1; i--) {
+    digits[i] = (char)('0' + fraction % 10);
+    fraction /= 10;
+  }
+  digits[0] = '.';
+  while (length > 2 && digits[length - 1] == '0') {
+    length--;  // 1.500000 => 1.5, but 2.000000 => 2.0
+  }
+
+  if (signbit(value)) {
+    ram_dump_write(dump, "-", 1);
+  }
+  ram_dump_int(dump, micros / 1000000);
+  ram_dump_write(dump, digits, length);
+}
+
+
+/* ram_dump_json_str
+appends a JSON string, escaping quotes, backslashes and control chars,
+or null if s is NULL
+
+parameters: struct RAM_DUMP*, const char*
+returns: nothing
+*/
+static void ram_dump_json_str(struct RAM_DUMP* dump, const char* s) {
+  if (s == NULL) {
+    ram_dump_write(dump, "null", 4);
+    return;
+  }
+
+  ram_dump_write(dump, "\"", 1);
+
+  const char* run = s;  // chars since the last escape, written in one go
+  for (; *s != '\0'; s++) {
+    unsigned char c = (unsigned char)*s;
+    if (c != '"' && c != '\\' && c >= 0x20) {
+      continue;
+    }
+
+    ram_dump_write(dump, run, s - run);
+    run = s + 1;
+
+    if (c == '"' || c == '\\') {
+      char escape[2] = { '\\', (char)c };
+      ram_dump_write(dump, escape, 2);
+    } else {
+      char escape[8];
+      snprintf(escape, sizeof(escape), "\\u%04x", c);
+      ram_dump_write(dump, escape, 6);
+    }
+  }
+  ram_dump_write(dump, run, s - run);
+
+  ram_dump_write(dump, "\"", 1);
+}
+
+
+/* ram_dump_glob
+returns true if s matches the glob pattern: * is any run of chars, ?
+is any one char, [abc] [a-z] one char of a set, [!abc] one char not
+in it. Backtracks to the last * only, so it takes O(len(s) *
+len(pattern)) at worst.
+
+parameters: const char*, const char*   // pattern and string
+returns: bool
+*/
+static bool ram_dump_glob(const char* pattern, const char* s) {
+  const char* star = NULL;  // pattern just past the last *
+  const char* retry = NULL; // where in s that * would match one more char
+
+  while (*s != '\0') {
+    bool matched = false;
+
+    if (*pattern == '*') {
+      star = ++pattern;
+      retry = s;
+      continue;
+    } else if (*pattern == '?') {
+      matched = true;
+      pattern++;
+    } else if (*pattern == '[') {
+      const char* p = pattern + 1;
+      bool negate = (*p == '!' || *p == '^');
+      bool in_set = false;
+
+      if (negate) {
+        p++;
+      }
+      const char* set = p;
+      while (*p != '\0' && (*p != ']' || p == set)) {  // a ] right after [ or [! is part of the set
+        if (p[1] == '-' && p[2] != ']' && p[2] != '\0') {
+          in_set = in_set || (*p <= *s && *s <= p[2]);
+          p += 3;
+        } else {
+          in_set = in_set || (*p == *s);
+          p++;
+        }
+      }
+
+      if (*p == ']') {
+        matched = (in_set != negate);
+        pattern = p + 1;
+      } else {
+        matched = (*pattern == *s);  // no closing ], a plain [
+        pattern++;
+      }
+    } else {
+      matched = (*pattern != '\0' && *pattern == *s);
+      pattern++;
+    }
+
+    if (matched) {
+      s++;
+    } else if (star != NULL) {
+      pattern = star;  // let the last * take one more char
+      s = ++retry;
+    } else {
+      return false;
+    }
+  }
+
+  while (*pattern == '*') {
+    pattern++;
+  }
+  return *pattern == '\0';
+}
+
+
+/* ram_dump_number
+parses a non-negative int that makes up the whole of text
+
+parameters: const char*, int*   // text and where the int goes
+returns: bool   // false if text is not such a number
+*/
+static bool ram_dump_number(const char* text, int* n) {
+  char* end;
+  long value = strtol(text, &end, 10);
+
+  if (end == text || *end != '\0' || value < 0 || value > INT32_MAX || text[0] == '-' || text[0] == '+') {
+    return false;
+  }
+
+  *n = (int)value;
+  return true;
+}
+
+
+//
+// ram_dump_options_init
+//
+// Dump everything, in the human format.
+//
+void ram_dump_options_init(struct RAM_DUMP_OPTIONS* options)
+{
+  options->format = RAM_DUMP_HUMAN;
+  options->pattern = NULL;
+  options->prefix = NULL;
+  options->first = 0;
+  options->last = -1;
+  options->offset = 0;
+  options->limit = -1;
+}
+
+
+//
+// ram_dump_option
+//
+// Parses name=value into options.
+//
+bool ram_dump_option(struct RAM_DUMP_OPTIONS* options, char* text)
+{
+  char* value = strchr(text, '=');
+  if (value == NULL) {
+    return false;
+  }
+
+  size_t length = value - text;
+  value++;
+
+  if (length == 6 && strncmp(text, "format", 6) == 0) {
+    if (strcmp(value, "human") == 0) {
+      options->format = RAM_DUMP_HUMAN;
+    } else if (strcmp(value, "json") == 0) {
+      options->format = RAM_DUMP_JSON;
+    } else if (strcmp(value, "binary") == 0) {
+      options->format = RAM_DUMP_BINARY;
+    } else {
+      return false;
+    }
+  } else if (length == 5 && strncmp(text, "match", 5) == 0) {
+    options->pattern = (*value == '\0') ? NULL : value;
+  } else if (length == 6 && strncmp(text, "prefix", 6) == 0) {
+    options->prefix = (*value == '\0') ? NULL : value;
+  } else if (length == 5 && strncmp(text, "range", 5) == 0) {
+    // FIRST..LAST, FIRST.. or just FIRST
+    char digits[16];
+    char* dots = strstr(value, "..");
+    size_t n = (dots == NULL) ? strlen(value) : (size_t)(dots - value);
+    int first;
+    int last;
+
+    if (n >= sizeof(digits)) {
+      return false;
+    }
+    memcpy(digits, value, n);
+    digits[n] = '\0';
+
+    if (!ram_dump_number(digits, &first)) {
+      return false;
+    }
+    if (dots == NULL) {
+      last = first;
+    } else if (dots[2] == '\0') {
+      last = -1;
+    } else if (!ram_dump_number(dots + 2, &last) || last < first) {
+      return false;
+    }
+
+    options->first = first;
+    options->last = last;
+  } else if (length == 6 && strncmp(text, "offset", 6) == 0) {
+    return ram_dump_number(value, &options->offset);
+  } else if (length == 5 && strncmp(text, "limit", 5) == 0) {
+    return ram_dump_number(value, &options->limit);
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+
+//
+// ram_dump_begin
+//
+// Starts a dump. If the buffer cannot be allocated the dump is
+// still written, just unbuffered.
+//
+void ram_dump_begin(struct RAM_DUMP* dump, struct RAM_DUMP_OPTIONS* options, FILE* out)
+{
+  dump->options = *options;
+  dump->out = out;
+  dump->buffer = (char*)malloc(RAM_DUMP_BUFFER_SIZE);
+  dump->length = 0;
+  dump->failed = false;
+  dump->matched = 0;
+  dump->dumped = 0;
+}
+
+
+//
+// ram_dump_header
+//
+// Writes the header of the dump's format.
+//
+void ram_dump_header(struct RAM_DUMP* dump, const char* title, int capacity, int num_values)
+{
+  if (dump->options.format == RAM_DUMP_HUMAN) {
+    ram_dump_text(dump, "**");
+    ram_dump_text(dump, title);
+    ram_dump_text(dump, " PRINT**\n");
+
+    if (capacity >= 0) {
+      ram_dump_text(dump, "Capacity: ");
+      ram_dump_int(dump, capacity);
+      ram_dump_text(dump, "\n");
+    }
+
+    ram_dump_text(dump, "Num values: ");
+    ram_dump_int(dump, num_values);
+    ram_dump_text(dump, "\nContents:\n");
+  } else if (dump->options.format == RAM_DUMP_BINARY) {
+    struct RAM_DUMP_HEADER header;
+    memset(&header, 0, sizeof(header));
+    header.magic = RAM_DUMP_MAGIC;
+    header.version = RAM_DUMP_VERSION;
+    header.num_values = num_values;
+
+    ram_dump_write(dump, &header, sizeof(header));
+  }
+}
+
+
+//
+// ram_dump_row
+//
+// Filters, pages and writes one value.
+//
+bool ram_dump_row(struct RAM_DUMP* dump, int address, char* identifier, const struct RAM_VALUE* value)
+{
+  struct RAM_DUMP_OPTIONS* options = &dump->options;
+
+  // Step 1: the cheap filters first, rows outside the range or past
+  // the limit are never looked at
+  if (options->last >= 0 && address > options->last) {
+    return false;
+  }
+  if (options->limit >= 0 && dump->dumped >= options->limit) {
+    return false;
+  }
+  if (address < options->first) {
+    return true;
+  }
+
+  if (options->prefix != NULL &&
+      (identifier == NULL || strncmp(identifier, options->prefix, strlen(options->prefix)) != 0)) {
+    return true;
+  }
+  if (options->pattern != NULL && (identifier == NULL || !ram_dump_glob(options->pattern, identifier))) {
+    return true;
+  }
+
+  // Step 2: paging
+  dump->matched++;
+  if (dump->matched <= options->offset) {
+    return true;
+  }
+
+  // Step 3: write it
+  if (options->format == RAM_DUMP_HUMAN) {
+    ram_dump_text(dump, " ");
+    ram_dump_int(dump, address);
+    ram_dump_text(dump, ": ");
+    ram_dump_text(dump, identifier);
+    ram_dump_text(dump, ", ");
+
+    if (value->value_type == RAM_TYPE_INT) {
+      ram_dump_text(dump, "int, ");
+      ram_dump_int(dump, value->types.i);
+    } else if (value->value_type == RAM_TYPE_REAL) {
+      ram_dump_text(dump, "real, ");
+      ram_dump_fixed(dump, value->types.d);
+    } else if (value->value_type == RAM_TYPE_STR) {
+      ram_dump_text(dump, "str, '");
+      ram_dump_text(dump, value->types.s);
+      ram_dump_text(dump, "'");
+    } else if (value->value_type == RAM_TYPE_PTR) {
+      ram_dump_text(dump, "ptr, ");
+      ram_dump_int(dump, value->types.i);
+    } else if (value->value_type == RAM_TYPE_BOOLEAN) {
+      ram_dump_text(dump, "boolean, ");
+      if (value->types.i == false) {
+        ram_dump_text(dump, "False");
+      } else if (value->types.i == true) {
+        ram_dump_text(dump, "True");
+      }
+    } else if (value->value_type == RAM_TYPE_NONE) {
+      ram_dump_text(dump, "none, None");
+    } else {
+      ram_dump_text(dump, "unknown type");
+    }
+
+    ram_dump_text(dump, "\n");
+  } else if (options->format == RAM_DUMP_JSON) {
+    ram_dump_text(dump, "{\"address\":");
+    ram_dump_int(dump, address);
+    ram_dump_text(dump, ",\"identifier\":");
+    ram_dump_json_str(dump, identifier);
+    ram_dump_text(dump, ",\"type\":");
+
+    if (value->value_type == RAM_TYPE_INT) {
+      ram_dump_text(dump, "\"int\",\"value\":");
+      ram_dump_int(dump, value->types.i);
+    } else if (value->value_type == RAM_TYPE_REAL) {
+      ram_dump_text(dump, "\"real\",\"value\":");
+      if (isnan(value->types.d)) {
+        ram_dump_text(dump, "\"nan\"");
+      } else if (isinf(value->types.d)) {
+        ram_dump_text(dump, (value->types.d > 0) ? "\"inf\"" : "\"-inf\"");
+      } else {
+        ram_dump_json_real(dump, value->types.d);
+      }
+    } else if (value->value_type == RAM_TYPE_STR) {
+      ram_dump_text(dump, "\"str\",\"value\":");
+      ram_dump_json_str(dump, value->types.s);
+    } else if (value->value_type == RAM_TYPE_PTR) {
+      ram_dump_text(dump, "\"ptr\",\"value\":");
+      ram_dump_int(dump, value->types.i);
+    } else if (value->value_type == RAM_TYPE_BOOLEAN) {
+      ram_dump_text(dump, "\"boolean\",\"value\":");
+      ram_dump_text(dump, (value->types.i == false) ? "false" : "true");
+    } else if (value->value_type == RAM_TYPE_NONE) {
+      ram_dump_text(dump, "\"none\",\"value\":null");
+    } else {
+      ram_dump_text(dump, "\"unknown\",\"value\":null");
+    }
+
+    ram_dump_text(dump, "}\n");
+  } else {
+    struct RAM_DUMP_ROW row;
+    memset(&row, 0, sizeof(row));
+    row.address = address;
+    row.value_type = value->value_type;
+    row.identifier_length = (identifier == NULL) ? -1 : (int32_t)strlen(identifier);
+
+    if (value->value_type == RAM_TYPE_REAL) {
+      row.payload.d = value->types.d;
+    } else if (value->value_type != RAM_TYPE_STR && value->value_type != RAM_TYPE_NONE) {
+      row.payload.i = value->types.i;
+    }
+
+    ram_dump_write(dump, &row, sizeof(row));
+    if (identifier != NULL) {
+      ram_dump_write(dump, identifier, row.identifier_length);
+    }
+
+    if (value->value_type == RAM_TYPE_STR) {
+      int32_t length = (value->types.s == NULL) ? -1 : (int32_t)strlen(value->types.s);
+      ram_dump_write(dump, &length, sizeof(length));
+      if (length > 0) {
+        ram_dump_write(dump, value->types.s, length);
+      }
+    }
+  }
+
+  dump->dumped++;
+  return options->limit < 0 || dump->dumped < options->limit;
+}
+
+
+//
+// ram_dump_end
+//
+// Writes the footer, flushes and frees the buffer.
+//
+int ram_dump_end(struct RAM_DUMP* dump)
+{
+  if (dump->options.format == RAM_DUMP_HUMAN) {
+    ram_dump_text(dump, "**END PRINT**\n");
+  }
+
+  if (dump->buffer != NULL) {
+    ram_dump_flush(dump);
+    free(dump->buffer);
+    dump->buffer = NULL;
+  }
+
+  if (fflush(dump->out) != 0) {
+    dump->failed = true;
+  }
+
+  return dump->failed ? -1 : dump->dumped;
+}